@@ -0,0 +1,107 @@
+#include <stdlib.h>
+
+#include "arena.h"
+
+/**
+ * Every allocation is rounded up to a multiple of this, so that any object can be placed in the arena. Objects only
+ * hold pointers, doubles and smaller types, so the alignment of those is enough.
+ */
+#define ARENA_ALIGNMENT 8
+
+#define ALIGN_UP(size) (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+void initArena(Arena *arena, size_t limit) {
+    arena->blocks = NULL;
+    arena->free = NULL;
+    arena->used = 0;
+    arena->limit = limit;
+}
+
+/**
+ * Free a linked list of blocks.
+ *
+ * @param block The head of the list.
+ */
+static void freeBlocks(ArenaBlock *block) {
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void freeArena(Arena *arena) {
+    freeBlocks(arena->blocks);
+    freeBlocks(arena->free);
+    initArena(arena, arena->limit);
+}
+
+/**
+ * Get a block with at least the given capacity, recycling a free block when possible.
+ *
+ * @param arena The arena.
+ * @param capacity The capacity.
+ * @return The block, with nothing used.
+ */
+static ArenaBlock *newBlock(Arena *arena, size_t capacity) {
+    ArenaBlock *block;
+    if (capacity == ARENA_BLOCK_SIZE && arena->free != NULL) {
+        block = arena->free;
+        arena->free = block->next;
+    } else {
+        block = (ArenaBlock *) malloc(sizeof(ArenaBlock) + capacity);
+        // Same policy as `reallocate`.
+        if (block == NULL)
+            exit(1);
+        block->capacity = capacity;
+    }
+    block->used = 0;
+    return block;
+}
+
+void *arenaAllocate(Arena *arena, size_t size) {
+    size = ALIGN_UP(size);
+    if (arena->used + size > arena->limit)
+        return NULL;
+
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->capacity - block->used < size) {
+        if (size > ARENA_BLOCK_SIZE) {
+            // Big request, give it its own block. It goes behind the head, which may still have room.
+            block = newBlock(arena, size);
+            if (arena->blocks == NULL) {
+                block->next = NULL;
+                arena->blocks = block;
+            } else {
+                block->next = arena->blocks->next;
+                arena->blocks->next = block;
+            }
+        } else {
+            block = newBlock(arena, ARENA_BLOCK_SIZE);
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    void *result = block->data + block->used;
+    block->used += size;
+    arena->used += size;
+    return result;
+}
+
+void resetArena(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        if (block->capacity == ARENA_BLOCK_SIZE) {
+            // Regular block, keep it for the next run.
+            block->next = arena->free;
+            arena->free = block;
+        } else {
+            free(block);
+        }
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->used = 0;
+}
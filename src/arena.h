@@ -0,0 +1,66 @@
+#ifndef NAMELESS_ARENA_H
+#define NAMELESS_ARENA_H
+
+#include "common.h"
+
+/**
+ * Size of a regular arena block. Requests bigger than this get a block of their own.
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/**
+ * A block of memory of the arena. Blocks are chained in a linked list, the first one is the block being filled.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;    // Next (older) block.
+    size_t capacity;            // How many bytes `data` can hold.
+    size_t used;                // How many bytes of `data` were handed out.
+    char data[];                // The memory itself.
+} ArenaBlock;
+
+/**
+ * Bump allocator. Memory is handed out by moving a pointer forward and can't be freed piece by piece: the whole arena
+ * is discarded at once with `resetArena`. Blocks are kept around after a reset, so that the next round of allocations
+ * does not need to go through malloc again.
+ *
+ * The arena memory is not managed by garbage collection and does not count towards `vm.bytesAllocated`.
+ */
+typedef struct {
+    ArenaBlock *blocks;     // Blocks in use. The head is the one being filled.
+    ArenaBlock *free;       // Blocks left over by the last reset, ready to be reused.
+    size_t used;            // Bytes handed out since the last reset.
+    size_t limit;           // Maximum number of bytes that can be handed out before a reset.
+} Arena;
+
+/**
+ * Initialize an arena.
+ *
+ * @param arena The arena.
+ * @param limit How many bytes can at most be handed out between two resets.
+ */
+void initArena(Arena *arena, size_t limit);
+
+/**
+ * Free all the memory held by an arena.
+ *
+ * @param arena The arena.
+ */
+void freeArena(Arena *arena);
+
+/**
+ * Take some memory from the arena. The memory is aligned to 8 bytes.
+ *
+ * @param arena The arena.
+ * @param size How many bytes.
+ * @return Pointer to the memory or NULL if the arena would go over its limit.
+ */
+void *arenaAllocate(Arena *arena, size_t size);
+
+/**
+ * Discard everything that was allocated from the arena. Blocks are kept for reuse.
+ *
+ * @param arena The arena.
+ */
+void resetArena(Arena *arena);
+
+#endif
@@ -15,8 +15,10 @@ char *opCodeNames[] = {
         [OP_SET_GLOBAL]     = "OP_SET_GLOBAL",
         [OP_GET_UPVALUE]    = "OP_GET_UPVALUE",
         [OP_SET_UPVALUE]    = "OP_SET_UPVALUE",
+        [OP_GET_CAPTURED]   = "OP_GET_CAPTURED",
         [OP_GET_PROPERTY]   = "OP_GET_PROPERTY",
         [OP_SET_PROPERTY]   = "OP_SET_PROPERTY",
+        [OP_INIT_PROPERTY]  = "OP_INIT_PROPERTY",
         [OP_GET_SUPER]      = "OP_GET_SUPER",
         [OP_EQUAL]          = "OP_EQUAL",
         [OP_GREATER]        = "OP_GREATER",
@@ -27,6 +29,19 @@ char *opCodeNames[] = {
         [OP_DIVIDE]         = "OP_DIVIDE",
         [OP_NOT]            = "OP_NOT",
         [OP_NEGATE]         = "OP_NEGATE",
+        [OP_BUILD_STRING]   = "OP_BUILD_STRING",
+        [OP_BUILD_LIST]     = "OP_BUILD_LIST",
+        [OP_BUILD_MAP]      = "OP_BUILD_MAP",
+        [OP_GET_INDEX]      = "OP_GET_INDEX",
+        [OP_SET_INDEX]      = "OP_SET_INDEX",
+        [OP_GREATER_NUMBER] = "OP_GREATER_NUMBER",
+        [OP_LESS_NUMBER]    = "OP_LESS_NUMBER",
+        [OP_ADD_NUMBER]     = "OP_ADD_NUMBER",
+        [OP_SUBTRACT_NUMBER] = "OP_SUBTRACT_NUMBER",
+        [OP_MULTIPLY_NUMBER] = "OP_MULTIPLY_NUMBER",
+        [OP_DIVIDE_NUMBER]  = "OP_DIVIDE_NUMBER",
+        [OP_NEGATE_NUMBER]  = "OP_NEGATE_NUMBER",
+        [OP_CHECK_NUMBER]   = "OP_CHECK_NUMBER",
         [OP_PRINT]          = "OP_PRINT",
         [OP_JUMP]           = "OP_JUMP",
         [OP_JUMP_IF_FALSE]  = "OP_JUMP_IF_FALSE",
@@ -39,7 +54,11 @@ char *opCodeNames[] = {
         [OP_CLASS]          = "OP_CLASS",
         [OP_INHERIT]        = "OP_INHERIT",
         [OP_METHOD]         = "OP_METHOD",
+        [OP_SEAL]           = "OP_SEAL",
+        [OP_RECORD]         = "OP_RECORD",
         [OP_RETURN]         = "OP_RETURN",
+        [OP_RETURN_VALUES]  = "OP_RETURN_VALUES",
+        [OP_UNPACK]         = "OP_UNPACK",
 };
 
 void initChunk(Chunk *chunk) {
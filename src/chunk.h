@@ -23,9 +23,11 @@ typedef enum {
     OP_SET_GLOBAL,      // Set a global variable. Since it is an expression, it does not pop from the stack, looks only.
     OP_GET_UPVALUE,     // Get an up-value's value. Push the value onto the stack.
     OP_SET_UPVALUE,     // Set an up-value's value. It is an expression, it does not pop from the stack.
+    OP_GET_CAPTURED,    // Push a value the closure captured by copy. There is no setter: those are never assigned.
     OP_GET_PROPERTY,    // Get an object's property. Takes field name operand. Pops an object from the stack and pushes the value.
     OP_SET_PROPERTY,    // Set an object's property. Takes field name operand. Pops object and value, assigns, then pushes the value.
-    OP_GET_SUPER,       // Get a superclass' method. Takes field name operand. Pops class from stack.
+    OP_INIT_PROPERTY,   // Like OP_SET_PROPERTY, for `this.field = ...` in an initializer. May add fields to sealed instances being built.
+    OP_GET_SUPER,       // Get a superclass' method. Takes method name operand and 2-byte selector. Pops class from stack.
     OP_EQUAL,           // (==) Pops the last two values and returns whether they are equal.
     OP_GREATER,         // (>) Pops the last two values a and b and returns whether a > b (boolean).
     OP_LESS,            // (<) Pops the last two values a and b and returns whether a < b (boolean).
@@ -35,23 +37,51 @@ typedef enum {
     OP_DIVIDE,          // (/) Pops the last two values from the stack and pushes the result.
     OP_NOT,             // (!) Unary Not. Pops the last value from the stack, negates it, pushes the result.
     OP_NEGATE,          // Replace the value at the top of the stack with its negation.
+    OP_BUILD_STRING,    // Join values into a string, for string interpolation. Operand: how many. Pops them, pushes the string.
+    OP_BUILD_LIST,      // Make a list of the last values, for a list literal. Operand: how many. Pops them, pushes the list.
+    OP_BUILD_MAP,       // Make a map of the last values, keys and values in turn, for a map literal. Operand: how many entries.
+    OP_GET_INDEX,       // ([]) Pops a list, map or string and an index or key, pushes the item.
+    OP_SET_INDEX,       // ([]=) Pops a list or map, an index or key and a value, sets the item and pushes the value.
+    // Unchecked versions of the numeric operators, for operands the compiler knows to be numbers.
+    OP_GREATER_NUMBER,  // (>) on two numbers.
+    OP_LESS_NUMBER,     // (<) on two numbers.
+    OP_ADD_NUMBER,      // (+) on two numbers.
+    OP_SUBTRACT_NUMBER, // (-) on two numbers.
+    OP_MULTIPLY_NUMBER, // (*) on two numbers.
+    OP_DIVIDE_NUMBER,   // (/) on two numbers.
+    OP_NEGATE_NUMBER,   // Negate a number.
+    OP_CHECK_NUMBER,    // Raise an error unless the value at the top is a number. Operand: what the value is, for the message.
     OP_PRINT,           // Print statement. Pop the last value and print it.
     OP_JUMP,            // Jump. Takes 2-byte operand. Used at the end of a then branch in an if.
     OP_JUMP_IF_FALSE,   // Jump if the last value on the stack is false. Takes 2-byte operand. Does not pop.
     OP_LOOP,            // Jump backwards. Takes 2-byte operand, which is how many bytes to jump backwards.
     OP_CALL,            // Call an object. Does not need to pop.
-    OP_INVOKE,          // Invoke a method. Take method name operand and argument count operand.
-    OP_SUPER_INVOKE,    // Invoke a method from the superclass. Take method name operand and argument count operand.
+    OP_INVOKE,          // Invoke a method. Take method name operand, argument count operand and 2-byte selector operand.
+    OP_SUPER_INVOKE,    // Invoke a method from the superclass. Same operands as OP_INVOKE.
     OP_CLOSURE,         // Make a Closure. Capture the necessary upvalues.
     OP_CLOSE_UPVALUE,   // Close over an upvalue instead of only popping it.
     OP_CLASS,           // Declare a class. Next operand is the class's name.
     OP_INHERIT,         // Take last class and add all methods of second to last class to it, then pop the subclass.
     OP_METHOD,          // Declare a method. Pop last value and put it in the second to last value's methods table.
+    OP_SEAL,            // Seal the class at the top of the stack, after its body. Does not pop.
+    OP_RECORD,          // Declare a record type. Operands: name, field count, then the name of each field.
     OP_RETURN,          // Pop the value at the top of the stack.
+    OP_RETURN_VALUES,   // Return several values. Operand: how many. The caller must be about to OP_UNPACK as many.
+    OP_UNPACK,          // Operand: how many values a call must produce. Only reached when a call returned one value.
 } OpCode;
 
 extern char *opCodeNames[];
 
+/**
+ * How OP_CLOSURE captures an up-value. Each up-value has two operand bytes: one of these, then a slot index.
+ */
+typedef enum {
+    CAPTURE_UPVALUE,    // Share an up-value of the enclosing closure. Index is in the enclosing up-values.
+    CAPTURE_LOCAL,      // Reference a local of the enclosing function. Closed when the local goes out of scope.
+    CAPTURE_VALUE,      // Copy a local of the enclosing function that is never assigned, into the closure itself.
+    CAPTURE_CAPTURED,   // Copy a value the enclosing closure captured. Index is in the enclosing captured values.
+} CaptureKind;
+
 /**
  * Chunk of code. Contains a dynamic array of bytes and a ValueArray to hold the constants used in the chunk of code.
  */
@@ -6,6 +6,7 @@
 #include "compiler.h"
 #include "scanner.h"
 #include "memory.h"
+#include "number.h"
 
 #ifdef DEBUG_PRINT_CODE
 
@@ -28,6 +29,8 @@ typedef struct {
     Token previous;
     bool hadError;
     bool panicMode;
+    bool numeric;       // Whether the expression just compiled is known to produce a number.
+    bool leftNumeric;   // Same, for the left operand of the infix expression being compiled.
 } Parser;
 
 /**
@@ -71,7 +74,11 @@ typedef struct {
 typedef struct {
     Token name;         // The identifier for the variable.
     int depth;          // The scope depth of the variable.
-    bool isCaptured;    // Whether this variable is an upvalue somewhere.
+    bool isCaptured;    // Whether this variable is an upvalue somewhere (by reference).
+    bool isAssigned;    // Whether this variable may be assigned after its declaration.
+    bool isConst;       // Whether this is a constant, whose reads are replaced by its value.
+    Value constant;     // The value of the constant.
+    bool isNumber;      // Declared `: num`, every value stored in it is checked to be a number.
 } Local;
 
 /**
@@ -79,7 +86,8 @@ typedef struct {
  */
 typedef struct {
     uint8_t index;
-    bool isLocal;
+    CaptureKind kind;
+    bool isNumber;      // Whether the variable was declared `: num`.
 } Upvalue;
 
 /**
@@ -104,7 +112,15 @@ typedef struct Compiler {
     Local locals[UINT8_COUNT];      // Local variables stack.
     int localCount;                 // How many local variables are there.
     Upvalue upvalues[UINT8_COUNT];  // Compiled references to upvalues.
+    Upvalue captured[UINT8_COUNT];  // Compiled references to values captured by copy.
     int scopeDepth;                 // The depth of the scope, for local variable scope.
+    int bindStart;                  // Where the code binding the last method (OP_GET_PROPERTY/OP_GET_SUPER) begins.
+    int bindInstruction;            // Where the binding instruction itself is, after the superclass is loaded.
+    int bindEnd;                    // Where it ends, -1 if nothing was bound yet.
+    int lastJumpTarget;             // The last offset a forward jump was patched to land on.
+    int thisEnd;                    // Where the code of the last `this` ends, to spot `this.field = ...`.
+    bool returnsNumber;             // Whether the function was declared to return `: num`.
+    int returnGuard;                // Constant describing the return value in its guard, -1 until needed.
 } Compiler;
 
 /**
@@ -125,6 +141,8 @@ static void expression();
 
 static void declaration();
 
+static void emitReturnGuard();
+
 static ParseRule *getRule(TokenType type);
 
 static void parsePrecedence(Precedence precedence);
@@ -137,6 +155,34 @@ Parser parser;
 Compiler *current = NULL;
 ClassCompiler *currentClass = NULL;
 
+/**
+ * Names that appear as the target of an assignment anywhere in the source being compiled. A local whose name is not in
+ * here is never assigned, so closures can capture it by value.
+ */
+Table assignedNames;
+
+/**
+ * Constants declared at top level in the source being compiled. They join `vm.constants` only if the whole source
+ * compiles, so a failed compile, e.g. a line in the REPL, leaves no constant behind.
+ */
+Table pendingConstants;
+
+/**
+ * Look up an identifier in a table keyed by names. A name that was never interned can't be in there, so nothing is
+ * allocated.
+ *
+ * @param table The table.
+ * @param name The identifier.
+ * @param value Output parameter, the value for the name.
+ * @return Whether the table has the name.
+ */
+static bool findName(Table *table, Token *name, Value *value) {
+    if (table->size == 0)
+        return false;
+    ObjString *string = findString(name->start, name->length);
+    return string != NULL && tableGet(table, string, value);
+}
+
 static Chunk *currentChunk() {
     return &current->function->chunk;
 }
@@ -152,6 +198,8 @@ static void errorAt(Token *token, const char *message) {
         return;
     parser.panicMode = true;
 
+    // Output of earlier runs comes before the error.
+    flushOutput(&vm.output);
     fprintf(stderr, "[line %d] Error", token->line);
 
     if (token->type == TOKEN_EOF) {
@@ -292,6 +340,10 @@ static void emitReturn() {
         emitByte(OP_NIL);
     }
 
+    // A function returning a number must not get here.
+    if (current->returnsNumber)
+        emitReturnGuard();
+
     emitByte(OP_RETURN);
 }
 
@@ -311,6 +363,21 @@ static uint8_t makeConstant(Value value) {
     return (uint8_t) constant;
 }
 
+/**
+ * Make sure the value at the top of the stack is a number, before a function declared to return `: num` returns it.
+ */
+static void emitReturnGuard() {
+    if (current->returnGuard == -1) {
+        char description[UINT8_COUNT + 32];
+        ObjString *name = current->function->name;
+        int length = snprintf(description, sizeof(description), "the result of '%s'", name->chars);
+        if (length >= (int) sizeof(description))
+            length = sizeof(description) - 1;
+        current->returnGuard = makeConstant(OBJ_VAL(copyString(description, length)));
+    }
+    emitTwoBytes(OP_CHECK_NUMBER, (uint8_t) current->returnGuard);
+}
+
 /**
  * Emit a constant into the chunk.
  *
@@ -339,6 +406,7 @@ static void patchJump(int offset) {
     // Write the jump offset.
     currentChunk()->code[offset] = (jump >> 8) & 0xff;
     currentChunk()->code[offset + 1] = jump & 0xff;
+    current->lastJumpTarget = currentChunk()->size;
 }
 
 /**
@@ -347,6 +415,7 @@ static void patchJump(int offset) {
  * @param canAssign Unused.
  */
 static void and_(bool canAssign) {
+    bool leftNumeric = parser.leftNumeric;
     // The left-hand side has already been parsed.
     // Emit short-circuit jump if the left hand is false.
     int endJump = emitJump(OP_JUMP_IF_FALSE);
@@ -357,6 +426,8 @@ static void and_(bool canAssign) {
     parsePrecedence(PRECEDENCE_AND);
 
     patchJump(endJump);
+    // Numbers are true, so a number on the left always leads to the right-hand.
+    parser.numeric = leftNumeric && parser.numeric;
 }
 
 /**
@@ -365,6 +436,7 @@ static void and_(bool canAssign) {
  * @param canAssign Unused.
  */
 static void or_(bool canAssign) {
+    bool leftNumeric = parser.leftNumeric;
     // TODO the book does it like this to show what kind of flexibility we can expect. Better to add a JUMP_IF_TRUE.
     // If false, avoid the unconditional jump that immediately follows and would skip the right-hand side.
     int elseJump = emitJump(OP_JUMP_IF_FALSE);
@@ -377,6 +449,8 @@ static void or_(bool canAssign) {
     parsePrecedence(PRECEDENCE_OR);
 
     patchJump(endJump);
+    // Only a number on the left, which is true, makes sure the result is a number.
+    parser.numeric = leftNumeric;
 }
 
 /**
@@ -391,6 +465,13 @@ static void initCompiler(Compiler *compiler, FunctionType type) {
     compiler->type = type;
     compiler->localCount = 0;
     compiler->scopeDepth = 0;
+    compiler->bindStart = -1;
+    compiler->bindInstruction = -1;
+    compiler->bindEnd = -1;
+    compiler->lastJumpTarget = -1;
+    compiler->thisEnd = -1;
+    compiler->returnsNumber = false;
+    compiler->returnGuard = -1;
 
     compiler->function = newFunction();
 
@@ -404,6 +485,9 @@ static void initCompiler(Compiler *compiler, FunctionType type) {
     Local *local = &current->locals[current->localCount++];
     local->depth = 0;
     local->isCaptured = false;
+    local->isAssigned = false;
+    local->isConst = false;
+    local->isNumber = false;
 
     // The first slot in the stack holds an empty name,
     // because slot 0 holds the function being called.
@@ -474,32 +558,37 @@ static int resolveLocal(Compiler *compiler, Token *name) {
 }
 
 /**
- * Add a reference to an up-value to the given compiler.
+ * Add a reference to an up-value to the given compiler. Values captured by copy and by reference are kept apart, since
+ * they end up in different arrays of the closure.
  *
  * @param compiler The compiler.
  * @param index The original index of the up-value in the stack.
- * @param isLocal Whether the value is a local variable or not.
- * @return The index where the up-value will be in the closure's up-value array.
- */
-static int addUpvalue(Compiler *compiler, uint8_t index, bool isLocal) {
-    int upvalueCount = compiler->function->upvalueCount;
-
-    for (int i = 0; i < upvalueCount; i++) {
-        Upvalue *upvalue = &compiler->upvalues[i];
-        if (upvalue->index == index && upvalue->isLocal == isLocal) {
+ * @param kind How the up-value is captured.
+ * @param isNumber Whether the variable was declared `: num`.
+ * @return The index where the up-value will be in the closure's up-value (or captured values) array.
+ */
+static int addUpvalue(Compiler *compiler, uint8_t index, CaptureKind kind, bool isNumber) {
+    bool byValue = kind == CAPTURE_VALUE || kind == CAPTURE_CAPTURED;
+    Upvalue *upvalues = byValue ? compiler->captured : compiler->upvalues;
+    int *upvalueCount = byValue ? &compiler->function->capturedCount : &compiler->function->upvalueCount;
+
+    for (int i = 0; i < *upvalueCount; i++) {
+        Upvalue *upvalue = &upvalues[i];
+        if (upvalue->index == index && upvalue->kind == kind) {
             return i;
         }
     }
 
-    if (upvalueCount == UINT8_COUNT) {
+    if (*upvalueCount == UINT8_COUNT) {
         error("Too many closure variables in function.");
         return 0;
     }
 
-    compiler->upvalues[upvalueCount].isLocal = isLocal;
-    compiler->upvalues[upvalueCount].index = index;
+    upvalues[*upvalueCount].kind = kind;
+    upvalues[*upvalueCount].index = index;
+    upvalues[*upvalueCount].isNumber = isNumber;
 
-    return compiler->function->upvalueCount++;
+    return (*upvalueCount)++;
 }
 
 /**
@@ -508,22 +597,32 @@ static int addUpvalue(Compiler *compiler, uint8_t index, bool isLocal) {
  *
  * @param compiler The compiler.
  * @param name The identifier.
+ * @param byValue Output parameter, set to whether the variable is captured by copy (it is never assigned).
  * @return The up-value index for the up-value or -1 if no up-value with the given name was found.
  */
-static int resolveUpvalue(Compiler *compiler, Token *name) {
+static int resolveUpvalue(Compiler *compiler, Token *name, bool *byValue) {
     if (compiler->enclosing == NULL) return -1;
 
     // If the upvalue is a local in the enclosing function.
     int local = resolveLocal(compiler->enclosing, name);
     if (local != -1) {
+        // Never assigned -> a copy is as good as a reference and the local needs no closing.
+        bool isNumber = compiler->enclosing->locals[local].isNumber;
+        *byValue = !compiler->enclosing->locals[local].isAssigned;
+        if (*byValue)
+            return addUpvalue(compiler, (uint8_t) local, CAPTURE_VALUE, isNumber);
+
         compiler->enclosing->locals[local].isCaptured = true;
-        return addUpvalue(compiler, (uint8_t) local, true);
+        compiler->enclosing->function->hasCapturedLocals = true;
+        return addUpvalue(compiler, (uint8_t) local, CAPTURE_LOCAL, isNumber);
     }
 
-    // If the upvalue is an upvalue in the enclosing function.
-    int upvalue = resolveUpvalue(compiler->enclosing, name);
+    // If the upvalue is an upvalue in the enclosing function. Copies stay copies down the chain.
+    int upvalue = resolveUpvalue(compiler->enclosing, name, byValue);
     if (upvalue != -1) {
-        return addUpvalue(compiler, (uint8_t) upvalue, false);
+        Upvalue *enclosing = *byValue ? compiler->enclosing->captured : compiler->enclosing->upvalues;
+        return addUpvalue(compiler, (uint8_t) upvalue, *byValue ? CAPTURE_CAPTURED : CAPTURE_UPVALUE,
+                          enclosing[upvalue].isNumber);
     }
 
 
@@ -551,6 +650,54 @@ static void endScope() {
     }
 }
 
+/**
+ * Emit the unchecked version of a binary operator whose operands are both numbers.
+ *
+ * @param operatorType The operator.
+ */
+static void emitNumberOperator(TokenType operatorType) {
+    // Only arithmetic gives a number back.
+    parser.numeric = false;
+    switch (operatorType) {
+        case TOKEN_BANG_EQUAL:
+            emitTwoBytes(OP_EQUAL, OP_NOT);
+            break;
+        case TOKEN_EQUAL_EQUAL:
+            emitByte(OP_EQUAL);
+            break;
+        case TOKEN_GREATER:
+            emitByte(OP_GREATER_NUMBER);
+            break;
+        case TOKEN_GREATER_EQUAL:
+            emitTwoBytes(OP_LESS_NUMBER, OP_NOT);
+            break;
+        case TOKEN_LESS:
+            emitByte(OP_LESS_NUMBER);
+            break;
+        case TOKEN_LESS_EQUAL:
+            emitTwoBytes(OP_GREATER_NUMBER, OP_NOT);
+            break;
+        case TOKEN_PLUS:
+            emitByte(OP_ADD_NUMBER);
+            parser.numeric = true;
+            break;
+        case TOKEN_MINUS:
+            emitByte(OP_SUBTRACT_NUMBER);
+            parser.numeric = true;
+            break;
+        case TOKEN_STAR:
+            emitByte(OP_MULTIPLY_NUMBER);
+            parser.numeric = true;
+            break;
+        case TOKEN_SLASH:
+            emitByte(OP_DIVIDE_NUMBER);
+            parser.numeric = true;
+            break;
+        default:
+            return; // Unreachable.
+    }
+}
+
 /**
  * Parse a binary expression. Calls on the rule table to determine how to parse the terms.
  *
@@ -566,8 +713,16 @@ static void binary(bool canAssign) {
 
     TokenType operatorType = parser.previous.type;
     ParseRule *rule = getRule(operatorType);
+    bool leftNumeric = parser.leftNumeric;
     parsePrecedence((Precedence) (rule->precedence + 1));
 
+    // Both operands are known to be numbers: no need to check them at runtime.
+    if (leftNumeric && parser.numeric) {
+        emitNumberOperator(operatorType);
+        return;
+    }
+    parser.numeric = false;
+
     switch (operatorType) {
         case TOKEN_BANG_EQUAL:
             emitTwoBytes(OP_EQUAL, OP_NOT);
@@ -622,17 +777,73 @@ static uint8_t argumentList() {
         } while (match(TOKEN_COMMA));
     }
     consume(TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+    // The last argument may be a number, the call's result can be anything.
+    parser.numeric = false;
     return argCount;
 }
 
 /**
- * Compile a function call.
+ * Emit the 2-byte selector operand of a method name. The method name gets its selector right away, so that the VM can
+ * find the method in the class' vtable without hashing.
+ *
+ * @param name The constant holding the method name.
+ */
+static void emitSelector(uint8_t name) {
+    int selector = symbolFor(AS_STRING(currentChunk()->constants.values[name]));
+    if (selector > UINT16_MAX)
+        error("Too many property and method names.");
+
+    emitTwoBytes((selector >> 8) & 0xff, selector & 0xff);
+}
+
+/**
+ * Emit a method invocation (OP_INVOKE or OP_SUPER_INVOKE) on the receiver below the arguments.
+ *
+ * @param instruction The invocation instruction.
+ * @param name The constant holding the method name.
+ * @param argCount How many arguments were pushed.
+ */
+static void emitInvoke(uint8_t instruction, uint8_t name, uint8_t argCount) {
+    emitTwoBytes(instruction, name);
+    emitByte(argCount);
+    emitSelector(name);
+}
+
+/**
+ * Compile a function call. If the callee is a method that was just bound, like in `(object.method)(arg)`, the binding
+ * is dropped and the method is invoked directly, so that no bound method gets allocated. This is only safe when the
+ * binding is the very last code emitted and no jump lands right after it (e.g. `(a or b.method)()`).
+ *
+ * A method passed as an argument, as in `list.sort(object.compare)`, is still bound: the callee can keep it and call it
+ * any time later, so it has to be a value of its own.
  *
  * @param canAssign Unused.
  */
 static void call(bool canAssign) {
+    Chunk *chunk = currentChunk();
+    // Code loading the superclass, which has to go after the arguments. Empty for a property. It is a single variable
+    // read, which takes two bytes.
+    uint8_t superclass[2];
+    int superclassLength = current->bindInstruction - current->bindStart;
+    if (current->bindEnd != chunk->size || current->lastJumpTarget == chunk->size ||
+        superclassLength > (int) sizeof(superclass)) {
+        uint8_t argCount = argumentList();
+        emitTwoBytes(OP_CALL, argCount);
+        return;
+    }
+
+    // Take back the binding: the receiver stays on the stack, below the arguments.
+    uint8_t bindOp = chunk->code[current->bindInstruction];
+    uint8_t name = chunk->code[current->bindInstruction + 1];
+    memcpy(superclass, chunk->code + current->bindStart, superclassLength);
+    chunk->size = current->bindStart;
+    current->bindEnd = -1;
+
     uint8_t argCount = argumentList();
-    emitTwoBytes(OP_CALL, argCount);
+    for (int i = 0; i < superclassLength; i++) {
+        emitByte(superclass[i]);
+    }
+    emitInvoke(bindOp == OP_GET_SUPER ? OP_SUPER_INVOKE : OP_INVOKE, name, argCount);
 }
 
 /**
@@ -641,21 +852,28 @@ static void call(bool canAssign) {
  * @param canAssign Whether the left-hand side can be assigned to.
  */
 static void dot(bool canAssign) {
+    // An initializer assigning a field of its own instance: the only way to add fields to a sealed instance.
+    bool initializing = current->type == TYPE_INITIALIZER && current->thisEnd == currentChunk()->size;
+
     consume(TOKEN_IDENTIFIER, "Expect property name after '.'.");
     uint8_t name = identifierConstant(&parser.previous);
+    // Hand out the symbol now, the VM finds the field slot with it.
+    symbolFor(AS_STRING(currentChunk()->constants.values[name]));
 
     if (canAssign && match(TOKEN_EQUAL)) {
         // Assigning to a field.
         expression();
-        emitTwoBytes(OP_SET_PROPERTY, name);
+        emitTwoBytes(initializing ? OP_INIT_PROPERTY : OP_SET_PROPERTY, name);
     } else if (match(TOKEN_LEFT_PAREN)) {
         // Invoking a method directly.
         uint8_t argCount = argumentList();
-        emitTwoBytes(OP_INVOKE, name);
-        emitByte(argCount);
+        emitInvoke(OP_INVOKE, name, argCount);
     } else {
         // Get expression, may lead to method binding.
+        current->bindStart = currentChunk()->size;
+        current->bindInstruction = currentChunk()->size;
         emitTwoBytes(OP_GET_PROPERTY, name);
+        current->bindEnd = currentChunk()->size;
     }
 }
 
@@ -711,6 +929,68 @@ static void grouping(bool canAssign) {
 
 }
 
+/**
+ * Parse a list literal, like `[1, 2, 3]`.
+ *
+ * @param canAssign Unused.
+ */
+static void list(bool canAssign) {
+    int count = 0;
+    if (!check(TOKEN_RIGHT_BRACKET)) {
+        do {
+            expression();
+            if (count == UINT8_MAX) {
+                error("Can't have more than 255 items in a list literal.");
+            }
+            count++;
+        } while (match(TOKEN_COMMA));
+    }
+    consume(TOKEN_RIGHT_BRACKET, "Expect ']' after list items.");
+    emitTwoBytes(OP_BUILD_LIST, (uint8_t) count);
+    parser.numeric = false;
+}
+
+/**
+ * Parse a map literal, like `{"x": 1, "y": 2}`. Keys are expressions, which must give strings.
+ *
+ * @param canAssign Unused.
+ */
+static void map(bool canAssign) {
+    int count = 0;
+    if (!check(TOKEN_RIGHT_BRACE)) {
+        do {
+            expression();
+            consume(TOKEN_COLON, "Expect ':' after map key.");
+            expression();
+            if (count == UINT8_MAX) {
+                error("Can't have more than 255 entries in a map literal.");
+            }
+            count++;
+        } while (match(TOKEN_COMMA));
+    }
+    consume(TOKEN_RIGHT_BRACE, "Expect '}' after map entries.");
+    emitTwoBytes(OP_BUILD_MAP, (uint8_t) count);
+    parser.numeric = false;
+}
+
+/**
+ * Parse an index into a list, a map or a string, like `items[i]`, which may be assigned.
+ *
+ * @param canAssign Whether the index can be assigned.
+ */
+static void subscript(bool canAssign) {
+    expression();
+    consume(TOKEN_RIGHT_BRACKET, "Expect ']' after index.");
+
+    if (canAssign && match(TOKEN_EQUAL)) {
+        expression();
+        emitByte(OP_SET_INDEX);
+    } else {
+        emitByte(OP_GET_INDEX);
+    }
+    parser.numeric = false;
+}
+
 /**
  * Parse a number.
  *
@@ -723,8 +1003,35 @@ static void number(bool canAssign) {
     printToken(&parser.previous);
 #endif
 
-    double value = strtod(parser.previous.start, NULL);
+    double value;
+    parseNumber(parser.previous.start, parser.previous.length, &value);
     emitConstant(NUMBER_VAL(value));
+    parser.numeric = true;
+}
+
+/**
+ * Make the string of a literal, or of a literal part of an interpolated string. Strings are raw, except that `\${`
+ * stands for `${`: the backslash is taken out.
+ *
+ * @param start Where the text starts, after the quote or the `}`.
+ * @param length The length of the text, up to the quote or the `${`.
+ * @return The string.
+ */
+static ObjString *stringLiteral(const char *start, int length) {
+    if (memchr(start, '\\', length) == NULL)
+        return copyString(start, length);
+
+    char *chars = ALLOCATE(char, length + 1);
+    int count = 0;
+    for (int i = 0; i < length; i++) {
+        if (start[i] == '\\' && i + 2 < length && start[i + 1] == '$' && start[i + 2] == '{')
+            continue;
+        chars[count++] = start[i];
+    }
+    chars[count] = '\0';
+    // The string owns exactly its length and the terminator.
+    chars = GROW_ARRAY(char, chars, length + 1, count + 1);
+    return takeString(chars, count);
 }
 
 /**
@@ -739,37 +1046,170 @@ static void string(bool canAssign) {
     printToken(&parser.previous);
 #endif
 
-    emitConstant(OBJ_VAL(copyString(parser.previous.start + 1, parser.previous.length - 2)));
+    emitConstant(OBJ_VAL(stringLiteral(parser.previous.start + 1, parser.previous.length - 2)));
 }
 
 /**
- * Apparently this will make more sense later.
+ * Compile an interpolated string, like `"x=${x}"`. The literal parts and the expressions are pushed in order, then
+ * joined in one go by OP_BUILD_STRING. Empty literal parts are left out.
+ *
+ * @param canAssign Unused.
  */
-static void namedVariable(Token name, bool canAssign) {
+static void interpolation(bool canAssign) {
+
+#ifdef DEBUG_PRINT_PARSE_STACK
+    PRINT_TABS();
+    printToken(&parser.previous);
+#endif
+
+    int parts = 0;
+    do {
+        // The part before `${` goes from after the `"` or `}` to before the `${`.
+        if (parser.previous.length > 3) {
+            emitConstant(OBJ_VAL(stringLiteral(parser.previous.start + 1, parser.previous.length - 3)));
+            parts++;
+        }
+        expression();
+        parts++;
+    } while (match(TOKEN_INTERPOLATION));
+
+    consume(TOKEN_STRING, "Expect end of string after interpolation.");
+    if (parser.previous.length > 2) {
+        emitConstant(OBJ_VAL(stringLiteral(parser.previous.start + 1, parser.previous.length - 2)));
+        parts++;
+    }
+
+    if (parts > UINT8_MAX) {
+        error("Too many parts in one interpolated string.");
+        return;
+    }
+    emitTwoBytes(OP_BUILD_STRING, parts);
+    parser.numeric = false;
+}
+
+/**
+ * Find out where a variable lives and which instructions read and write it.
+ *
+ * @param name The variable name.
+ * @param getOp Output parameter, the instruction reading the variable.
+ * @param setOp Output parameter, the instruction writing the variable.
+ * @param isNumber Output parameter, whether the variable was declared `: num`.
+ * @return The operand of both instructions.
+ */
+static int resolveVariable(Token *name, uint8_t *getOp, uint8_t *setOp, bool *isNumber) {
     // Determine whether the variable is a global or local one.
-    uint8_t getOp, setOp;
-    int arg = resolveLocal(current, &name);
+    bool byValue;
+    int arg = resolveLocal(current, name);
     if (arg != -1) {
         //
-        getOp = OP_GET_LOCAL;
-        setOp = OP_SET_LOCAL;
-    } else if ((arg = resolveUpvalue(current, &name)) != -1) {
-        getOp = OP_GET_UPVALUE;
-        setOp = OP_SET_UPVALUE;
+        *getOp = OP_GET_LOCAL;
+        *setOp = OP_SET_LOCAL;
+        *isNumber = current->locals[arg].isNumber;
+    } else if ((arg = resolveUpvalue(current, name, &byValue)) != -1) {
+        // Copies are never assigned, the pre-scan made sure of it.
+        *getOp = byValue ? OP_GET_CAPTURED : OP_GET_UPVALUE;
+        *setOp = OP_SET_UPVALUE;
+        *isNumber = (byValue ? current->captured : current->upvalues)[arg].isNumber;
     } else {
-        arg = identifierConstant(&name);
-        getOp = OP_GET_GLOBAL;
-        setOp = OP_SET_GLOBAL;
+        arg = identifierConstant(name);
+        *getOp = OP_GET_GLOBAL;
+        *setOp = OP_SET_GLOBAL;
+        *isNumber = false;
+    }
+    return arg;
+}
+
+/**
+ * Make sure the value at the top of the stack is a number, unless the expression that produced it is known to be one.
+ *
+ * @param format How to describe the value in the error message, with a `%.*s` for the name.
+ * @param name The name of the variable or function the value goes to.
+ */
+static void emitNumberGuard(const char *format, Token *name) {
+    if (parser.numeric)
+        return;
+
+    char description[UINT8_COUNT + 32];
+    int length = snprintf(description, sizeof(description), format, name->length, name->start);
+    if (length >= (int) sizeof(description))
+        length = sizeof(description) - 1;
+    emitTwoBytes(OP_CHECK_NUMBER, makeConstant(OBJ_VAL(copyString(description, length))));
+    parser.numeric = true;
+}
+
+/**
+ * Find out whether a name refers to a constant: a local one in this function or an enclosing one, or a global one.
+ *
+ * @param name The name.
+ * @param value Output parameter, the value of the constant.
+ * @return Whether the name refers to a constant.
+ */
+static bool resolveConstant(Token *name, Value *value) {
+    // The innermost declaration wins, whether it is a constant or not.
+    for (Compiler *compiler = current; compiler != NULL; compiler = compiler->enclosing) {
+        int local = resolveLocal(compiler, name);
+        if (local != -1) {
+            if (!compiler->locals[local].isConst)
+                return false;
+            *value = compiler->locals[local].constant;
+            return true;
+        }
+    }
+
+    return findName(&pendingConstants, name, value) || findName(&vm.constants, name, value);
+}
+
+/**
+ * Compile a read of a constant: its value, right in the code. Members of enums (`Color.RED`) are folded as well.
+ *
+ * @param value The value of the constant.
+ * @param canAssign Whether the read could have been an assignment.
+ */
+static void namedConstant(Value value, bool canAssign) {
+    if (canAssign && match(TOKEN_EQUAL)) {
+        error("Can't assign to a constant.");
+        expression();
+        return;
+    }
+
+    // Enums are records of constants.
+    if (IS_RECORD(value) && match(TOKEN_DOT)) {
+        consume(TOKEN_IDENTIFIER, "Expect member name after '.'.");
+        ObjString *member = copyString(parser.previous.start, parser.previous.length);
+        if (!recordGet(AS_RECORD(value), member, &value)) {
+            error("No such member in enum.");
+            return;
+        }
+    }
+    emitConstant(value);
+    parser.numeric = IS_NUMBER(value);
+}
+
+/**
+ * Apparently this will make more sense later.
+ */
+static void namedVariable(Token name, bool canAssign) {
+    Value constant;
+    if (resolveConstant(&name, &constant)) {
+        namedConstant(constant, canAssign);
+        return;
     }
 
+    uint8_t getOp, setOp;
+    bool isNumber;
+    int arg = resolveVariable(&name, &getOp, &setOp, &isNumber);
+
     // If there's an equal then I am not trying
     // to get the variable's value, but to set it.
     if (canAssign && match(TOKEN_EQUAL)) {
         expression();
+        if (isNumber)
+            emitNumberGuard("'%.*s'", &name);
         emitTwoBytes(setOp, (uint8_t) arg);
     } else {
         emitTwoBytes(getOp, (uint8_t) arg);
     }
+    parser.numeric = isNumber;
 }
 
 /**
@@ -821,12 +1261,15 @@ static void super_(bool canAssign) {
         // Method invocation.
         uint8_t argCount = argumentList();
         namedVariable(syntheticToken("super"), false);
-        emitTwoBytes(OP_SUPER_INVOKE, name);
-        emitByte(argCount);
+        emitInvoke(OP_SUPER_INVOKE, name, argCount);
     } else {
         // Method get.
+        current->bindStart = currentChunk()->size;
         namedVariable(syntheticToken("super"), false);
+        current->bindInstruction = currentChunk()->size;
         emitTwoBytes(OP_GET_SUPER, name);
+        emitSelector(name);
+        current->bindEnd = currentChunk()->size;
     }
 }
 
@@ -841,6 +1284,7 @@ static void this_(bool canAssign) {
         return;
     }
     variable(false);
+    current->thisEnd = currentChunk()->size;
 }
 
 /**
@@ -867,11 +1311,13 @@ static void unary(bool canAssign) {
             emitByte(OP_NOT);
             break;
         case TOKEN_MINUS:
-            emitByte(OP_NEGATE);
-            break;
+            // The operand says whether the result is a number, just like it was for the operand.
+            emitByte(parser.numeric ? OP_NEGATE_NUMBER : OP_NEGATE);
+            return;
         default:
             return; // Unreachable.
     }
+    parser.numeric = false;
 }
 
 /**
@@ -880,8 +1326,11 @@ static void unary(bool canAssign) {
 ParseRule rules[] = {
         [TOKEN_LEFT_PAREN]    = {grouping, call, PRECEDENCE_CALL},
         [TOKEN_RIGHT_PAREN]   = {NULL, NULL, PRECEDENCE_NONE},
-        [TOKEN_LEFT_BRACE]    = {NULL, NULL, PRECEDENCE_NONE},
+        [TOKEN_LEFT_BRACE]    = {map, NULL, PRECEDENCE_NONE},
         [TOKEN_RIGHT_BRACE]   = {NULL, NULL, PRECEDENCE_NONE},
+        [TOKEN_LEFT_BRACKET]  = {list, subscript, PRECEDENCE_CALL},
+        [TOKEN_RIGHT_BRACKET] = {NULL, NULL, PRECEDENCE_NONE},
+        [TOKEN_COLON]         = {NULL, NULL, PRECEDENCE_NONE},
         [TOKEN_COMMA]         = {NULL, NULL, PRECEDENCE_NONE},
         [TOKEN_DOT]           = {NULL, dot, PRECEDENCE_CALL},
         [TOKEN_MINUS]         = {unary, binary, PRECEDENCE_TERM},
@@ -899,8 +1348,11 @@ ParseRule rules[] = {
         [TOKEN_LESS_EQUAL]    = {NULL, binary, PRECEDENCE_COMPARISON},
         [TOKEN_IDENTIFIER]    = {variable, NULL, PRECEDENCE_NONE},
         [TOKEN_STRING]        = {string, NULL, PRECEDENCE_NONE},
+        [TOKEN_INTERPOLATION] = {interpolation, NULL, PRECEDENCE_NONE},
         [TOKEN_NUMBER]        = {number, NULL, PRECEDENCE_NONE},
         [TOKEN_AND]           = {NULL, and_, PRECEDENCE_AND},
+        [TOKEN_CONST]         = {NULL, NULL, PRECEDENCE_NONE},
+        [TOKEN_ENUM]          = {NULL, NULL, PRECEDENCE_NONE},
         [TOKEN_CLASS]         = {NULL, NULL, PRECEDENCE_NONE},
         [TOKEN_ELSE]          = {NULL, NULL, PRECEDENCE_NONE},
         [TOKEN_FALSE]         = {literal, NULL, PRECEDENCE_NONE},
@@ -910,7 +1362,9 @@ ParseRule rules[] = {
         [TOKEN_NIL]           = {literal, NULL, PRECEDENCE_NONE},
         [TOKEN_OR]            = {NULL, or_, PRECEDENCE_OR},
         [TOKEN_PRINT]         = {NULL, NULL, PRECEDENCE_NONE},
+        [TOKEN_RECORD]        = {NULL, NULL, PRECEDENCE_NONE},
         [TOKEN_RETURN]        = {NULL, NULL, PRECEDENCE_NONE},
+        [TOKEN_SEALED]        = {NULL, NULL, PRECEDENCE_NONE},
         [TOKEN_SUPER]         = {super_, NULL, PRECEDENCE_NONE},
         [TOKEN_THIS]          = {this_, NULL, PRECEDENCE_NONE},
         [TOKEN_TRUE]          = {literal, NULL, PRECEDENCE_NONE},
@@ -945,6 +1399,8 @@ static void parsePrecedence(Precedence precedence) {
     // Actually parse the expression as suited.
     // The produced value will be added to the stack by the interpreter.
     // This concludes our business with the prefix of the expression.
+    // Rules that know their result is a number say so, anything else may produce anything.
+    parser.numeric = false;
     prefixRule(canAssign);
 
     // Parse upwards if the next token is an infix with higher priority.
@@ -952,6 +1408,8 @@ static void parsePrecedence(Precedence precedence) {
     while (precedence <= getRule(parser.current.type)->precedence) {
         advance();
         ParseFn infixRule = getRule(parser.previous.type)->infix;
+        parser.leftNumeric = parser.numeric;
+        parser.numeric = false;
         infixRule(canAssign);
     }
 
@@ -1035,16 +1493,28 @@ static void addLocal(Token name) {
     local->name = name;
     local->depth = -1;          // -1 implies un-initialized state.
     local->isCaptured = false;
+    local->isConst = false;
+    local->isNumber = false;
+
+    // Look the name up in the pre-scan results.
+    Value unused;
+    local->isAssigned = findName(&assignedNames, &name, &unused);
 }
 
 /**
  * Declare a local variable. Does nothing for globals.
  */
 static void declareVariable() {
-    if (current->scopeDepth == 0)
+    Token *name = &parser.previous;
+
+    // Globals can be redefined, unless the compiler inlined their value already.
+    if (current->scopeDepth == 0) {
+        Value unused;
+        if (findName(&pendingConstants, name, &unused) || findName(&vm.constants, name, &unused))
+            error("Already a constant with this name.");
         return;
+    }
 
-    Token *name = &parser.previous;
 
     for (int i = current->localCount - 1; i >= 0; i--) {
         Local *local = &current->locals[i];
@@ -1104,19 +1574,102 @@ static void defineVariable(uint8_t global) {
 }
 
 /**
- * Parse a variable's declaration.
+ * Parse an optional type annotation, `: num`. Numbers are the only type so far.
+ *
+ * @return Whether the annotation says the value is a number.
+ */
+static bool typeAnnotation() {
+    if (!match(TOKEN_COLON))
+        return false;
+
+    consume(TOKEN_IDENTIFIER, "Expect type after ':'.");
+    if (parser.previous.length != 3 || memcmp(parser.previous.start, "num", 3) != 0) {
+        error("Unknown type, the only type is 'num'.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse the type annotation of the local that was just declared. Globals can be assigned from anywhere, so they can't
+ * have one.
+ */
+static void localTypeAnnotation() {
+    if (!typeAnnotation())
+        return;
+
+    if (current->scopeDepth == 0)
+        error("Only local variables can have a type.");
+    else
+        current->locals[current->localCount - 1].isNumber = true;
+}
+
+/**
+ * Make sure a local declared `: num` holds a number, for locals that are not initialized by an expression of their own.
+ *
+ * @param slot The slot of the local.
+ */
+static void emitLocalGuard(int slot) {
+    Local *local = &current->locals[slot];
+    if (!local->isNumber)
+        return;
+
+    emitTwoBytes(OP_GET_LOCAL, (uint8_t) slot);
+    parser.numeric = false;
+    emitNumberGuard("'%.*s'", &local->name);
+    emitByte(OP_POP);
+}
+
+/**
+ * Parse a variable's declaration. Several variables can be declared at once from a call returning as many values, as in
+ * `var min, max = bounds(list);`. Locals can have a type: `var x: num = 0;`.
  */
 static void varDeclaration() {
-    uint8_t global = parseVariable("Expect variable name.");
+    uint8_t globals[UINT8_COUNT];
+    int count = 0;
+    do {
+        uint8_t global = parseVariable("Expect variable name.");
+        localTypeAnnotation();
+        if (count == UINT8_MAX)
+            error("Can't declare more than 255 variables at once.");
+        else
+            globals[count++] = global;
+    } while (match(TOKEN_COMMA));
 
     if (match(TOKEN_EQUAL)) {
         expression();
+        if (count > 1) {
+            emitTwoBytes(OP_UNPACK, count);
+            for (int i = current->localCount - count; current->scopeDepth > 0 && i < current->localCount; i++) {
+                emitLocalGuard(i);
+            }
+        } else if (current->scopeDepth > 0 && current->locals[current->localCount - 1].isNumber) {
+            emitNumberGuard("'%.*s'", &current->locals[current->localCount - 1].name);
+        }
     } else {
-        emitByte(OP_NIL);
+        for (int i = 0; i < count; i++) {
+            emitByte(OP_NIL);
+        }
+        for (int i = current->localCount - count; current->scopeDepth > 0 && i < current->localCount; i++) {
+            if (current->locals[i].isNumber)
+                error("A variable with a type needs an initializer.");
+        }
     }
     consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
 
-    defineVariable(global);
+    if (count == 1) {
+        defineVariable(globals[0]);
+    } else if (current->scopeDepth > 0) {
+        // The values are the locals already.
+        for (int i = current->localCount - count; i < current->localCount; i++) {
+            current->locals[i].depth = current->scopeDepth;
+        }
+    } else {
+        // The last value is on top.
+        for (int i = count - 1; i >= 0; i--) {
+            emitTwoBytes(OP_DEFINE_GLOBAL, globals[i]);
+        }
+    }
 }
 
 /**
@@ -1139,23 +1692,38 @@ static void function(FunctionType type) {
                 errorAtCurrent("Can't have more than 255 parameters.");
             }
             uint8_t constant = parseVariable("Expect parameter name.");
+            localTypeAnnotation();
             defineVariable(constant);
         } while (match(TOKEN_COMMA));
     }
     consume(TOKEN_RIGHT_PAREN, "Expect ')' after parameters.");
+    if (typeAnnotation()) {
+        if (type == TYPE_INITIALIZER)
+            error("Can't give a return type to an initializer.");
+        current->returnsNumber = true;
+    }
     consume(TOKEN_LEFT_BRACE, "Expect '{' before function body.");
 
+    // Arguments for typed parameters are checked once, on entry. The body relies on them being numbers.
+    for (int i = 1; i <= current->function->arity && i < current->localCount; i++) {
+        emitLocalGuard(i);
+    }
+
     // The body of the function.
     block();
 
     ObjFunction *function = endCompiler();
     emitTwoBytes(OP_CLOSURE, makeConstant(OBJ_VAL(function)));
 
-    // Push set of bytes as operands to OP_CLOSURE.
+    // Push set of bytes as operands to OP_CLOSURE. References first, then copies.
     for (int i = 0; i < function->upvalueCount; i++) {
-        emitByte(compiler.upvalues[i].isLocal ? 1 : 0);
+        emitByte(compiler.upvalues[i].kind);
         emitByte(compiler.upvalues[i].index);
     }
+    for (int i = 0; i < function->capturedCount; i++) {
+        emitByte(compiler.captured[i].kind);
+        emitByte(compiler.captured[i].index);
+    }
 }
 
 /**
@@ -1179,8 +1747,10 @@ static void method() {
 
 /**
  * Compile a Class.
+ *
+ * @param sealed Whether the class was declared `sealed`.
  */
-static void classDeclaration() {
+static void classDeclaration(bool sealed) {
     consume(TOKEN_IDENTIFIER, "Expect class name.");
     Token className = parser.previous;
     uint8_t nameConstant = identifierConstant(&parser.previous);
@@ -1221,6 +1791,8 @@ static void classDeclaration() {
     }
 
     consume(TOKEN_RIGHT_BRACE, "Expect '}' after class body.");
+    if (sealed)
+        emitByte(OP_SEAL);
     emitByte(OP_POP);
 
     // Close scope in which "super" is visible.
@@ -1231,6 +1803,207 @@ static void classDeclaration() {
     currentClass = currentClass->enclosing;
 }
 
+/**
+ * Compile a record declaration: `record Name(field, ...);`. The record type is assigned to a variable, like a class.
+ */
+static void recordDeclaration() {
+    consume(TOKEN_IDENTIFIER, "Expect record name.");
+    uint8_t nameConstant = identifierConstant(&parser.previous);
+    declareVariable();
+
+    uint8_t fields[UINT8_COUNT];
+    Token fieldNames[UINT8_COUNT];
+    int fieldCount = 0;
+    consume(TOKEN_LEFT_PAREN, "Expect '(' after record name.");
+    if (!check(TOKEN_RIGHT_PAREN)) {
+        do {
+            consume(TOKEN_IDENTIFIER, "Expect field name.");
+            for (int i = 0; i < fieldCount; i++) {
+                if (identifiersEqual(&fieldNames[i], &parser.previous))
+                    error("Already a field with this name in this record.");
+            }
+            if (fieldCount == UINT8_MAX) {
+                error("Can't have more than 255 fields.");
+            } else {
+                fieldNames[fieldCount] = parser.previous;
+                fields[fieldCount++] = identifierConstant(&parser.previous);
+            }
+        } while (match(TOKEN_COMMA));
+    }
+    consume(TOKEN_RIGHT_PAREN, "Expect ')' after record fields.");
+    consume(TOKEN_SEMICOLON, "Expect ';' after record declaration.");
+
+    emitTwoBytes(OP_RECORD, nameConstant);
+    emitByte(fieldCount);
+    for (int i = 0; i < fieldCount; i++) {
+        emitByte(fields[i]);
+    }
+    defineVariable(nameConstant);
+}
+
+static Value constantValue();
+
+/**
+ * Parse the rest of an interpolated string in the value of a constant, like `"v${MAJOR}.${MINOR}"`. The expressions
+ * must be constant values too, and the string is joined right away.
+ *
+ * @return The string.
+ */
+static Value constantInterpolation() {
+    // Written out like `print` does, which is what OP_BUILD_STRING does too.
+    MemorySink sink = {NULL, 0, 0};
+    Output output;
+    initOutput(&output, 0, FLUSH_EXPLICIT);
+    output.sink = memorySink;
+    output.sinkData = &sink;
+    do {
+        ObjString *part = stringLiteral(parser.previous.start + 1, parser.previous.length - 3);
+        writeOutput(&output, part->chars, part->length);
+        writeValue(&output, constantValue());
+    } while (match(TOKEN_INTERPOLATION));
+
+    consume(TOKEN_STRING, "Expect end of string after interpolation.");
+    ObjString *part = stringLiteral(parser.previous.start + 1, parser.previous.length - 2);
+    writeOutput(&output, part->chars, part->length);
+    freeOutput(&output);
+
+    ObjString *string = copyString(sink.chars == NULL ? "" : sink.chars, (int) sink.length);
+    freeMemorySink(&sink);
+    return OBJ_VAL(string);
+}
+
+/**
+ * Parse the value of a constant: a literal, an interpolated string of constants, possibly a negative number, or another
+ * constant.
+ *
+ * @return The value.
+ */
+static Value constantValue() {
+    bool negate = match(TOKEN_MINUS);
+    Value value = NIL_VAL;
+    if (match(TOKEN_NUMBER)) {
+        double number;
+        parseNumber(parser.previous.start, parser.previous.length, &number);
+        value = NUMBER_VAL(number);
+        if (negate)
+            value = NUMBER_VAL(-AS_NUMBER(value));
+    } else if (negate) {
+        error("Expect number after '-'.");
+    } else if (match(TOKEN_STRING)) {
+        value = OBJ_VAL(stringLiteral(parser.previous.start + 1, parser.previous.length - 2));
+    } else if (match(TOKEN_INTERPOLATION)) {
+        value = constantInterpolation();
+    } else if (match(TOKEN_TRUE)) {
+        value = BOOL_VAL(true);
+    } else if (match(TOKEN_FALSE)) {
+        value = BOOL_VAL(false);
+    } else if (match(TOKEN_NIL)) {
+        value = NIL_VAL;
+    } else if (!match(TOKEN_IDENTIFIER) || !resolveConstant(&parser.previous, &value)) {
+        error("Constant value must be a literal or another constant.");
+    }
+    return value;
+}
+
+/**
+ * Define a constant that was just declared. A local constant still takes a stack slot, so that scopes work as usual,
+ * but no code ever reads it. A global constant is also defined as a global variable, for code compiled before it.
+ *
+ * @param name The name of the constant.
+ * @param value The value of the constant.
+ */
+static void defineConstant(Token *name, Value value) {
+    if (current->scopeDepth > 0) {
+        Local *local = &current->locals[current->localCount - 1];
+        local->isConst = true;
+        local->constant = value;
+        emitConstant(value);
+        markInitialized();
+        return;
+    }
+
+    // Keep the value safe while the name is allocated.
+    push(value);
+    uint8_t global = identifierConstant(name);
+    tableSet(&pendingConstants, AS_STRING(currentChunk()->constants.values[global]), value);
+    pop();
+
+    emitConstant(value);
+    emitTwoBytes(OP_DEFINE_GLOBAL, global);
+}
+
+/**
+ * Compile a constant declaration: `const NAME = value;`. Reading the constant compiles to its value.
+ */
+static void constDeclaration() {
+    consume(TOKEN_IDENTIFIER, "Expect constant name.");
+    Token name = parser.previous;
+    declareVariable();
+
+    consume(TOKEN_EQUAL, "Expect '=' after constant name.");
+    Value value = constantValue();
+    consume(TOKEN_SEMICOLON, "Expect ';' after constant declaration.");
+
+    defineConstant(&name, value);
+}
+
+/**
+ * Compile an enum declaration: `enum Name { A, B = 10, C }`. Members are numbers, counting up from 0 or from the last
+ * explicit value. The enum is a constant record with a field per member, so `Name.A` compiles to the member's value.
+ */
+static void enumDeclaration() {
+    consume(TOKEN_IDENTIFIER, "Expect enum name.");
+    Token name = parser.previous;
+    declareVariable();
+
+    Token members[UINT8_COUNT];
+    Value values[UINT8_COUNT];
+    int count = 0;
+    double next = 0;
+    consume(TOKEN_LEFT_BRACE, "Expect '{' before enum body.");
+    while (!check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF)) {
+        consume(TOKEN_IDENTIFIER, "Expect member name.");
+        Token member = parser.previous;
+        for (int i = 0; i < count; i++) {
+            if (identifiersEqual(&members[i], &member))
+                error("Already a member with this name in this enum.");
+        }
+
+        if (match(TOKEN_EQUAL)) {
+            Value value = constantValue();
+            if (IS_NUMBER(value))
+                next = AS_NUMBER(value);
+            else
+                error("Enum member value must be a number.");
+        }
+
+        if (count == UINT8_MAX) {
+            error("Can't have more than 255 members in an enum.");
+        } else {
+            members[count] = member;
+            values[count++] = NUMBER_VAL(next);
+        }
+        next++;
+
+        if (!match(TOKEN_COMMA))
+            break;
+    }
+    consume(TOKEN_RIGHT_BRACE, "Expect '}' after enum body.");
+
+    // Everything stays on the stack while it is being built.
+    push(OBJ_VAL(copyString(name.start, name.length)));
+    ObjRecordType *type = newRecordType(AS_STRING(vm.stackTop[-1]), count);
+    push(OBJ_VAL(type));
+    for (int i = 0; i < count; i++) {
+        type->fields[i] = copyString(members[i].start, members[i].length);
+    }
+    ObjRecord *record = newRecord(type, values);
+    pop();
+    pop();
+
+    defineConstant(&name, OBJ_VAL(record));
+}
+
 /**
  * Parse a function's declaration and assign it to a variable.
  */
@@ -1243,6 +2016,42 @@ static void funDeclaration() {
     defineVariable(global);
 }
 
+/**
+ * Assign several variables at once from a call returning as many values: `min, max = bounds(list);`.
+ */
+static void multipleAssignment() {
+    Token targets[UINT8_COUNT];
+    int count = 0;
+    do {
+        consume(TOKEN_IDENTIFIER, "Expect variable name.");
+        if (count == UINT8_MAX)
+            error("Can't assign more than 255 variables at once.");
+        else
+            targets[count++] = parser.previous;
+    } while (match(TOKEN_COMMA));
+    consume(TOKEN_EQUAL, "Expect '=' after assignment targets.");
+
+    expression();
+    emitTwoBytes(OP_UNPACK, count);
+    consume(TOKEN_SEMICOLON, "Expect ';' after expression.");
+
+    // The last value is on top.
+    for (int i = count - 1; i >= 0; i--) {
+        Value constant;
+        if (resolveConstant(&targets[i], &constant))
+            error("Can't assign to a constant.");
+        uint8_t getOp, setOp;
+        bool isNumber;
+        int arg = resolveVariable(&targets[i], &getOp, &setOp, &isNumber);
+        if (isNumber) {
+            parser.numeric = false;
+            emitNumberGuard("'%.*s'", &targets[i]);
+        }
+        emitTwoBytes(setOp, (uint8_t) arg);
+        emitByte(OP_POP);
+    }
+}
+
 /**
  * An expression statement is just an expression followed by a semicolon.
  */
@@ -1309,10 +2118,26 @@ static void returnStatement() {
         if (current->type == TYPE_INITIALIZER)
             error("Can't return a value from an initializer.");
 
-        // Return something.
-        expression();
+        // Return something, or several things.
+        int count = 0;
+        do {
+            expression();
+            if (count == UINT8_MAX)
+                error("Can't return more than 255 values.");
+            else
+                count++;
+        } while (match(TOKEN_COMMA));
         consume(TOKEN_SEMICOLON, "Expect ';' after return value.");
-        emitByte(OP_RETURN);
+
+        if (current->returnsNumber && count > 1)
+            error("A function returning a number returns a single value.");
+        if (current->returnsNumber && !parser.numeric)
+            emitReturnGuard();
+
+        if (count == 1)
+            emitByte(OP_RETURN);
+        else
+            emitTwoBytes(OP_RETURN_VALUES, count);
     }
 }
 
@@ -1422,6 +2247,10 @@ static void synchronize() {
         // some tokens clearly indicate a new one must have begun.
         switch (parser.current.type) {
             case TOKEN_CLASS:
+            case TOKEN_SEALED:
+            case TOKEN_RECORD:
+            case TOKEN_CONST:
+            case TOKEN_ENUM:
             case TOKEN_FUN:
             case TOKEN_VAR:
             case TOKEN_FOR:
@@ -1444,7 +2273,16 @@ static void synchronize() {
 static void declaration() {
 
     if (match(TOKEN_CLASS)) {
-        classDeclaration();
+        classDeclaration(false);
+    } else if (match(TOKEN_RECORD)) {
+        recordDeclaration();
+    } else if (match(TOKEN_CONST)) {
+        constDeclaration();
+    } else if (match(TOKEN_ENUM)) {
+        enumDeclaration();
+    } else if (match(TOKEN_SEALED)) {
+        consume(TOKEN_CLASS, "Expect 'class' after 'sealed'.");
+        classDeclaration(true);
     } else if (match(TOKEN_FUN)) {
         funDeclaration();
     } else if (match(TOKEN_VAR)) {
@@ -1473,11 +2311,72 @@ static void statement() {
         beginScope();
         block();
         endScope();
+    } else if (check(TOKEN_IDENTIFIER) && peekToken().type == TOKEN_COMMA) {
+        multipleAssignment();
     } else {
         expressionStatement();
     }
 }
 
+/**
+ * Mark a name as assigned.
+ *
+ * @param name The identifier.
+ */
+static void markAssigned(Token *name) {
+    ObjString *string = copyString(name->start, name->length);
+    // Keep the name safe while the table grows.
+    push(OBJ_VAL(string));
+    tableSet(&assignedNames, string, NIL_VAL);
+    pop();
+}
+
+/**
+ * Scan the whole source ahead of compilation and collect the names that are assigned to: identifiers, or lists of
+ * identifiers such as `a, b`, followed by `=` and not preceded by `.`, `var` or `const`. This lets the compiler know
+ * whether a local is ever assigned when it is captured, even if the assignment comes later in the source. Names are not
+ * resolved, so the result is conservative: a local counts as assigned if any variable with the same name is, and the
+ * type in `var x: num = 1` counts as assigned too.
+ *
+ * @param source Source code.
+ */
+static void scanAssignments(const char *source) {
+    initScanner(source);
+
+    // The identifiers separated by commas seen last, and the token before the first of them.
+    Token chain[UINT8_COUNT];
+    int chainLength = 0;
+    TokenType beforeChain = TOKEN_EOF;
+
+    Token previous, token;
+    previous.type = TOKEN_EOF;
+    for (token = scanToken(); token.type != TOKEN_EOF; token = scanToken()) {
+        if (token.type == TOKEN_IDENTIFIER) {
+            if (previous.type != TOKEN_COMMA || chainLength == 0) {
+                chainLength = 0;
+                beforeChain = previous.type;
+            }
+            // Too long to be a valid assignment anyway, but stay conservative.
+            if (chainLength == UINT8_COUNT) {
+                markAssigned(&token);
+            } else {
+                chain[chainLength++] = token;
+            }
+        } else if (token.type == TOKEN_EQUAL && previous.type == TOKEN_IDENTIFIER) {
+            // After a colon this may be a type annotation, `var x: num = 1`, but also a map value, `{"k": x = 1}`.
+            if (beforeChain != TOKEN_DOT && beforeChain != TOKEN_VAR && beforeChain != TOKEN_CONST) {
+                for (int i = 0; i < chainLength; i++) {
+                    markAssigned(&chain[i]);
+                }
+            }
+            chainLength = 0;
+        } else if (token.type != TOKEN_COMMA || previous.type != TOKEN_IDENTIFIER) {
+            chainLength = 0;
+        }
+        previous = token;
+    }
+}
+
 /**
  * Compile source code into a chunk of bytecode.
  *
@@ -1485,6 +2384,10 @@ static void statement() {
  * @return the compiled function if compilation was successful, NULL otherwise if it was not.
  */
 ObjFunction *compile(const char *source) {
+    initTable(&assignedNames);
+    initTable(&pendingConstants);
+    scanAssignments(source);
+
     initScanner(source);
     Compiler compiler;
     initCompiler(&compiler, TYPE_SCRIPT);
@@ -1499,16 +2402,32 @@ ObjFunction *compile(const char *source) {
     }
 
     ObjFunction *function = endCompiler();
+    freeTable(&assignedNames);
+    // The function is no compiler's anymore, it stays on the stack while the table grows.
+    if (!parser.hadError) {
+        push(OBJ_VAL(function));
+        tableAddAll(&pendingConstants, &vm.constants);
+        pop();
+    }
+    freeTable(&pendingConstants);
     return parser.hadError ? NULL : function;
 }
 
 /**
- * The only object the compiler needs to hang onto is the function it is compiling.
+ * The compiler needs to hang onto the function it is compiling, the names it found assigned and the constants it
+ * found.
  */
 void markCompilerRoots() {
     Compiler *compiler = current;
     while (compiler != NULL) {
         markObject((Obj *) compiler->function);
+        // Constants live in the locals until they are emitted.
+        for (int i = 0; i < compiler->localCount; i++) {
+            if (compiler->locals[i].isConst)
+                markValue(compiler->locals[i].constant);
+        }
         compiler = compiler->enclosing;
     }
+    markTable(&assignedNames);
+    markTable(&pendingConstants);
 }
\ No newline at end of file
@@ -46,15 +46,28 @@ static int constantInstruction(const char *name, Chunk *chunk, int offset) {
 }
 
 /**
- * Print invocation instruction.
+ * Print a constant instruction followed by the 2-byte selector of the method it names.
+ */
+static int selectorInstruction(const char *name, Chunk *chunk, int offset) {
+    uint8_t constant = chunk->code[offset + 1];
+    uint16_t selector = (uint16_t) (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+    printf("%-16s %4d '", name, constant);
+    printValue(chunk->constants.values[constant]);
+    printf("' #%d\n", selector);
+    return offset + 4;
+}
+
+/**
+ * Print invocation instruction. Operands are the method name, the argument count and the selector.
  */
 static int invokeInstruction(const char *name, Chunk *chunk, int offset) {
     uint8_t constant = chunk->code[offset + 1];
     uint8_t argCount = chunk->code[offset + 2];
+    uint16_t selector = (uint16_t) (chunk->code[offset + 3] << 8) | chunk->code[offset + 4];
     printf("%-16s (%d args) %4d '", name, argCount, constant);
     printValue(chunk->constants.values[constant]);
-    printf("'\n");
-    return offset + 3;
+    printf("' #%d\n", selector);
+    return offset + 5;
 }
 
 void disassembleChunk(Chunk *chunk, const char *name) {
@@ -84,7 +97,8 @@ int disassembleInstruction(Chunk *chunk, int offset) {
         case OP_SET_GLOBAL:
         case OP_GET_PROPERTY:
         case OP_SET_PROPERTY:
-        case OP_GET_SUPER:
+        case OP_INIT_PROPERTY:
+        case OP_CHECK_NUMBER:
         case OP_CLASS:
         case OP_METHOD:
             return constantInstruction(name, chunk, offset);
@@ -101,16 +115,32 @@ int disassembleInstruction(Chunk *chunk, int offset) {
         case OP_DIVIDE:
         case OP_NOT:
         case OP_NEGATE:
+        case OP_GREATER_NUMBER:
+        case OP_LESS_NUMBER:
+        case OP_ADD_NUMBER:
+        case OP_SUBTRACT_NUMBER:
+        case OP_MULTIPLY_NUMBER:
+        case OP_DIVIDE_NUMBER:
+        case OP_NEGATE_NUMBER:
+        case OP_GET_INDEX:
+        case OP_SET_INDEX:
         case OP_PRINT:
         case OP_CLOSE_UPVALUE:
         case OP_INHERIT:
+        case OP_SEAL:
         case OP_RETURN:
             return simpleInstruction(name, offset);
         case OP_GET_LOCAL:
         case OP_SET_LOCAL:
         case OP_GET_UPVALUE:
         case OP_SET_UPVALUE:
+        case OP_GET_CAPTURED:
         case OP_CALL:
+        case OP_RETURN_VALUES:
+        case OP_UNPACK:
+        case OP_BUILD_STRING:
+        case OP_BUILD_LIST:
+        case OP_BUILD_MAP:
             return byteInstruction(name, chunk, offset);
         case OP_JUMP:
         case OP_JUMP_IF_FALSE:
@@ -120,6 +150,21 @@ int disassembleInstruction(Chunk *chunk, int offset) {
         case OP_INVOKE:
         case OP_SUPER_INVOKE:
             return invokeInstruction(name, chunk, offset);
+        case OP_GET_SUPER:
+            return selectorInstruction(name, chunk, offset);
+        case OP_RECORD: {
+            uint8_t constant = chunk->code[offset + 1];
+            uint8_t fieldCount = chunk->code[offset + 2];
+            printf("%-16s %4d '", name, constant);
+            printValue(chunk->constants.values[constant]);
+            printf("' (");
+            for (int j = 0; j < fieldCount; j++) {
+                printf(j > 0 ? ", " : "");
+                printValue(chunk->constants.values[chunk->code[offset + 3 + j]]);
+            }
+            printf(")\n");
+            return offset + 3 + fieldCount;
+        }
         case OP_CLOSURE: {
             offset++;
             uint8_t constant = chunk->code[offset++];
@@ -128,10 +173,16 @@ int disassembleInstruction(Chunk *chunk, int offset) {
             printf("\n");
 
             ObjFunction *function = AS_FUNCTION(chunk->constants.values[constant]);
-            for (int j = 0; j < function->upvalueCount; j++) {
-                int isLocal = chunk->code[offset++];
+            static const char *kindNames[] = {
+                    [CAPTURE_UPVALUE]  = "upvalue",
+                    [CAPTURE_LOCAL]    = "local",
+                    [CAPTURE_VALUE]    = "value",
+                    [CAPTURE_CAPTURED] = "captured",
+            };
+            for (int j = 0; j < function->upvalueCount + function->capturedCount; j++) {
+                int kind = chunk->code[offset++];
                 int index = chunk->code[offset++];
-                printf("%08d      |                     %s %d\n", offset - 2, isLocal ? "local" : "upvalue", index);
+                printf("%08d      |                     %s %d\n", offset - 2, kindNames[kind], index);
             }
 
             return offset;
@@ -161,6 +212,10 @@ void printToken(Token *token) {
             printf("STRING");
             break;
         }
+        case TOKEN_INTERPOLATION: {
+            printf("INTERPOLATION");
+            break;
+        }
         case TOKEN_IDENTIFIER: {
             printf("IDENTIFIER");
             break;
@@ -0,0 +1,294 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "filelib.h"
+#include "memory.h"
+#include "vm.h"
+
+/**
+ * How many bytes a file is read at a time. Records longer than this make the buffer grow.
+ */
+#define FILE_CHUNK_SIZE (64 * 1024)
+
+/**
+ * Open a file for reading, raising an error if it can't be.
+ *
+ * @param path The path, as passed to the native.
+ * @return The file descriptor, -1 if the file could not be opened.
+ */
+static int openForReading(Value path) {
+    if (!IS_STRING(path)) {
+        nativeError("Expected a string as argument 1 but got %s.", typeName(path));
+        return -1;
+    }
+
+    int fd;
+    do {
+        fd = open(AS_C_STRING(path), O_RDONLY);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+        nativeError("Can't open file '%s': %s.", AS_C_STRING(path), strerror(errno));
+    return fd;
+}
+
+/**
+ * Read from a file descriptor, trying again when interrupted by a signal.
+ *
+ * @return How many bytes were read, 0 at the end of the file, -1 on errors.
+ */
+static ssize_t readSome(int fd, char *buffer, size_t size) {
+    ssize_t count;
+    do {
+        count = read(fd, buffer, size);
+    } while (count < 0 && errno == EINTR);
+    return count;
+}
+
+/**
+ * `readFile(path)`: the whole content of a file, as a string. The buffer is sized from the file, so a regular file
+ * takes a single read.
+ */
+static Value readFileNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount, 1, 1))
+        return EMPTY_VAL;
+    int fd = openForReading(args[0]);
+    if (fd < 0)
+        return EMPTY_VAL;
+
+    // One more byte than the size, to see the end of the file without growing. Pipes and the like have no size.
+    struct stat info;
+    size_t capacity = FILE_CHUNK_SIZE;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && (size_t) info.st_size < INT_MAX)
+        capacity = (size_t) info.st_size + 1;
+
+    char *chars = ALLOCATE(char, capacity);
+    size_t length = 0;
+    for (;;) {
+        if (length == capacity) {
+            if (capacity > INT_MAX / 2) {
+                FREE_ARRAY(char, chars, capacity);
+                close(fd);
+                return nativeError("File '%s' is too big to read at once.", AS_C_STRING(args[0]));
+            }
+            chars = GROW_ARRAY(char, chars, capacity, capacity * 2);
+            capacity *= 2;
+        }
+        ssize_t count = readSome(fd, chars + length, capacity - length);
+        if (count < 0) {
+            int error = errno;
+            FREE_ARRAY(char, chars, capacity);
+            close(fd);
+            return nativeError("Can't read file '%s': %s.", AS_C_STRING(args[0]), strerror(error));
+        }
+        if (count == 0)
+            break;
+        length += count;
+    }
+    close(fd);
+
+    // The string owns exactly its length and the terminator.
+    chars = GROW_ARRAY(char, chars, capacity, length + 1);
+    chars[length] = '\0';
+    return OBJ_VAL(takeString(chars, (int) length));
+}
+
+/**
+ * `writeFile(path, text)`: write a string to a file, replacing what the file had, creating it if it does not exist.
+ */
+static Value writeFileNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount, 2, 2))
+        return EMPTY_VAL;
+    if (!IS_STRING(args[0]))
+        return nativeError("Expected a string as argument 1 but got %s.", typeName(args[0]));
+    if (!IS_STRING(args[1]))
+        return nativeError("Expected a string as argument 2 but got %s.", typeName(args[1]));
+
+    int fd;
+    do {
+        fd = open(AS_C_STRING(args[0]), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+        return nativeError("Can't open file '%s': %s.", AS_C_STRING(args[0]), strerror(errno));
+
+    // Writes can be partial, to pipes for instance.
+    ObjString *text = AS_STRING(args[1]);
+    int written = 0;
+    while (written < text->length) {
+        ssize_t count = write(fd, text->chars + written, text->length - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0) {
+            int error = errno;
+            close(fd);
+            return nativeError("Can't write file '%s': %s.", AS_C_STRING(args[0]), strerror(error));
+        }
+        written += (int) count;
+    }
+    close(fd);
+    return NIL_VAL;
+}
+
+/**
+ * `openFile(path)`: a file to read a line or a record at a time.
+ */
+static Value openFileNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount, 1, 1))
+        return EMPTY_VAL;
+    int fd = openForReading(args[0]);
+    if (fd < 0)
+        return EMPTY_VAL;
+    return OBJ_VAL(newFile(AS_STRING(args[0]), fd));
+}
+
+bool fillBuffer(ObjFile *file) {
+    if (file->start > 0) {
+        memmove(file->buffer, file->buffer + file->start, file->end - file->start);
+        file->end -= file->start;
+        file->start = 0;
+    }
+    if (file->end == file->capacity) {
+        if (file->capacity > INT_MAX / 2) {
+            nativeError("Record too long in file '%s'.", file->path->chars);
+            return false;
+        }
+        int capacity = file->capacity == 0 ? FILE_CHUNK_SIZE : file->capacity * 2;
+        file->buffer = GROW_ARRAY(char, file->buffer, file->capacity, capacity);
+        file->capacity = capacity;
+    }
+
+    ssize_t count = readSome(file->fd, file->buffer + file->end, file->capacity - file->end);
+    if (count < 0) {
+        nativeError("Can't read file '%s': %s.", file->path->chars, strerror(errno));
+        return false;
+    }
+    if (count == 0)
+        file->atEnd = true;
+    file->end += (int) count;
+    return true;
+}
+
+bool nextRecord(ObjFile *file, char separator, bool isLine, Value *record) {
+    // How many bytes after `start` are known not to be the separator, so a long record is not searched twice.
+    int searched = 0;
+    for (;;) {
+        const char *from = file->buffer + file->start;
+        int available = file->end - file->start;
+        const char *found = available > searched ? memchr(from + searched, separator, available - searched) : NULL;
+
+        // At the end of the file, whatever is left is the last record.
+        if (found == NULL && file->atEnd) {
+            if (available == 0) {
+                *record = NIL_VAL;
+                return true;
+            }
+            found = from + available;
+        }
+
+        if (found != NULL) {
+            int length = (int) (found - from);
+            int next = file->start + length + (length < available ? 1 : 0);
+            if (isLine && length > 0 && from[length - 1] == '\r')
+                length--;
+            *record = OBJ_VAL(copyString(from, length));
+            file->start = next;
+            return true;
+        }
+
+        searched = available;
+        if (!fillBuffer(file))
+            return false;
+    }
+}
+
+/**
+ * Check a file can still be read, raising an error if not.
+ */
+static bool checkOpen(ObjFile *file) {
+    if (file->fd >= 0)
+        return true;
+    nativeError("File '%s' is closed.", file->path->chars);
+    return false;
+}
+
+/**
+ * `file.readLine()`: the next line, without its line break, nil at the end of the file.
+ */
+static Value readLineNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0) || !checkOpen(AS_FILE(args[0])))
+        return EMPTY_VAL;
+    Value line;
+    if (!nextRecord(AS_FILE(args[0]), '\n', true, &line))
+        return EMPTY_VAL;
+    return line;
+}
+
+/**
+ * `file.readRecord(separator)`: the text up to the next separator, a single character, nil at the end of the file.
+ */
+static Value readRecordNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !checkOpen(AS_FILE(args[0])))
+        return EMPTY_VAL;
+    if (!IS_STRING(args[1]) || AS_STRING(args[1])->length != 1)
+        return nativeError("Separator must be a single character.");
+    Value record;
+    if (!nextRecord(AS_FILE(args[0]), AS_C_STRING(args[1])[0], false, &record))
+        return EMPTY_VAL;
+    return record;
+}
+
+/**
+ * `file.eachLine(handler)`: call the handler with each line left in the file, until it returns false. Returns how many
+ * lines the handler got.
+ */
+static Value eachLineNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !checkOpen(AS_FILE(args[0])))
+        return EMPTY_VAL;
+    ObjFile *file = AS_FILE(args[0]);
+
+    int count = 0;
+    for (;;) {
+        // The handler may close the file.
+        if (file->fd < 0)
+            break;
+        Value line;
+        if (!nextRecord(file, '\n', true, &line))
+            return EMPTY_VAL;
+        if (IS_NIL(line))
+            break;
+
+        // The line is on the stack for the duration of the call.
+        push(line);
+        Value result;
+        if (!callFunction(args[1], 1, vm.stackTop - 1, &result))
+            return EMPTY_VAL;
+        pop();
+        count++;
+        if (IS_BOOL(result) && !AS_BOOL(result))
+            break;
+    }
+    return NUMBER_VAL(count);
+}
+
+/**
+ * `file.close()`: close the file and free its buffer. Closing a closed file does nothing.
+ */
+static Value closeNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    closeFile(AS_FILE(args[0]));
+    return NIL_VAL;
+}
+
+void initFileLibrary() {
+    defineNative("readFile", readFileNative);
+    defineNative("writeFile", writeFileNative);
+    defineNative("openFile", openFileNative);
+    defineNativeMethod(vm.fileClass, "readLine", readLineNative);
+    defineNativeMethod(vm.fileClass, "readRecord", readRecordNative);
+    defineNativeMethod(vm.fileClass, "eachLine", eachLineNative);
+    defineNativeMethod(vm.fileClass, "close", closeNative);
+}
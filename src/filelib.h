@@ -0,0 +1,35 @@
+#ifndef NAMELESS_FILELIB_H
+#define NAMELESS_FILELIB_H
+
+#include "common.h"
+#include "object.h"
+
+/**
+ * Define the natives reading files: `readFile(path)` for a whole file at once, and `openFile(path)` for a file to be
+ * read a line or a record at a time, with the methods `readLine()`, `readRecord(separator)`, `eachLine(handler)` and
+ * `close()`. See `vm.fileClass`. `writeFile(path, text)` writes a whole file at once.
+ */
+void initFileLibrary();
+
+/**
+ * Read the next chunk of a file into its buffer, after the bytes not handed out yet, the ones from `file->start` on.
+ * Those move to the front of the buffer first, and the buffer only grows if they fill it. At the end of the file,
+ * nothing is read and `file->atEnd` is set.
+ *
+ * @param file The file, which must be reachable.
+ * @return Whether the read went fine, if not an error was reported.
+ */
+bool fillBuffer(ObjFile *file);
+
+/**
+ * Cut the next record out of a file, reading more of it when the buffer holds no separator.
+ *
+ * @param file The file, which must be reachable.
+ * @param separator What ends a record. It is not part of the record.
+ * @param isLine Whether records are lines, in which case a carriage return before the separator is dropped too.
+ * @param record Output parameter, the record, nil at the end of the file.
+ * @return Whether the read went fine, if not an error was reported.
+ */
+bool nextRecord(ObjFile *file, char separator, bool isLine, Value *record);
+
+#endif
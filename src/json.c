@@ -0,0 +1,851 @@
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filelib.h"
+#include "json.h"
+#include "memory.h"
+#include "number.h"
+#include "vm.h"
+
+/**
+ * Every byte of a 64 bit word set to 0x01, and to 0x80. Multiplying the first by a byte repeats the byte in the word.
+ */
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+/**
+ * @return A word with the high bit set in (at least) the first byte of `word` which is below `limit`, 0 if there is
+ * none. `limit` can be up to 128.
+ */
+static inline uint64_t bytesBelow(uint64_t word, uint8_t limit) {
+    return (word - ONES * limit) & ~word & HIGHS;
+}
+
+/**
+ * Skip the characters of a string that can be written as they are, in JSON text or on the way to it: anything but a
+ * quote, a backslash or a control character. Most strings have few others, so eight bytes are checked at a time, in a
+ * single 64 bit word.
+ *
+ * @param current Where to start.
+ * @param end Where the text ends.
+ * @return The first character that is not plain, or `end`.
+ */
+static const char *skipPlainChars(const char *current, const char *end) {
+    while (end - current >= 8) {
+        uint64_t word;
+        memcpy(&word, current, 8);
+        // A byte of the word is 0 after xor with the character it equals.
+        if (bytesBelow(word ^ (ONES * '"'), 1) | bytesBelow(word ^ (ONES * '\\'), 1) | bytesBelow(word, 0x20))
+            break;
+        current += 8;
+    }
+    while (current < end && *current != '"' && *current != '\\' && (uint8_t) *current >= 0x20) {
+        current++;
+    }
+    return current;
+}
+
+// Parsing.
+
+/**
+ * What the handler of a streaming parse is told about.
+ */
+typedef enum {
+    EVENT_START_OBJECT,
+    EVENT_KEY,
+    EVENT_END_OBJECT,
+    EVENT_START_ARRAY,
+    EVENT_END_ARRAY,
+    EVENT_VALUE,
+    EVENT_COUNT,
+} JsonEvent;
+
+static const char *eventNames[] = {
+        [EVENT_START_OBJECT] = "startObject",
+        [EVENT_KEY]          = "key",
+        [EVENT_END_OBJECT]   = "endObject",
+        [EVENT_START_ARRAY]  = "startArray",
+        [EVENT_END_ARRAY]    = "endArray",
+        [EVENT_VALUE]        = "value",
+};
+
+typedef struct {
+    const char *start;      // The text since `line` started being counted, for error messages.
+    const char *current;
+    const char *end;
+    int line;               // The line `start` is on.
+    ObjFile *file;          // The file the text is read from a chunk at a time, NULL to parse a string.
+    bool readFailed;        // Reading the file failed, the error was reported already.
+    int depth;              // How many arrays and objects the parser is in.
+    Value handler;          // Called for each element in a streaming parse, nil to build the value instead.
+    Value *events;          // Names of the events, as strings on the stack.
+    bool stopped;           // The handler asked to stop.
+    char *scratch;          // Where strings with escapes are put back together. Not managed, freed at the end.
+    int scratchCapacity;
+} JsonParser;
+
+/**
+ * Report an error in the text, with the line it is on.
+ *
+ * @return false.
+ */
+static bool parseError(JsonParser *parser, const char *message) {
+    if (parser->readFailed)
+        return false;
+    int line = parser->line;
+    for (const char *c = parser->start; c < parser->current; c++) {
+        if (*c == '\n')
+            line++;
+    }
+    nativeError("Invalid JSON at line %d: %s", line, message);
+    return false;
+}
+
+/**
+ * Report an error in a string, like `parseError`.
+ *
+ * @return NULL.
+ */
+static ObjString *stringError(JsonParser *parser, const char *message) {
+    parseError(parser, message);
+    return NULL;
+}
+
+/**
+ * Count the lines of the text up to a point, so that the text before it can go.
+ */
+static void countLines(JsonParser *parser, const char *to) {
+    for (const char *c = parser->start; c < to; c++) {
+        if (*c == '\n')
+            parser->line++;
+    }
+    parser->start = to;
+}
+
+/**
+ * Read the next chunk of the file, in a parse from a file.
+ *
+ * @param parser The parser.
+ * @param keep Where the text still needed starts, up to the current character. What comes before can go.
+ * @return Whether more text came, false at the end of the file or on errors.
+ */
+static bool readMore(JsonParser *parser, const char *keep) {
+    ObjFile *file = parser->file;
+    if (file == NULL || file->atEnd || parser->readFailed)
+        return false;
+
+    countLines(parser, keep);
+    int offset = (int) (parser->current - keep);
+    int available = (int) (parser->end - keep);
+    file->start = (int) (keep - file->buffer);
+    if (!fillBuffer(file)) {
+        parser->readFailed = true;
+        return false;
+    }
+    // The buffer may have moved.
+    parser->start = file->buffer + file->start;
+    parser->current = parser->start + offset;
+    parser->end = file->buffer + file->end;
+    return parser->end - parser->start > available;
+}
+
+/**
+ * Make sure some characters are left, reading more of the file if there is one.
+ *
+ * @return Whether at least `count` characters are left.
+ */
+static inline bool hasChars(JsonParser *parser, int count) {
+    while (parser->end - parser->current < count) {
+        if (!readMore(parser, parser->current))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Give something the handler, in a streaming parse.
+ *
+ * @param parser The parser.
+ * @param event What the handler is told about.
+ * @param value The value that goes with it, nil for the start and end of arrays and objects. It must be reachable.
+ * @return Whether the handler ran without errors.
+ */
+static bool emit(JsonParser *parser, JsonEvent event, Value value) {
+    // The handler may read from the file too, so the file knows where the parse is, and the parse goes on from where
+    // the handler left the file.
+    ObjFile *file = parser->file;
+    if (file != NULL) {
+        countLines(parser, parser->current);
+        file->start = (int) (parser->current - file->buffer);
+    }
+
+    // The arguments are on the stack for the duration of the call.
+    push(parser->events[event]);
+    push(value);
+    Value result;
+    if (!callFunction(parser->handler, 2, vm.stackTop - 2, &result))
+        return false;
+    vm.stackTop -= 2;
+    if (file != NULL) {
+        if (file->fd < 0) {
+            nativeError("File '%s' was closed while parsing it.", file->path->chars);
+            return false;
+        }
+        parser->start = parser->current = file->buffer + file->start;
+        parser->end = file->buffer + file->end;
+    }
+    if (IS_BOOL(result) && !AS_BOOL(result))
+        parser->stopped = true;
+    return true;
+}
+
+static void skipWhitespace(JsonParser *parser) {
+    while (hasChars(parser, 1)) {
+        char c = *parser->current;
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+            return;
+        parser->current++;
+    }
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Read the four hex digits of a `\u` escape.
+ *
+ * @return The code unit, -1 if the digits are not valid.
+ */
+static int readCodeUnit(JsonParser *parser) {
+    if (!hasChars(parser, 4))
+        return -1;
+    int unit = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hexDigit(*parser->current++);
+        if (digit < 0)
+            return -1;
+        unit = unit * 16 + digit;
+    }
+    return unit;
+}
+
+/**
+ * Encode a code point in UTF-8.
+ *
+ * @return How many bytes it took, at most 4.
+ */
+static int encodeUtf8(int codePoint, char *out) {
+    if (codePoint < 0x80) {
+        out[0] = (char) codePoint;
+        return 1;
+    }
+    if (codePoint < 0x800) {
+        out[0] = (char) (0xC0 | (codePoint >> 6));
+        out[1] = (char) (0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    if (codePoint < 0x10000) {
+        out[0] = (char) (0xE0 | (codePoint >> 12));
+        out[1] = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = (char) (0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char) (0xF0 | (codePoint >> 18));
+    out[1] = (char) (0x80 | ((codePoint >> 12) & 0x3F));
+    out[2] = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+    out[3] = (char) (0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+/**
+ * Read a string, the opening quote already consumed. Strings without escapes are copied straight from the text, as
+ * long as they don't run past the chunk of the file that was read.
+ *
+ * @param parser The parser.
+ * @return The string, NULL if it is not valid.
+ */
+static ObjString *parseString(JsonParser *parser) {
+    const char *start = parser->current;
+    parser->current = skipPlainChars(parser->current, parser->end);
+    if (parser->current < parser->end && *parser->current == '"')
+        return copyString(start, (int) (parser->current++ - start));
+
+    // The string is put back together in the scratch space, a piece between escapes at a time.
+    int length = 0;
+    for (;;) {
+        int needed = length + (int) (parser->current - start) + 4;
+        if (needed > parser->scratchCapacity) {
+            int capacity = GROW_CAPACITY(parser->scratchCapacity);
+            parser->scratchCapacity = capacity < needed ? needed : capacity;
+            parser->scratch = GROW_ARRAY_UNMANAGED(char, parser->scratch, parser->scratchCapacity);
+            if (parser->scratch == NULL)
+                exit(1);
+        }
+        memcpy(parser->scratch + length, start, parser->current - start);
+        length += (int) (parser->current - start);
+
+        // What was read is in the scratch space already, the next chunk can take its place.
+        if (parser->current == parser->end) {
+            if (!readMore(parser, parser->current))
+                return stringError(parser, "Unterminated string.");
+            start = parser->current;
+            parser->current = skipPlainChars(parser->current, parser->end);
+            continue;
+        }
+        if (*parser->current == '"') {
+            parser->current++;
+            break;
+        }
+        if (*parser->current != '\\')
+            return stringError(parser, "Control character in string.");
+        parser->current++;
+        if (!hasChars(parser, 1))
+            return stringError(parser, "Unterminated string.");
+
+        char *out = parser->scratch + length;
+        switch (*parser->current++) {
+            case '"': *out = '"'; length++; break;
+            case '\\': *out = '\\'; length++; break;
+            case '/': *out = '/'; length++; break;
+            case 'b': *out = '\b'; length++; break;
+            case 'f': *out = '\f'; length++; break;
+            case 'n': *out = '\n'; length++; break;
+            case 'r': *out = '\r'; length++; break;
+            case 't': *out = '\t'; length++; break;
+            case 'u': {
+                int codePoint = readCodeUnit(parser);
+                if (codePoint < 0)
+                    return stringError(parser, "Invalid \\u escape.");
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF && hasChars(parser, 6) &&
+                    parser->current[0] == '\\' && parser->current[1] == 'u') {
+                    // A surrogate pair, the low half must follow.
+                    const char *pair = parser->current;
+                    parser->current += 2;
+                    int low = readCodeUnit(parser);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    } else {
+                        parser->current = pair;
+                    }
+                }
+                // Lone surrogates can't be UTF-8.
+                if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+                    codePoint = 0xFFFD;
+                length += encodeUtf8(codePoint, out);
+                break;
+            }
+            default:
+                parser->current--;
+                return stringError(parser, "Invalid escape in string.");
+        }
+        start = parser->current;
+        parser->current = skipPlainChars(parser->current, parser->end);
+    }
+    return copyString(parser->scratch, length);
+}
+
+/**
+ * Read a number, checking it follows the JSON grammar, which is stricter than the language's.
+ *
+ * @param parser The parser.
+ * @param value Output parameter, the number.
+ * @return Whether the number is valid.
+ */
+static bool parseNumberText(JsonParser *parser, double *value) {
+    // A number is not cut in two: read until the text has a character after it, or the file ends.
+    int scanned = 0;
+    for (;;) {
+        const char *c = parser->current + scanned;
+        while (c < parser->end && ((*c >= '0' && *c <= '9') || *c == '-' || *c == '+' || *c == '.' || *c == 'e' ||
+                                   *c == 'E')) {
+            c++;
+        }
+        scanned = (int) (c - parser->current);
+        if (c < parser->end || !readMore(parser, parser->current))
+            break;
+    }
+
+    const char *start = parser->current;
+    const char *c = start;
+    const char *end = parser->end;
+    if (c < end && *c == '-')
+        c++;
+    if (c < end && *c == '0') {
+        c++;
+    } else if (c < end && *c >= '1' && *c <= '9') {
+        while (c < end && *c >= '0' && *c <= '9') c++;
+    } else {
+        return parseError(parser, "Expect a value.");
+    }
+    if (c < end && *c == '.') {
+        c++;
+        if (c == end || *c < '0' || *c > '9') {
+            parser->current = c;
+            return parseError(parser, "Expect digits after '.'.");
+        }
+        while (c < end && *c >= '0' && *c <= '9') c++;
+    }
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        c++;
+        if (c < end && (*c == '+' || *c == '-'))
+            c++;
+        if (c == end || *c < '0' || *c > '9') {
+            parser->current = c;
+            return parseError(parser, "Expect digits in exponent.");
+        }
+        while (c < end && *c >= '0' && *c <= '9') c++;
+    }
+    parser->current = c;
+    if (!parseNumber(start, (int) (c - start), value))
+        return parseError(parser, "Invalid number.");
+    return true;
+}
+
+/**
+ * Read a literal such as `true`.
+ */
+static bool matchLiteral(JsonParser *parser, const char *literal, int length) {
+    if (!hasChars(parser, length) || memcmp(parser->current, literal, length) != 0)
+        return false;
+    parser->current += length;
+    return true;
+}
+
+static bool parseValue(JsonParser *parser);
+
+/**
+ * Make sure there is room on the stack for a nested array or object, and that it is not nested too deeply.
+ */
+static bool enterContainer(JsonParser *parser) {
+    if (++parser->depth > JSON_MAX_DEPTH)
+        return parseError(parser, "Too deeply nested.");
+    // The container, a key and a value.
+    if (vm.stackTop + 3 > vm.stack + STACK_MAX)
+        return parseError(parser, "Too deeply nested.");
+    return true;
+}
+
+/**
+ * Read an object, the opening brace already consumed. When building, the map is left on the stack.
+ */
+static bool parseObject(JsonParser *parser) {
+    if (!enterContainer(parser))
+        return false;
+    bool streaming = !IS_NIL(parser->handler);
+    if (streaming) {
+        if (!emit(parser, EVENT_START_OBJECT, NIL_VAL))
+            return false;
+    } else {
+        push(OBJ_VAL(newMap()));
+    }
+
+    skipWhitespace(parser);
+    if (hasChars(parser, 1) && *parser->current == '}') {
+        parser->current++;
+    } else {
+        for (;;) {
+            if (parser->stopped)
+                return true;
+            skipWhitespace(parser);
+            if (!hasChars(parser, 1) || *parser->current != '"')
+                return parseError(parser, "Expect a string as key.");
+            parser->current++;
+            ObjString *key = parseString(parser);
+            if (key == NULL)
+                return false;
+            push(OBJ_VAL(key));
+            if (streaming) {
+                if (!emit(parser, EVENT_KEY, OBJ_VAL(key)))
+                    return false;
+                if (parser->stopped)
+                    return true;
+            }
+
+            skipWhitespace(parser);
+            if (!hasChars(parser, 1) || *parser->current != ':')
+                return parseError(parser, "Expect ':' after key.");
+            parser->current++;
+            if (!parseValue(parser))
+                return false;
+            if (streaming) {
+                pop();
+            } else {
+                // Duplicate keys: the last one wins.
+                mapSet(AS_MAP(vm.stackTop[-3]), AS_STRING(vm.stackTop[-2]), vm.stackTop[-1]);
+                vm.stackTop -= 2;
+            }
+
+            skipWhitespace(parser);
+            if (hasChars(parser, 1) && *parser->current == ',') {
+                parser->current++;
+                continue;
+            }
+            if (hasChars(parser, 1) && *parser->current == '}') {
+                parser->current++;
+                break;
+            }
+            return parseError(parser, "Expect ',' or '}' after object entry.");
+        }
+    }
+
+    parser->depth--;
+    if (streaming && !parser->stopped)
+        return emit(parser, EVENT_END_OBJECT, NIL_VAL);
+    return true;
+}
+
+/**
+ * Read an array, the opening bracket already consumed. When building, the list is left on the stack.
+ */
+static bool parseArray(JsonParser *parser) {
+    if (!enterContainer(parser))
+        return false;
+    bool streaming = !IS_NIL(parser->handler);
+    if (streaming) {
+        if (!emit(parser, EVENT_START_ARRAY, NIL_VAL))
+            return false;
+    } else {
+        push(OBJ_VAL(newList()));
+    }
+
+    skipWhitespace(parser);
+    if (hasChars(parser, 1) && *parser->current == ']') {
+        parser->current++;
+    } else {
+        for (;;) {
+            if (parser->stopped)
+                return true;
+            if (!parseValue(parser))
+                return false;
+            if (!streaming) {
+                appendToList(AS_LIST(vm.stackTop[-2]), vm.stackTop[-1]);
+                pop();
+            }
+
+            skipWhitespace(parser);
+            if (hasChars(parser, 1) && *parser->current == ',') {
+                parser->current++;
+                continue;
+            }
+            if (hasChars(parser, 1) && *parser->current == ']') {
+                parser->current++;
+                break;
+            }
+            return parseError(parser, "Expect ',' or ']' after array item.");
+        }
+    }
+
+    parser->depth--;
+    if (streaming && !parser->stopped)
+        return emit(parser, EVENT_END_ARRAY, NIL_VAL);
+    return true;
+}
+
+/**
+ * Read any value. When building, the value is left on the stack, otherwise the handler gets it.
+ */
+static bool parseValue(JsonParser *parser) {
+    skipWhitespace(parser);
+    if (!hasChars(parser, 1))
+        return parseError(parser, "Expect a value.");
+
+    Value value;
+    switch (*parser->current) {
+        case '{':
+            parser->current++;
+            return parseObject(parser);
+        case '[':
+            parser->current++;
+            return parseArray(parser);
+        case '"': {
+            parser->current++;
+            ObjString *string = parseString(parser);
+            if (string == NULL)
+                return false;
+            value = OBJ_VAL(string);
+            break;
+        }
+        case 't':
+        case 'f':
+        case 'n':
+            if (matchLiteral(parser, "true", 4)) {
+                value = BOOL_VAL(true);
+            } else if (matchLiteral(parser, "false", 5)) {
+                value = BOOL_VAL(false);
+            } else if (matchLiteral(parser, "null", 4)) {
+                value = NIL_VAL;
+            } else {
+                return parseError(parser, "Expect a value.");
+            }
+            break;
+        default: {
+            double number;
+            if (!parseNumberText(parser, &number))
+                return false;
+            value = NUMBER_VAL(number);
+            break;
+        }
+    }
+
+    if (!IS_NIL(parser->handler))
+        return emit(parser, EVENT_VALUE, value);
+    push(value);
+    return true;
+}
+
+/**
+ * `jsonParse(source)` and `jsonParse(source, handler)`, see `initJsonLibrary`.
+ */
+static Value jsonParseNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount, 1, 2))
+        return EMPTY_VAL;
+
+    JsonParser parser;
+    if (IS_STRING(args[0])) {
+        ObjString *text = AS_STRING(args[0]);
+        parser.start = text->chars;
+        parser.end = text->chars + text->length;
+        parser.file = NULL;
+    } else if (IS_FILE(args[0])) {
+        // The parse starts where reading the file is, with what is in the buffer already.
+        ObjFile *file = AS_FILE(args[0]);
+        if (file->fd < 0)
+            return nativeError("File '%s' is closed.", file->path->chars);
+        if (file->buffer == NULL && !fillBuffer(file))
+            return EMPTY_VAL;
+        parser.start = file->buffer + file->start;
+        parser.end = file->buffer + file->end;
+        parser.file = file;
+    } else {
+        return nativeError("Expected a string or a file as argument 1 but got %s.", typeName(args[0]));
+    }
+    parser.current = parser.start;
+    parser.line = 1;
+    parser.readFailed = false;
+    parser.depth = 0;
+    parser.handler = argCount == 2 ? args[1] : NIL_VAL;
+    parser.events = NULL;
+    parser.stopped = false;
+    parser.scratch = NULL;
+    parser.scratchCapacity = 0;
+
+    // Everything the parse makes stays on the stack, above the arguments, until it is returned.
+    Value *base = vm.stackTop;
+    if (!IS_NIL(parser.handler)) {
+        for (int i = 0; i < EVENT_COUNT; i++) {
+            push(OBJ_VAL(copyString(eventNames[i], (int) strlen(eventNames[i]))));
+        }
+        parser.events = base;
+    }
+
+    // On failure the error was reported already, and the stack may be gone with it.
+    bool parsed = parseValue(&parser);
+    if (parsed && !parser.stopped) {
+        skipWhitespace(&parser);
+        if (hasChars(&parser, 1))
+            parsed = parseError(&parser, "Unexpected text after the value.");
+    }
+    FREE_UNMANAGED(parser.scratch);
+    if (!parsed)
+        return EMPTY_VAL;
+    // Reading the file goes on after the value, if the handler stopped the parse.
+    if (parser.file != NULL)
+        parser.file->start = (int) (parser.current - parser.file->buffer);
+
+    Value result = IS_NIL(parser.handler) ? vm.stackTop[-1] : NIL_VAL;
+    vm.stackTop = base;
+    return result;
+}
+
+// Writing.
+
+typedef struct {
+    Output output;          // Writes to `sink`.
+    MemorySink sink;
+    int indent;             // Spaces per level, 0 to write everything on one line.
+    int depth;              // How many arrays and objects the writer is in.
+} JsonWriter;
+
+/**
+ * Write a string between quotes, escaping what needs to be.
+ */
+static void writeJsonString(JsonWriter *writer, const char *chars, int length) {
+    const char *end = chars + length;
+    writeOutput(&writer->output, "\"", 1);
+    while (chars < end) {
+        const char *plain = skipPlainChars(chars, end);
+        writeOutput(&writer->output, chars, plain - chars);
+        if (plain == end)
+            break;
+
+        char c = *plain;
+        switch (c) {
+            case '"': writeOutput(&writer->output, "\\\"", 2); break;
+            case '\\': writeOutput(&writer->output, "\\\\", 2); break;
+            case '\b': writeOutput(&writer->output, "\\b", 2); break;
+            case '\f': writeOutput(&writer->output, "\\f", 2); break;
+            case '\n': writeOutput(&writer->output, "\\n", 2); break;
+            case '\r': writeOutput(&writer->output, "\\r", 2); break;
+            case '\t': writeOutput(&writer->output, "\\t", 2); break;
+            default: writeFormatted(&writer->output, "\\u%04x", (uint8_t) c); break;
+        }
+        chars = plain + 1;
+    }
+    writeOutput(&writer->output, "\"", 1);
+}
+
+/**
+ * Start a new line for an item at the current depth, when indenting.
+ */
+static void writeNewline(JsonWriter *writer) {
+    if (writer->indent == 0)
+        return;
+    writeOutput(&writer->output, "\n", 1);
+    for (int i = 0; i < writer->depth * writer->indent; i++) {
+        writeOutput(&writer->output, " ", 1);
+    }
+}
+
+/**
+ * Write the key of an object entry and what separates it from the value.
+ */
+static void writeKey(JsonWriter *writer, ObjString *key, bool first) {
+    if (!first)
+        writeOutput(&writer->output, ",", 1);
+    writeNewline(writer);
+    writeJsonString(writer, key->chars, key->length);
+    writeOutput(&writer->output, writer->indent > 0 ? ": " : ":", writer->indent > 0 ? 2 : 1);
+}
+
+/**
+ * Write a value as JSON.
+ *
+ * @return Whether the value could be written, if not an error was reported.
+ */
+static bool writeJson(JsonWriter *writer, Value value) {
+    if (IS_NIL(value)) {
+        writeOutput(&writer->output, "null", 4);
+        return true;
+    }
+    if (IS_BOOL(value)) {
+        if (AS_BOOL(value)) {
+            writeOutput(&writer->output, "true", 4);
+        } else {
+            writeOutput(&writer->output, "false", 5);
+        }
+        return true;
+    }
+    if (IS_NUMBER(value)) {
+        if (!isfinite(AS_NUMBER(value))) {
+            nativeError("Can't turn infinity or NaN into JSON.");
+            return false;
+        }
+        char text[NUMBER_BUFFER_SIZE];
+        writeOutput(&writer->output, text, formatNumber(AS_NUMBER(value), text));
+        return true;
+    }
+    if (IS_STRING(value)) {
+        writeJsonString(writer, AS_C_STRING(value), AS_STRING(value)->length);
+        return true;
+    }
+    if (!IS_LIST(value) && !IS_MAP(value) && !IS_RECORD(value)) {
+        nativeError("Can't turn %s into JSON.", typeName(value));
+        return false;
+    }
+
+    // Arrays and objects.
+    if (writer->depth == JSON_MAX_DEPTH) {
+        nativeError("Too deeply nested to turn into JSON, is there a cycle?");
+        return false;
+    }
+    writer->depth++;
+    int count;
+    if (IS_LIST(value)) {
+        ObjList *list = AS_LIST(value);
+        count = list->count;
+        writeOutput(&writer->output, "[", 1);
+        for (int i = 0; i < list->count; i++) {
+            if (i > 0)
+                writeOutput(&writer->output, ",", 1);
+            writeNewline(writer);
+            if (!writeJson(writer, list->items[i]))
+                return false;
+        }
+    } else if (IS_MAP(value)) {
+        ObjMap *map = AS_MAP(value);
+        count = map->count;
+        writeOutput(&writer->output, "{", 1);
+        bool first = true;
+        for (int i = 0; i < map->used; i++) {
+            if (map->keys[i] == NULL)
+                continue;
+            writeKey(writer, map->keys[i], first);
+            first = false;
+            if (!writeJson(writer, map->values[i]))
+                return false;
+        }
+    } else {
+        ObjRecord *record = AS_RECORD(value);
+        count = record->fieldCount;
+        writeOutput(&writer->output, "{", 1);
+        for (int i = 0; i < record->fieldCount; i++) {
+            writeKey(writer, record->type->fields[i], i == 0);
+            if (!writeJson(writer, record->values[i]))
+                return false;
+        }
+    }
+    writer->depth--;
+
+    // Empty ones stay on one line.
+    if (count > 0)
+        writeNewline(writer);
+    writeOutput(&writer->output, IS_LIST(value) ? "]" : "}", 1);
+    return true;
+}
+
+/**
+ * `jsonStringify(value)` and `jsonStringify(value, indent)`, see `initJsonLibrary`.
+ */
+static Value jsonStringifyNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount, 1, 2))
+        return EMPTY_VAL;
+    int indent = 0;
+    if (argCount == 2) {
+        if (!IS_NUMBER(args[1]) || AS_NUMBER(args[1]) < 0 || AS_NUMBER(args[1]) > 10 ||
+            AS_NUMBER(args[1]) != (int) AS_NUMBER(args[1]))
+            return nativeError("Indent must be a whole number from 0 to 10.");
+        indent = (int) AS_NUMBER(args[1]);
+    }
+
+    JsonWriter writer;
+    writer.sink = (MemorySink) {NULL, 0, 0};
+    initOutput(&writer.output, 0, FLUSH_EXPLICIT);
+    writer.output.sink = memorySink;
+    writer.output.sinkData = &writer.sink;
+    writer.indent = indent;
+    writer.depth = 0;
+
+    bool written = writeJson(&writer, args[0]);
+    freeOutput(&writer.output);
+    if (written && writer.sink.length > INT_MAX) {
+        nativeError("Resulting string is too long.");
+        written = false;
+    }
+
+    Value result = EMPTY_VAL;
+    if (written)
+        result = OBJ_VAL(copyString(writer.sink.chars == NULL ? "" : writer.sink.chars, (int) writer.sink.length));
+    freeMemorySink(&writer.sink);
+    return result;
+}
+
+void initJsonLibrary() {
+    defineNative("jsonParse", jsonParseNative);
+    defineNative("jsonStringify", jsonStringifyNative);
+}
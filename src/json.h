@@ -0,0 +1,23 @@
+#ifndef NAMELESS_JSON_H
+#define NAMELESS_JSON_H
+
+#include "common.h"
+
+/**
+ * Most levels of arrays and objects inside one another, reading or writing JSON.
+ */
+#define JSON_MAX_DEPTH 512
+
+/**
+ * Define the JSON natives:
+ * - `jsonParse(source)` turns JSON text into maps, lists, strings, numbers, booleans and nil. The source is a string,
+ * or a file from `openFile` which is then read a chunk at a time, from where reading it is.
+ * - `jsonParse(source, handler)` builds nothing, it calls `handler(event, value)` for each element as it is read
+ * instead. The events are "startObject", "key", "endObject", "startArray", "endArray" and "value". Returning false from
+ * the handler stops the parse. With a file, only the chunk being parsed and the strings handed out are in memory, so
+ * documents bigger than memory can be read.
+ * - `jsonStringify(value)` and `jsonStringify(value, indent)` turn a value into JSON text, records becoming objects.
+ */
+void initJsonLibrary();
+
+#endif
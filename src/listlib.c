@@ -0,0 +1,93 @@
+#include <limits.h>
+#include <string.h>
+
+#include "listlib.h"
+#include "memory.h"
+#include "number.h"
+#include "vm.h"
+
+/**
+ * `items.length()`: how many items the list has.
+ */
+static Value lengthNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return NUMBER_VAL(AS_LIST(args[0])->count);
+}
+
+/**
+ * `items.push(item)`: add an item at the end of the list. Returns the list's new length.
+ */
+static Value pushNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 1))
+        return EMPTY_VAL;
+    ObjList *list = AS_LIST(args[0]);
+    appendToList(list, args[1]);
+    return NUMBER_VAL(list->count);
+}
+
+/**
+ * `items.pop()`: remove the last item of the list and return it.
+ */
+static Value popNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    ObjList *list = AS_LIST(args[0]);
+    if (list->count == 0)
+        return nativeError("Can't pop from an empty list.");
+    return list->items[--list->count];
+}
+
+/**
+ * `items.join(separator)`: the items, strings or numbers, joined in one string with a separator between them. The
+ * result is sized up front, then filled in one pass.
+ */
+static Value joinNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 1))
+        return EMPTY_VAL;
+    if (!IS_STRING(args[1]))
+        return nativeError("Expected a string as argument 1 but got %s.", typeName(args[1]));
+    ObjList *list = AS_LIST(args[0]);
+    ObjString *separator = AS_STRING(args[1]);
+
+    int64_t length = list->count > 0 ? (int64_t) separator->length * (list->count - 1) : 0;
+    for (int i = 0; i < list->count; i++) {
+        Value item = list->items[i];
+        if (IS_NUMBER(item)) {
+            char text[NUMBER_BUFFER_SIZE];
+            length += formatNumber(AS_NUMBER(item), text);
+        } else if (IS_STRING(item)) {
+            length += AS_STRING(item)->length;
+        } else {
+            return nativeError("Can only join strings and numbers but item %d is %s.", i, typeName(item));
+        }
+    }
+    if (length > INT_MAX)
+        return nativeError("Resulting string is too long.");
+
+    char *chars = ALLOCATE(char, length + 1);
+    char *end = chars;
+    for (int i = 0; i < list->count; i++) {
+        if (i > 0) {
+            memcpy(end, separator->chars, separator->length);
+            end += separator->length;
+        }
+        Value item = list->items[i];
+        if (IS_NUMBER(item)) {
+            // The terminator lands on what comes next, or on the one of the result.
+            end += formatNumber(AS_NUMBER(item), end);
+        } else {
+            memcpy(end, AS_C_STRING(item), AS_STRING(item)->length);
+            end += AS_STRING(item)->length;
+        }
+    }
+    chars[length] = '\0';
+    return OBJ_VAL(takeString(chars, (int) length));
+}
+
+void initListLibrary() {
+    defineNativeMethod(vm.listClass, "length", lengthNative);
+    defineNativeMethod(vm.listClass, "push", pushNative);
+    defineNativeMethod(vm.listClass, "pop", popNative);
+    defineNativeMethod(vm.listClass, "join", joinNative);
+}
@@ -0,0 +1,12 @@
+#ifndef NAMELESS_LISTLIB_H
+#define NAMELESS_LISTLIB_H
+
+#include "common.h"
+
+/**
+ * Define the native methods of lists: `items.push(x)`, `items.join(", ")` and so on. They are called right on the
+ * list, see `vm.listClass`.
+ */
+void initListLibrary();
+
+#endif
@@ -1,9 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "chunk.h"
+#include "scanner.h"
 #include "vm.h"
+#include "recordmode.h"
+
+/**
+ * Arena limit for region mode. Past this, a run goes back to regular garbage collection.
+ */
+#define REGION_ARENA_LIMIT (64 * 1024 * 1024)
 
 /**
  * Console interactive interpreter.
@@ -59,6 +67,110 @@ static char *readFile(const char *path) {
     return buffer;
 }
 
+/**
+ * Parameters of `RECORD` when the program is given as its body on the command line. The fields are only split for a
+ * `RECORD` declaring them, so the body only gets the parameters it mentions. The body sits in a block of its own, so it
+ * can declare variables with the same names.
+ */
+static const char *recordParameters[] = {"line", "line, fields", "line, fields, number"};
+
+/**
+ * Find out whether the body of `RECORD` may read a variable: it has the name as an identifier, neither after a dot like a
+ * property nor as the name of a declaration. A body reading its own variable gets the parameter anyway, which only costs
+ * the time to make it.
+ *
+ * @param body The body.
+ * @param name The name of the variable.
+ * @return Whether the body uses the variable.
+ */
+static bool usesVariable(const char *body, const char *name) {
+    int length = (int) strlen(name);
+    TokenType previous = TOKEN_EOF;
+    initScanner(body);
+    for (Token token = scanToken(); token.type != TOKEN_EOF && token.type != TOKEN_ERROR; token = scanToken()) {
+        if (token.type == TOKEN_IDENTIFIER && token.length == length && memcmp(token.start, name, length) == 0) {
+            switch (previous) {
+                case TOKEN_DOT:
+                case TOKEN_VAR:
+                case TOKEN_CONST:
+                case TOKEN_FUN:
+                case TOKEN_CLASS:
+                case TOKEN_RECORD:
+                case TOKEN_ENUM:
+                    break;
+                default:
+                    return true;
+            }
+        }
+        previous = token.type;
+    }
+    return false;
+}
+
+/**
+ * Leave with the right exit code after a failed run.
+ *
+ * @param result The result of the run.
+ */
+static void exitWithResult(InterpretResult result) {
+    if (result != INTERPRET_OK) {
+        // Freeing the VM flushes its output.
+        freeVM();
+        exit(result == INTERPRET_COMPILE_ERROR ? 65 : 70);
+    }
+}
+
+/**
+ * Run the record mode (`-n`) with the rest of the command line: an optional field separator (`-F c`), the program
+ * (`-f path` for a script defining `BEGIN`, `RECORD` and `END`, or else the body of `RECORD`), and the files to read.
+ *
+ * @param argc How many arguments are left.
+ * @param argv The arguments left.
+ */
+static void runRecords(int argc, const char **argv) {
+    int arg = 0;
+    char separator = 0;
+    if (arg + 1 < argc && strcmp(argv[arg], "-F") == 0) {
+        if (strlen(argv[arg + 1]) != 1) {
+            fprintf(stderr, "The field separator must be a single character.\n");
+            exit(64);
+        }
+        separator = argv[arg + 1][0];
+        arg += 2;
+    }
+
+    char *source;
+    if (arg + 1 < argc && strcmp(argv[arg], "-f") == 0) {
+        source = readFile(argv[arg + 1]);
+        arg += 2;
+    } else if (arg < argc) {
+        const char *body = argv[arg];
+        const char *parameters = recordParameters[0];
+        if (usesVariable(body, "number")) {
+            parameters = recordParameters[2];
+        } else if (usesVariable(body, "fields")) {
+            parameters = recordParameters[1];
+        }
+
+        // The body starts on the first line, so errors point to the right line of it.
+        size_t length = strlen(body) + strlen(parameters) + 32;
+        source = (char *) malloc(length);
+        if (source == NULL) {
+            fprintf(stderr, "Not enough memory for the program.\n");
+            exit(74);
+        }
+        snprintf(source, length, "fun RECORD(%s) { { %s\n} }\n", parameters, body);
+        arg++;
+    } else {
+        fprintf(stderr, "Usage: nameless [--region] -n [-F separator] (body | -f path) [file...]\n");
+        exit(64);
+    }
+
+    InterpretResult result = runRecordMode(source, argv + arg, argc - arg, separator);
+    free(source);
+    exitWithResult(result);
+}
+
 /**
  * Run a script from a file.
  *
@@ -68,21 +180,33 @@ static void runFile(const char *path) {
     char *source = readFile(path);
     InterpretResult result = interpret(source);
     free(source);
-
-    if (result == INTERPRET_COMPILE_ERROR) exit(65);
-    if (result == INTERPRET_RUNTIME_ERROR) exit(70);
+    exitWithResult(result);
 }
 
 int main(int argc, const char **argv) {
     initVM();
 
-    if (argc == 1) {
+    // Someone is watching: show each line as soon as it is printed.
+    if (isatty(STDOUT_FILENO))
+        configureOutput(OUTPUT_BUFFER_SIZE, FLUSH_LINE);
+
+    // Options come before the path.
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--region") == 0) {
+        enableRegionMode(REGION_ARENA_LIMIT);
+        arg++;
+    }
+
+    if (arg < argc && strcmp(argv[arg], "-n") == 0) {
+        runRecords(argc - arg - 1, argv + arg + 1);
+    } else if (argc == arg) {
         printf("Repl starting: ...\n");
         repl();
-    } else if (argc == 2) {
-        runFile(argv[1]);
+    } else if (argc == arg + 1) {
+        runFile(argv[arg]);
     } else {
-        fprintf(stderr, "Usage: nameless [path]\n");
+        fprintf(stderr, "Usage: nameless [--region] [path]\n"
+                        "       nameless [--region] -n [-F separator] (body | -f path) [file...]\n");
         exit(64);
     }
 
@@ -0,0 +1,107 @@
+
+#include "maplib.h"
+#include "memory.h"
+#include "vm.h"
+
+/**
+ * Check the argument of a method taking a key is a string, raising an error if not.
+ *
+ * @param value The argument.
+ * @return Whether it is a string.
+ */
+static bool checkKeyArgument(Value value) {
+    if (IS_STRING(value))
+        return true;
+    nativeError("Map keys must be strings but got %s.", typeName(value));
+    return false;
+}
+
+/**
+ * Make a list with room for some items, for them to be filled in right away.
+ *
+ * @param count How many items.
+ * @return The list, pushed on the stack to keep it from garbage collection.
+ */
+static ObjList *pushListOfSize(int count) {
+    ObjList *list = newList();
+    push(OBJ_VAL(list));
+    if (count > 0) {
+        list->items = GROW_ARRAY(Value, NULL, 0, count);
+        list->capacity = count;
+        list->count = count;
+    }
+    return list;
+}
+
+/**
+ * `scores.length()`: how many entries the map has.
+ */
+static Value lengthNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return NUMBER_VAL(AS_MAP(args[0])->count);
+}
+
+/**
+ * `scores.keys()`: a list of the keys, in the order they were added.
+ */
+static Value keysNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    ObjMap *map = AS_MAP(args[0]);
+    ObjList *list = pushListOfSize(map->count);
+    int count = 0;
+    for (int i = 0; i < map->used; i++) {
+        if (map->keys[i] != NULL)
+            list->items[count++] = OBJ_VAL(map->keys[i]);
+    }
+    pop();
+    return OBJ_VAL(list);
+}
+
+/**
+ * `scores.values()`: a list of the values, in the order of their keys.
+ */
+static Value valuesNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    ObjMap *map = AS_MAP(args[0]);
+    ObjList *list = pushListOfSize(map->count);
+    int count = 0;
+    for (int i = 0; i < map->used; i++) {
+        if (map->keys[i] != NULL)
+            list->items[count++] = map->values[i];
+    }
+    pop();
+    return OBJ_VAL(list);
+}
+
+/**
+ * `scores.has(key)`: whether the map has a key. Tells a missing key from one set to nil.
+ */
+static Value hasNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !checkKeyArgument(args[1]))
+        return EMPTY_VAL;
+    Value value;
+    return BOOL_VAL(mapGet(AS_MAP(args[0]), AS_STRING(args[1]), &value));
+}
+
+/**
+ * `scores.remove(key)`: remove a key from the map. Returns the value it had, nil if the map did not have it.
+ */
+static Value removeNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !checkKeyArgument(args[1]))
+        return EMPTY_VAL;
+    Value value;
+    if (!mapDelete(AS_MAP(args[0]), AS_STRING(args[1]), &value))
+        return NIL_VAL;
+    return value;
+}
+
+void initMapLibrary() {
+    defineNativeMethod(vm.mapClass, "length", lengthNative);
+    defineNativeMethod(vm.mapClass, "keys", keysNative);
+    defineNativeMethod(vm.mapClass, "values", valuesNative);
+    defineNativeMethod(vm.mapClass, "has", hasNative);
+    defineNativeMethod(vm.mapClass, "remove", removeNative);
+}
@@ -0,0 +1,12 @@
+#ifndef NAMELESS_MAPLIB_H
+#define NAMELESS_MAPLIB_H
+
+#include "common.h"
+
+/**
+ * Define the native methods of maps: `scores.keys()`, `scores.has("ann")` and so on. They are called right on the map,
+ * see `vm.mapClass`.
+ */
+void initMapLibrary();
+
+#endif
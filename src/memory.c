@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "memory.h"
 #include "vm.h"
@@ -13,11 +14,24 @@
 
 #define GC_HEAP_GROW_FACTOR 2
 
+/**
+ * Set while the survivors of a region are moved to the heap. The object graph is half updated in the meantime.
+ */
+static bool promoting = false;
+
+/**
+ * Whether an allocation may trigger garbage collection. In region mode the arena is thrown away at the end of the run
+ * anyway, so collecting is only worth it once the arena is full.
+ */
+static bool collectionAllowed() {
+    return !promoting && (!vm.regionMode || vm.regionFull);
+}
+
 void *reallocate(void *pointer, size_t oldSize, size_t newSize) {
     vm.bytesAllocated += newSize - oldSize;
 
     // Run garbage collection if needed.
-    if (newSize > oldSize) {
+    if (newSize > oldSize && collectionAllowed()) {
 #ifdef DEBUG_STRESS_GC
         collectGarbage();
 #endif
@@ -59,7 +73,7 @@ void markObject(Obj *object) {
     // Resize gray stack if necessary.
     if (vm.grayCapacity < vm.grayCount + 1) {
         vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
-        vm.grayStack = ALLOCATE_UNMANAGED(Obj*, vm.grayCapacity);
+        vm.grayStack = GROW_ARRAY_UNMANAGED(Obj*, vm.grayStack, vm.grayCapacity);
         // Allocation failure.
         if (vm.grayStack == NULL)
             exit(1);
@@ -107,6 +121,10 @@ static void blackenObject(Obj *object) {
             ObjClass *klass = (ObjClass *) object;
             markObject((Obj *) klass->name);
             markTable(&klass->methods);
+            for (int i = 0; i < klass->vtableSize; i++) {
+                markValue(klass->vtable[i]);
+            }
+            markValue(klass->initializer);
             break;
         }
         case OBJ_CLOSURE: {
@@ -116,8 +134,14 @@ static void blackenObject(Obj *object) {
             for (int i = 0; i < closure->upvalueCount; i++) {
                 markObject((Obj *) closure->upvalues[i]);
             }
+            for (int i = 0; i < closure->capturedCount; i++) {
+                markValue(closure->captured[i]);
+            }
             break;
         }
+        case OBJ_FILE:
+            markObject((Obj *) ((ObjFile *) object)->path);
+            break;
         case OBJ_FUNCTION: {
             // Mark a function's constants and name.
             ObjFunction *function = (ObjFunction *) object;
@@ -128,7 +152,41 @@ static void blackenObject(Obj *object) {
         case OBJ_INSTANCE: {
             ObjInstance *instance = (ObjInstance *) object;
             markObject((Obj *) instance->klass);
-            markTable(&instance->fields);
+            for (int i = 0; i < instance->fieldCapacity; i++) {
+                markValue(instance->fields[i]);
+            }
+            break;
+        }
+        case OBJ_LIST: {
+            ObjList *list = (ObjList *) object;
+            for (int i = 0; i < list->count; i++) {
+                markValue(list->items[i]);
+            }
+            break;
+        }
+        case OBJ_MAP: {
+            ObjMap *map = (ObjMap *) object;
+            markTable(&map->index);
+            for (int i = 0; i < map->used; i++) {
+                markObject((Obj *) map->keys[i]);
+                markValue(map->values[i]);
+            }
+            break;
+        }
+        case OBJ_RECORD: {
+            ObjRecord *record = (ObjRecord *) object;
+            markObject((Obj *) record->type);
+            for (int i = 0; i < record->fieldCount; i++) {
+                markValue(record->values[i]);
+            }
+            break;
+        }
+        case OBJ_RECORD_TYPE: {
+            ObjRecordType *type = (ObjRecordType *) object;
+            markObject((Obj *) type->name);
+            for (int i = 0; i < type->fieldCount; i++) {
+                markObject((Obj *) type->fields[i]);
+            }
             break;
         }
         case OBJ_UPVALUE:
@@ -142,55 +200,173 @@ static void blackenObject(Obj *object) {
     }
 }
 
-static void freeObject(Obj *object) {
-
-#ifdef DEBUG_LOG_GC
-    printf("%p free type %d\n", (void *) object, object->type);
-#endif
-
+/**
+ * @param object An object.
+ * @return How many bytes the object structure takes.
+ */
+static size_t objectSize(Obj *object) {
     switch (object->type) {
         case OBJ_BOUND_METHOD:
-            FREE(ObjBoundMethod, object);
-            break;
+            return sizeof(ObjBoundMethod);
+        case OBJ_CLASS:
+            return sizeof(ObjClass);
+        case OBJ_CLOSURE:
+            return sizeof(ObjClosure) + sizeof(Value) * ((ObjClosure *) object)->capturedCount;
+        case OBJ_FILE:
+            return sizeof(ObjFile);
+        case OBJ_FUNCTION:
+            return sizeof(ObjFunction);
+        case OBJ_INSTANCE:
+            return sizeof(ObjInstance);
+        case OBJ_LIST:
+            return sizeof(ObjList);
+        case OBJ_MAP:
+            return sizeof(ObjMap);
+        case OBJ_NATIVE:
+            return sizeof(ObjNative);
+        case OBJ_RECORD:
+            return sizeof(ObjRecord) + sizeof(Value) * ((ObjRecord *) object)->fieldCount;
+        case OBJ_RECORD_TYPE:
+            return sizeof(ObjRecordType) + sizeof(ObjString *) * ((ObjRecordType *) object)->fieldCount;
+        case OBJ_STRING:
+            return sizeof(ObjString);
+        case OBJ_UPVALUE:
+            return sizeof(ObjUpvalue);
+    }
+    return 0; // Unreachable.
+}
+
+/**
+ * Free the memory an object owns (tables, arrays etc.), but not the object itself.
+ *
+ * @param object The object.
+ */
+static void releaseObject(Obj *object) {
+    switch (object->type) {
         case OBJ_CLASS: {
             ObjClass *klass = (ObjClass *) object;
             freeTable(&klass->methods);
-            FREE(ObjClass, object);
+            FREE_ARRAY(Value, klass->vtable, klass->vtableSize);
+            FREE_ARRAY(FieldSlot, klass->fieldSlots, klass->fieldSlotsCapacity);
             break;
         }
         case OBJ_CLOSURE: {
-            // Clear closure and upvalues.
+            // Clear upvalues.
             ObjClosure *closure = (ObjClosure *) object;
             FREE_ARRAY(ObjUpvalue*, closure->upvalues, closure->upvalueCount);
-            FREE(ObjClosure, object);
             break;
         }
-        case OBJ_FUNCTION: {
-            ObjFunction *function = (ObjFunction *) object;
-            freeChunk(&function->chunk);
-            FREE(ObjFunction, object);
+        case OBJ_FILE:
+            closeFile((ObjFile *) object);
+            break;
+        case OBJ_FUNCTION:
+            freeChunk(&((ObjFunction *) object)->chunk);
             break;
-        }
         case OBJ_STRING: {
             ObjString *string = (ObjString *) object;
             FREE_ARRAY(char, string->chars, string->length + 1);
-            FREE(ObjString, object);
             break;
         }
         case OBJ_INSTANCE: {
             ObjInstance *instance = (ObjInstance *) object;
-            freeTable(&instance->fields);
-            FREE(ObjInstance, object);
+            FREE_ARRAY(Value, instance->fields, instance->fieldCapacity);
             break;
         }
-        case OBJ_NATIVE:
-            FREE(ObjNative, object);
+        case OBJ_LIST: {
+            ObjList *list = (ObjList *) object;
+            FREE_ARRAY(Value, list->items, list->capacity);
             break;
+        }
+        case OBJ_MAP: {
+            ObjMap *map = (ObjMap *) object;
+            freeTable(&map->index);
+            FREE_ARRAY(ObjString*, map->keys, map->capacity);
+            FREE_ARRAY(Value, map->values, map->capacity);
+            break;
+        }
+        case OBJ_BOUND_METHOD:
+        case OBJ_NATIVE:
+        case OBJ_RECORD:
+        case OBJ_RECORD_TYPE:
         case OBJ_UPVALUE:
-            FREE(ObjUpvalue, object);
             break;
+    }
+}
+
+/**
+ * Put a dead object in a pool, a free list, instead of freeing it. Bound methods and small instances are short lived
+ * and created all the time, so `newBoundMethod` and `newInstance` can reuse them, saving the allocator a round trip.
+ * Instances keep their array of field slots, emptied. The objects are still allocated and collected as usual.
+ *
+ * @param object A dead heap object.
+ * @return Whether the object went in a pool.
+ */
+static bool poolObject(Obj *object) {
+    Obj **pool;
+    int *count;
+    switch (object->type) {
+        case OBJ_BOUND_METHOD:
+            if (vm.boundMethodPoolCount == BOUND_METHOD_POOL_MAX)
+                return false;
+            pool = &vm.boundMethodPool;
+            count = &vm.boundMethodPoolCount;
+            break;
+        case OBJ_INSTANCE: {
+            ObjInstance *instance = (ObjInstance *) object;
+            if (vm.instancePoolCount == INSTANCE_POOL_MAX || instance->fieldCapacity > POOLED_FIELDS_MAX)
+                return false;
+            for (int i = 0; i < instance->fieldCapacity; i++) {
+                instance->fields[i] = EMPTY_VAL;
+            }
+            pool = &vm.instancePool;
+            count = &vm.instancePoolCount;
+            break;
+        }
+        default:
+            return false;
+    }
 
+    object->next = *pool;
+    *pool = object;
+    (*count)++;
+    return true;
+}
+
+/**
+ * Free a pool of dead objects.
+ *
+ * @param pool The pool.
+ * @param count How many objects are in the pool.
+ */
+static void freePool(Obj **pool, int *count) {
+    Obj *object = *pool;
+    while (object != NULL) {
+        Obj *next = object->next;
+        releaseObject(object);
+        reallocate(object, objectSize(object), 0);
+        object = next;
     }
+    *pool = NULL;
+    *count = 0;
+}
+
+/**
+ * Free an object. Objects living in the arena only release what they own, their memory goes away with the arena.
+ *
+ * @param object The object.
+ */
+static void freeObject(Obj *object) {
+
+#ifdef DEBUG_LOG_GC
+    printf("%p free type %d\n", (void *) object, object->type);
+#endif
+
+    if (!object->isRegion && poolObject(object))
+        return;
+
+    releaseObject(object);
+    if (!object->isRegion)
+        reallocate(object, objectSize(object), 0);
 }
 
 /**
@@ -207,22 +383,34 @@ static void markRoots() {
         markObject((Obj *) vm.frames[i].closure);
     }
 
-    // Open upvalues are needed.
-    for (ObjUpvalue *upvalue = vm.openUpvalues;
-         upvalue != NULL;
-         upvalue = upvalue->next) {
-        markObject((Obj *) upvalue);
+    // Open upvalues are needed. They can only be at live stack slots.
+    if (vm.openUpvalueCount > 0) {
+        for (int i = 0; i < vm.stackTop - vm.stack; i++) {
+            markObject((Obj *) vm.openUpvalues[i]);
+        }
     }
 
     // Global variables.
     markTable(&vm.globals);
 
+    // Compile-time constants, for the code compiled later on.
+    markTable(&vm.constants);
+
+    // Property and method names, symbols are handed out for good.
+    markTable(&vm.symbols);
+
     // The compilers also take memory from the heap for literals.
     // Although it only needs to mark the function it is working on.
     markCompilerRoots();
 
     // "init" string.
     markObject((Obj *) vm.initString);
+
+    // Native methods of built-in types.
+    markObject((Obj *) vm.stringClass);
+    markObject((Obj *) vm.listClass);
+    markObject((Obj *) vm.mapClass);
+    markObject((Obj *) vm.fileClass);
 }
 
 /**
@@ -236,12 +424,14 @@ static void traceReferences() {
 }
 
 /**
- * Loop through objects and free all non-reachable objects.
+ * Loop through a list of objects and free all non-reachable objects.
  * If the object is reachable clear its marked field for the next collection.
+ *
+ * @param list The head of the list (`vm.objects` or `vm.regionObjects`).
  */
-static void sweep() {
+static void sweep(Obj **list) {
     Obj *previous = NULL;
-    Obj *object = vm.objects;
+    Obj *object = *list;
     while (object != NULL) {
         // Skip black objects.
         if (object->isMarked) {
@@ -256,7 +446,7 @@ static void sweep() {
             if (previous != NULL) {
                 previous->next = object;
             } else {
-                vm.objects = object;
+                *list = object;
             }
 
             freeObject(unreached);
@@ -275,7 +465,8 @@ void collectGarbage() {
     markRoots();                    // Mark all roots.
     traceReferences();              // Mark reachable objects.
     tableRemoveWhite(&vm.strings);  // Remove unreachable strings.
-    sweep();                        // Delete all non-reachable objects.
+    sweep(&vm.objects);             // Delete all non-reachable objects.
+    sweep(&vm.regionObjects);       // Same for the arena, if the region got full.
 
     vm.nextGC = vm.bytesAllocated * GC_HEAP_GROW_FACTOR;
 
@@ -292,6 +483,247 @@ void collectGarbage() {
 
 }
 
+/**
+ * @param object An object or NULL.
+ * @return Where the object is now: promoted objects left their new address in `next`.
+ */
+static Obj *forwarded(Obj *object) {
+    if (object != NULL && object->isRegion)
+        return object->next;
+    return object;
+}
+
+/**
+ * Same as `forwarded`, for Values.
+ */
+static Value forwardedValue(Value value) {
+    if (IS_OBJ(value))
+        return OBJ_VAL(forwarded(AS_OBJ(value)));
+    return value;
+}
+
+/**
+ * Update keys and values of a table to point to the promoted objects. Keys keep their hash, so entries stay where they
+ * are.
+ *
+ * @param table A Table.
+ */
+static void forwardTable(Table *table) {
+    for (int i = 0; i < table->capacity; i++) {
+        Entry *entry = &table->entries[i];
+        entry->key = (ObjString *) forwarded((Obj *) entry->key);
+        entry->value = forwardedValue(entry->value);
+    }
+}
+
+/**
+ * Update the references an object holds to point to the promoted objects. Mirrors `blackenObject`.
+ *
+ * @param object The object.
+ */
+static void forwardReferences(Obj *object) {
+    switch (object->type) {
+        case OBJ_BOUND_METHOD: {
+            ObjBoundMethod *bound = (ObjBoundMethod *) object;
+            bound->receiver = forwardedValue(bound->receiver);
+            bound->method = (ObjClosure *) forwarded((Obj *) bound->method);
+            break;
+        }
+        case OBJ_CLASS: {
+            ObjClass *klass = (ObjClass *) object;
+            klass->name = (ObjString *) forwarded((Obj *) klass->name);
+            forwardTable(&klass->methods);
+            for (int i = 0; i < klass->vtableSize; i++) {
+                klass->vtable[i] = forwardedValue(klass->vtable[i]);
+            }
+            klass->initializer = forwardedValue(klass->initializer);
+            break;
+        }
+        case OBJ_CLOSURE: {
+            ObjClosure *closure = (ObjClosure *) object;
+            closure->function = (ObjFunction *) forwarded((Obj *) closure->function);
+            for (int i = 0; i < closure->upvalueCount; i++) {
+                closure->upvalues[i] = (ObjUpvalue *) forwarded((Obj *) closure->upvalues[i]);
+            }
+            for (int i = 0; i < closure->capturedCount; i++) {
+                closure->captured[i] = forwardedValue(closure->captured[i]);
+            }
+            break;
+        }
+        case OBJ_FILE: {
+            ObjFile *file = (ObjFile *) object;
+            file->path = (ObjString *) forwarded((Obj *) file->path);
+            break;
+        }
+        case OBJ_FUNCTION: {
+            ObjFunction *function = (ObjFunction *) object;
+            function->name = (ObjString *) forwarded((Obj *) function->name);
+            ValueArray *constants = &function->chunk.constants;
+            for (int i = 0; i < constants->size; i++) {
+                constants->values[i] = forwardedValue(constants->values[i]);
+            }
+            break;
+        }
+        case OBJ_INSTANCE: {
+            ObjInstance *instance = (ObjInstance *) object;
+            instance->klass = (ObjClass *) forwarded((Obj *) instance->klass);
+            for (int i = 0; i < instance->fieldCapacity; i++) {
+                instance->fields[i] = forwardedValue(instance->fields[i]);
+            }
+            break;
+        }
+        case OBJ_LIST: {
+            ObjList *list = (ObjList *) object;
+            for (int i = 0; i < list->count; i++) {
+                list->items[i] = forwardedValue(list->items[i]);
+            }
+            break;
+        }
+        case OBJ_MAP: {
+            ObjMap *map = (ObjMap *) object;
+            forwardTable(&map->index);
+            for (int i = 0; i < map->used; i++) {
+                map->keys[i] = (ObjString *) forwarded((Obj *) map->keys[i]);
+                map->values[i] = forwardedValue(map->values[i]);
+            }
+            break;
+        }
+        case OBJ_RECORD: {
+            ObjRecord *record = (ObjRecord *) object;
+            record->type = (ObjRecordType *) forwarded((Obj *) record->type);
+            for (int i = 0; i < record->fieldCount; i++) {
+                record->values[i] = forwardedValue(record->values[i]);
+            }
+            break;
+        }
+        case OBJ_RECORD_TYPE: {
+            ObjRecordType *type = (ObjRecordType *) object;
+            type->name = (ObjString *) forwarded((Obj *) type->name);
+            for (int i = 0; i < type->fieldCount; i++) {
+                type->fields[i] = (ObjString *) forwarded((Obj *) type->fields[i]);
+            }
+            break;
+        }
+        case OBJ_UPVALUE: {
+            ObjUpvalue *upvalue = (ObjUpvalue *) object;
+            upvalue->closed = forwardedValue(upvalue->closed);
+            break;
+        }
+        case OBJ_NATIVE:
+        case OBJ_STRING:
+            break;
+    }
+}
+
+/**
+ * Move a reachable object out of the arena. The copy goes in the heap list, the old object keeps its new address in
+ * `next` until the arena is discarded.
+ *
+ * @param object An object living in the arena.
+ */
+static void promoteObject(Obj *object) {
+    size_t size = objectSize(object);
+    Obj *copy = (Obj *) reallocate(NULL, 0, size);
+    memcpy(copy, object, size);
+
+    // A closed upvalue points to its own `closed` field.
+    if (object->type == OBJ_UPVALUE) {
+        ObjUpvalue *upvalue = (ObjUpvalue *) object;
+        if (upvalue->location == &upvalue->closed)
+            ((ObjUpvalue *) copy)->location = &((ObjUpvalue *) copy)->closed;
+    }
+
+    copy->isRegion = false;
+    copy->next = vm.objects;
+    vm.objects = copy;
+    object->next = copy;
+}
+
+/**
+ * Update the roots to point to the promoted objects. Mirrors `markRoots`.
+ */
+static void forwardRoots() {
+    for (Value *slot = vm.stack; slot < vm.stackTop; slot++) {
+        *slot = forwardedValue(*slot);
+    }
+
+    for (int i = 0; i < vm.frameCount; i++) {
+        vm.frames[i].closure = (ObjClosure *) forwarded((Obj *) vm.frames[i].closure);
+    }
+
+    if (vm.openUpvalueCount > 0) {
+        for (int i = 0; i < vm.stackTop - vm.stack; i++) {
+            vm.openUpvalues[i] = (ObjUpvalue *) forwarded((Obj *) vm.openUpvalues[i]);
+        }
+    }
+
+    forwardTable(&vm.globals);
+    forwardTable(&vm.strings);
+    forwardTable(&vm.constants);
+    forwardTable(&vm.symbols);
+
+    vm.initString = (ObjString *) forwarded((Obj *) vm.initString);
+    vm.stringClass = (ObjClass *) forwarded((Obj *) vm.stringClass);
+    vm.listClass = (ObjClass *) forwarded((Obj *) vm.listClass);
+    vm.mapClass = (ObjClass *) forwarded((Obj *) vm.mapClass);
+    vm.fileClass = (ObjClass *) forwarded((Obj *) vm.fileClass);
+}
+
+void endRegion() {
+
+#ifdef DEBUG_LOG_GC
+    printf("-- region end\n");
+    size_t before = vm.arena.used;
+#endif
+
+    promoting = true;
+
+    // Objects outside the arena outlive the run, whatever they reference escaped.
+    for (Obj *object = vm.objects; object != NULL; object = object->next) {
+        markObject(object);
+    }
+    markRoots();
+    traceReferences();
+    tableRemoveWhite(&vm.strings);
+
+    // Promote what escaped, release what the rest owns.
+    bool promoted = false;
+    Obj *object = vm.regionObjects;
+    while (object != NULL) {
+        Obj *next = object->next;
+        if (object->isMarked) {
+            promoteObject(object);
+            promoted = true;
+        } else {
+            releaseObject(object);
+        }
+        object = next;
+    }
+
+    // Nothing escaped -> no reference to fix.
+    if (promoted) {
+        forwardRoots();
+        for (object = vm.objects; object != NULL; object = object->next) {
+            forwardReferences(object);
+        }
+    }
+
+    // Every object on the heap was marked.
+    for (object = vm.objects; object != NULL; object = object->next) {
+        object->isMarked = false;
+    }
+
+    vm.regionObjects = NULL;
+    vm.regionFull = false;
+    resetArena(&vm.arena);
+    promoting = false;
+
+#ifdef DEBUG_LOG_GC
+    printf("-- region discarded %zu bytes of objects\n", before);
+#endif
+
+}
+
 void freeObjects() {
     // Live Objects
     Obj *object = vm.objects;
@@ -301,6 +733,18 @@ void freeObjects() {
         object = next;
     }
 
+    // Objects in the arena. The arena itself is freed by the VM.
+    object = vm.regionObjects;
+    while (object != NULL) {
+        Obj *next = object->next;
+        freeObject(object);
+        object = next;
+    }
+
+    // Pooled objects. Freeing the lists above may have just filled the pools.
+    freePool(&vm.boundMethodPool, &vm.boundMethodPoolCount);
+    freePool(&vm.instancePool, &vm.instancePoolCount);
+
     // Memory of the gray stack.
     FREE_UNMANAGED(vm.grayStack);
 }
\ No newline at end of file
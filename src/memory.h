@@ -13,11 +13,11 @@
 #define ALLOCATE(type, count) (type*)reallocate(NULL, 0, sizeof(type) * (count))
 
 /**
- * Same as `ALLOCATE` but this memory is not managed by garbage collection, and must be freed manually. Calls `realloc`
- * from the standard library, meaning it can also be used in place of `GROW_ARRAY`.
+ * Same as `GROW_ARRAY` but this memory is not managed by garbage collection, and must be freed manually. Calls
+ * `realloc` from the standard library, so the content of the array is preserved.
  * It is heavily advised to only use this for the dynamic array of gray objects during garbage collection.
  */
-#define ALLOCATE_UNMANAGED(type, count) (type*)realloc(NULL, sizeof(type) * (count))
+#define GROW_ARRAY_UNMANAGED(type, pointer, newCount) (type*)realloc(pointer, sizeof(type) * (newCount))
 
 /**
  * Free a pointer.
@@ -96,6 +96,13 @@ void markValue(Value value);
  */
 void collectGarbage();
 
+/**
+ * End a run in region mode. Objects in the arena that are still reachable from the roots or from heap objects are
+ * promoted (copied to the heap, with every reference to them updated), the others release what they own, then the
+ * arena is discarded as a whole. Unlike `collectGarbage`, nothing already on the heap is freed.
+ */
+void endRegion();
+
 /**
  * Free the linked list of objects of the vm.
  */
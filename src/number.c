@@ -0,0 +1,349 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "number.h"
+
+/**
+ * Largest integer such that every integer up to it is a double.
+ */
+#define MAX_EXACT_INTEGER 9007199254740992.0
+
+/**
+ * Most digits of a decimal mantissa that fit in 64 bits.
+ */
+#define MAX_MANTISSA_DIGITS 19
+
+/**
+ * Smallest number written without exponent, as `%g` does.
+ */
+#define MIN_PLAIN_NUMBER 1e-4
+
+/**
+ * Significant digits that are always enough for a double to read back right.
+ */
+#define MAX_SIGNIFICANT_DIGITS 17
+
+/**
+ * Rounding of digits that went through printf, which doesn't tell which way it rounded.
+ */
+#define UNKNOWN_ROUNDING 2
+
+/**
+ * Powers of ten that are exact doubles.
+ */
+static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ * Powers of ten that fit in 64 bits.
+ */
+static const uint64_t integerPowersOfTen[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+        10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+        1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+        10000000000000000000ULL,
+};
+
+/**
+ * Write the decimal digits of an integer.
+ *
+ * @param value The integer.
+ * @param minDigits Pad with leading zeros up to this many digits.
+ * @param buffer Where to write.
+ * @return How many digits were written.
+ */
+static int writeDigits(uint64_t value, int minDigits, char *buffer) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count < minDigits)
+        digits[count++] = '0';
+
+    for (int i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+/**
+ * Find the first 17 significant digits of a positive number, correctly rounded.
+ *
+ * @param magnitude The number, finite and positive.
+ * @param digits Output parameter, the digits as an integer of 17 digits.
+ * @param exponent Output parameter, the power of ten of the first digit.
+ * @return 1 if the digits were rounded up, -1 if down, 0 if exact, UNKNOWN_ROUNDING if printf made them.
+ */
+static int significantDigits(double magnitude, uint64_t *digits, int *exponent) {
+#ifdef __SIZEOF_INT128__
+    // The number is exactly mantissa * 2^binaryExponent, scaling it by a power of ten takes a 128 bit product and a
+    // shift. In this range the product can't overflow: at most 53 bits for the mantissa, 67 for 10^20.
+    if (magnitude >= MIN_PLAIN_NUMBER && magnitude < MAX_EXACT_INTEGER) {
+        uint64_t bits;
+        memcpy(&bits, &magnitude, sizeof(bits));
+        uint64_t mantissa = (bits & ((1ULL << 52) - 1)) | (1ULL << 52);
+        int shift = 1075 - (int) (bits >> 52);
+
+        int guess = 0;
+        while (guess < 15 && magnitude >= powersOfTen[guess + 1]) guess++;
+        while (guess <= 0 && guess > -4 && magnitude < 1 / powersOfTen[-guess]) guess--;
+
+        // 1/10^n is not exact, so the guess can be one off: then there is a digit too many or too few.
+        for (;;) {
+            int scale = MAX_SIGNIFICANT_DIGITS - 1 - guess;
+            unsigned __int128 product = (unsigned __int128) mantissa * integerPowersOfTen[scale < 19 ? scale : 19];
+            if (scale > 19)
+                product *= 10;
+            uint64_t result = (uint64_t) (product >> shift);
+            unsigned __int128 rest = product & (((unsigned __int128) 1 << shift) - 1);
+            unsigned __int128 half = (unsigned __int128) 1 << (shift - 1);
+            int rounding = rest == 0 ? 0 : -1;
+            if (rest > half || (rest == half && (result & 1))) {
+                result++;
+                rounding = 1;
+            }
+
+            if (result >= integerPowersOfTen[MAX_SIGNIFICANT_DIGITS]) {
+                guess++;
+            } else if (result < integerPowersOfTen[MAX_SIGNIFICANT_DIGITS - 1] && guess > -4) {
+                guess--;
+            } else {
+                *digits = result;
+                *exponent = guess;
+                return rounding;
+            }
+        }
+    }
+#endif
+
+    // d.dddddddddddddddde+x, printf does the exact conversion.
+    char text[NUMBER_BUFFER_SIZE];
+    snprintf(text, sizeof(text), "%.*e", MAX_SIGNIFICANT_DIGITS - 1, magnitude);
+    uint64_t result = (uint64_t) (text[0] - '0');
+    for (int i = 2; i < MAX_SIGNIFICANT_DIGITS + 1; i++) {
+        result = result * 10 + (uint64_t) (text[i] - '0');
+    }
+    *digits = result;
+    *exponent = (int) strtol(text + MAX_SIGNIFICANT_DIGITS + 2, NULL, 10);
+    return UNKNOWN_ROUNDING;
+}
+
+/**
+ * Check whether a decimal reads back as a number.
+ *
+ * @param digits The significant digits.
+ * @param exponent The power of ten to multiply them by.
+ * @param magnitude The number.
+ * @return Whether the decimal is closer to the number than to any other.
+ */
+static bool readsBack(uint64_t digits, int exponent, double magnitude) {
+    // Both the digits and the power of ten are exact doubles, so one multiplication or division rounds correctly.
+    if (digits <= (uint64_t) MAX_EXACT_INTEGER && exponent >= -22 && exponent <= 22) {
+        double value = (double) digits;
+        return (exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent]) == magnitude;
+    }
+    char text[NUMBER_BUFFER_SIZE];
+    int length = writeDigits(digits, 1, text);
+    length += sprintf(text + length, "e%d", exponent);
+    double value;
+    return parseNumber(text, length, &value) && value == magnitude;
+}
+
+int formatNumber(double value, char *buffer) {
+    if (isnan(value))
+        return sprintf(buffer, "nan");
+    if (isinf(value))
+        return sprintf(buffer, value > 0 ? "inf" : "-inf");
+
+    int length = 0;
+    double magnitude = value;
+    if (signbit(value)) {
+        buffer[length++] = '-';
+        magnitude = -value;
+    }
+
+    // Integers: just the digits.
+    if (magnitude <= MAX_EXACT_INTEGER && magnitude == (double) (uint64_t) magnitude) {
+        length += writeDigits((uint64_t) magnitude, 1, buffer + length);
+        buffer[length] = '\0';
+        return length;
+    }
+
+    // The fewest significant digits that read back right, out of the first 17. A number whose shortest text has up to
+    // DBL_DIG digits comes out as that text when rounded to 15 digits, once the trailing zeros are dropped, except for
+    // subnormals, which are less precise. So the roundings to 15 and 16 digits are the only ones worth trying.
+    uint64_t digits;
+    int exponent;
+    int rounding = significantDigits(magnitude, &digits, &exponent);
+    int precision = MAX_SIGNIFICANT_DIGITS;
+    for (int tried = magnitude < DBL_MIN ? 1 : 15; tried < MAX_SIGNIFICANT_DIGITS; tried++) {
+        uint64_t unit = integerPowersOfTen[MAX_SIGNIFICANT_DIGITS - tried];
+        uint64_t rounded = digits / unit;
+        uint64_t rest = digits % unit;
+        int roundedExponent = exponent;
+        // A tie in the 17 digits is not one in the number if they were rounded to get there.
+        if (rest == unit / 2 && rounding == UNKNOWN_ROUNDING) {
+            char text[NUMBER_BUFFER_SIZE];
+            snprintf(text, sizeof(text), "%.*e", tried - 1, magnitude);
+            rounded = (uint64_t) (text[0] - '0');
+            for (int i = 2; i < tried + 1; i++) {
+                rounded = rounded * 10 + (uint64_t) (text[i] - '0');
+            }
+            roundedExponent = (int) strtol(text + (tried > 1 ? tried + 2 : 2), NULL, 10);
+        } else if (rest > unit / 2 || (rest == unit / 2 && (rounding < 0 || (rounding == 0 && (rounded & 1))))) {
+            rounded++;
+        }
+        // 9.99... rounds up to 10.
+        if (rounded == integerPowersOfTen[tried]) {
+            rounded /= 10;
+            roundedExponent++;
+        }
+        if (readsBack(rounded, roundedExponent - tried + 1, magnitude)) {
+            digits = rounded;
+            exponent = roundedExponent;
+            precision = tried;
+            break;
+        }
+    }
+    int count = precision;
+    while (count > 1 && digits % 10 == 0) {
+        digits /= 10;
+        count--;
+    }
+
+    // Laid out like `%.<precision>g`: an exponent if it is below -4 or at least the precision.
+    char text[MAX_SIGNIFICANT_DIGITS];
+    writeDigits(digits, count, text);
+    char *out = buffer + length;
+    if (exponent < -4 || exponent >= precision) {
+        *out++ = text[0];
+        if (count > 1) {
+            *out++ = '.';
+            memcpy(out, text + 1, count - 1);
+            out += count - 1;
+        }
+        *out++ = 'e';
+        *out++ = exponent < 0 ? '-' : '+';
+        out += writeDigits(exponent < 0 ? -exponent : exponent, 2, out);
+    } else if (exponent < 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = -1; i > exponent; i--) {
+            *out++ = '0';
+        }
+        memcpy(out, text, count);
+        out += count;
+    } else {
+        int integerDigits = exponent + 1;
+        for (int i = 0; i < integerDigits; i++) {
+            *out++ = i < count ? text[i] : '0';
+        }
+        if (count > integerDigits) {
+            *out++ = '.';
+            memcpy(out, text + integerDigits, count - integerDigits);
+            out += count - integerDigits;
+        }
+    }
+    *out = '\0';
+    return (int) (out - buffer);
+}
+
+bool parseNumber(const char *chars, int length, double *value) {
+    const char *current = chars;
+    const char *end = chars + length;
+
+    bool negative = false;
+    if (current < end && (*current == '-' || *current == '+')) {
+        negative = *current == '-';
+        current++;
+    }
+
+    // The significant digits go in the mantissa, the position of the decimal point in the exponent.
+    uint64_t mantissa = 0;
+    int mantissaDigits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool hasDigits = false;
+
+    for (; current < end && *current >= '0' && *current <= '9'; current++) {
+        hasDigits = true;
+        if (mantissaDigits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (*current - '0');
+            if (mantissa > 0)
+                mantissaDigits++;
+        } else {
+            exponent++;
+            truncated = true;
+        }
+    }
+
+    if (current < end && *current == '.') {
+        current++;
+        for (; current < end && *current >= '0' && *current <= '9'; current++) {
+            hasDigits = true;
+            if (mantissaDigits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + (*current - '0');
+                if (mantissa > 0)
+                    mantissaDigits++;
+                exponent--;
+            } else {
+                truncated = true;
+            }
+        }
+    }
+
+    if (!hasDigits)
+        return false;
+
+    if (current < end && (*current == 'e' || *current == 'E')) {
+        current++;
+        bool negativeExponent = false;
+        if (current < end && (*current == '-' || *current == '+')) {
+            negativeExponent = *current == '-';
+            current++;
+        }
+        if (current == end || *current < '0' || *current > '9')
+            return false;
+
+        int explicitExponent = 0;
+        for (; current < end && *current >= '0' && *current <= '9'; current++) {
+            // Way past the range of doubles already, stop before overflowing.
+            if (explicitExponent < 100000)
+                explicitExponent = explicitExponent * 10 + (*current - '0');
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    if (current != end)
+        return false;
+
+    // Both the mantissa and the power of ten are exact doubles, so one multiplication or division rounds correctly.
+    double result;
+    if (!truncated && mantissa <= (uint64_t) MAX_EXACT_INTEGER && exponent >= -22 && exponent <= 22) {
+        result = (double) mantissa;
+        result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+    } else {
+        // Slow path. The text is not necessarily terminated.
+        char small[64];
+        char *text = length < (int) sizeof(small) ? small : malloc(length + 1);
+        if (text == NULL)
+            return false;
+        memcpy(text, chars, length);
+        text[length] = '\0';
+        result = strtod(text, NULL);
+        if (text != small)
+            free(text);
+        *value = result;
+        return true;
+    }
+
+    *value = negative ? -result : result;
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef NAMELESS_NUMBER_H
+#define NAMELESS_NUMBER_H
+
+#include "common.h"
+
+/**
+ * Room `formatNumber` needs, terminator included.
+ */
+#define NUMBER_BUFFER_SIZE 32
+
+/**
+ * Format a number as the shortest text that reads back as the same number. Integers are written in full, as are
+ * numbers with a short enough decimal expansion, the rest use an exponent: `42`, `0.1`, `-1.5`, `1e+300`.
+ *
+ * @param value The number.
+ * @param buffer Where to write the text, NUMBER_BUFFER_SIZE bytes. The text is NUL terminated, and nothing is written
+ * past the terminator.
+ * @return The length of the text.
+ */
+int formatNumber(double value, char *buffer);
+
+/**
+ * Parse a decimal number: an optional sign, digits with an optional fraction and an optional exponent, as in
+ * `-12.5e3`. Numbers with up to 15 digits or so and a small exponent, which covers most of them, are converted exactly
+ * without going through `strtod`.
+ *
+ * @param chars The text, not necessarily NUL terminated.
+ * @param length The length of the text.
+ * @param value Output parameter, the number.
+ * @return Whether the whole text is a number.
+ */
+bool parseNumber(const char *chars, int length, double *value);
+
+#endif
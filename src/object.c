@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "object.h"
 #include "memory.h"
@@ -8,19 +9,35 @@
 #define ALLOCATE_OBJ(type, objectType) (type*)allocateObject(sizeof(type), objectType)
 
 /**
- * Allocate the memory for an object.
+ * Allocate the memory for an object. In region mode the memory comes from the VM's arena.
  *
  * @param size The size of the Object.
  * @param type The type of the Object.
  * @return The Object.
  */
 static Obj *allocateObject(size_t size, ObjType type) {
-    Obj *object = (Obj *) reallocate(NULL, 0, size);
+    Obj *object = NULL;
+
+    // In region mode objects are bumped out of the arena, as long as there is room.
+    if (vm.regionMode)
+        object = (Obj *) arenaAllocate(&vm.arena, size);
+
+    if (object != NULL) {
+        object->isRegion = true;
+        object->next = vm.regionObjects;
+        vm.regionObjects = object;
+    } else {
+        // The arena is full: from now on garbage collection is back on for this run.
+        if (vm.regionMode)
+            vm.regionFull = true;
+        object = (Obj *) reallocate(NULL, 0, size);
+        object->isRegion = false;
+        // Add object at the top of the linked list of the VM.
+        object->next = vm.objects;
+        vm.objects = object;
+    }
     object->type = type;
     object->isMarked = false;
-    // Add object at the top of the linked list of the VM.
-    object->next = vm.objects;
-    vm.objects = object;
 
 #ifdef DEBUG_LOG_GC
     printf("%p allocate %zu for %d\n", (void *) object, size, type);
@@ -29,8 +46,32 @@ static Obj *allocateObject(size_t size, ObjType type) {
     return object;
 }
 
+/**
+ * Take a dead object of the right type out of a pool, if any, and bring it back to life on the heap. Pooled memory is
+ * still accounted for in `vm.bytesAllocated`. In region mode the arena is cheaper, so pools are left alone until it
+ * fills up.
+ *
+ * @param pool The pool.
+ * @param count How many objects are in the pool.
+ * @return The object, or NULL if the pool can't be used.
+ */
+static Obj *reuseObject(Obj **pool, int *count) {
+    if (*pool == NULL || (vm.regionMode && !vm.regionFull))
+        return NULL;
+
+    Obj *object = *pool;
+    *pool = object->next;
+    (*count)--;
+    object->isMarked = false;
+    object->next = vm.objects;
+    vm.objects = object;
+    return object;
+}
+
 ObjBoundMethod *newBoundMethod(Value receiver, ObjClosure *method) {
-    ObjBoundMethod *bound = ALLOCATE_OBJ(ObjBoundMethod, OBJ_BOUND_METHOD);
+    ObjBoundMethod *bound = (ObjBoundMethod *) reuseObject(&vm.boundMethodPool, &vm.boundMethodPoolCount);
+    if (bound == NULL)
+        bound = ALLOCATE_OBJ(ObjBoundMethod, OBJ_BOUND_METHOD);
     bound->receiver = receiver;
     bound->method = method;
     return bound;
@@ -40,6 +81,14 @@ ObjClass *newClass(ObjString *name) {
     ObjClass *klass = ALLOCATE_OBJ(ObjClass, OBJ_CLASS);
     klass->name = name;
     initTable(&klass->methods);
+    klass->vtable = NULL;
+    klass->vtableSize = 0;
+    klass->initializer = NIL_VAL;
+    klass->fieldSlots = NULL;
+    klass->fieldSlotsCapacity = 0;
+    klass->fieldCount = 0;
+    klass->constructedFields = 0;
+    klass->isSealed = false;
     return klass;
 }
 
@@ -49,10 +98,16 @@ ObjClosure *newClosure(ObjFunction *function) {
         upvalues[i] = NULL;
     }
 
-    ObjClosure *closure = ALLOCATE_OBJ(ObjClosure, OBJ_CLOSURE);
+    ObjClosure *closure = (ObjClosure *) allocateObject(
+            sizeof(ObjClosure) + sizeof(Value) * function->capturedCount, OBJ_CLOSURE
+    );
     closure->function = function;
     closure->upvalues = upvalues;
     closure->upvalueCount = function->upvalueCount;
+    closure->capturedCount = function->capturedCount;
+    for (int i = 0; i < function->capturedCount; i++) {
+        closure->captured[i] = NIL_VAL;
+    }
     return closure;
 }
 
@@ -60,18 +115,205 @@ ObjFunction *newFunction() {
     ObjFunction *function = ALLOCATE_OBJ(ObjFunction, OBJ_FUNCTION);
     function->arity = 0;
     function->upvalueCount = 0;
+    function->capturedCount = 0;
+    function->hasCapturedLocals = false;
     function->name = NULL;
     initChunk(&function->chunk);
     return function;
 }
 
 ObjInstance *newInstance(ObjClass *klass) {
-    ObjInstance *instance = ALLOCATE_OBJ(ObjInstance, OBJ_INSTANCE);
+    // A recycled instance comes with empty field slots, usually enough of them already.
+    ObjInstance *instance = (ObjInstance *) reuseObject(&vm.instancePool, &vm.instancePoolCount);
+    if (instance == NULL) {
+        instance = ALLOCATE_OBJ(ObjInstance, OBJ_INSTANCE);
+        instance->fields = NULL;
+        instance->fieldCapacity = 0;
+    }
     instance->klass = klass;
-    initTable(&instance->fields);
+    instance->isConstructing = false;
+    // Make room for the fields `init` set last time, so that it does not have to grow the slots field by field.
+    if (klass->constructedFields > instance->fieldCapacity) {
+        push(OBJ_VAL(instance));
+        reserveFields(instance, klass->constructedFields);
+        pop();
+    }
     return instance;
 }
 
+void reserveFields(ObjInstance *instance, int count) {
+    if (count <= instance->fieldCapacity)
+        return;
+
+    instance->fields = GROW_ARRAY(Value, instance->fields, instance->fieldCapacity, count);
+    for (int i = instance->fieldCapacity; i < count; i++) {
+        instance->fields[i] = EMPTY_VAL;
+    }
+    instance->fieldCapacity = count;
+}
+
+ObjList *newList() {
+    ObjList *list = ALLOCATE_OBJ(ObjList, OBJ_LIST);
+    list->count = 0;
+    list->capacity = 0;
+    list->items = NULL;
+    return list;
+}
+
+void appendToList(ObjList *list, Value value) {
+    if (list->count == list->capacity) {
+        int capacity = GROW_CAPACITY(list->capacity);
+        list->items = GROW_ARRAY(Value, list->items, list->capacity, capacity);
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = value;
+}
+
+ObjFile *newFile(ObjString *path, int fd) {
+    ObjFile *file = ALLOCATE_OBJ(ObjFile, OBJ_FILE);
+    file->path = path;
+    file->fd = fd;
+    file->buffer = NULL;
+    file->capacity = 0;
+    file->start = 0;
+    file->end = 0;
+    file->atEnd = false;
+    return file;
+}
+
+void closeFile(ObjFile *file) {
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+    FREE_ARRAY(char, file->buffer, file->capacity);
+    file->buffer = NULL;
+    file->capacity = 0;
+    file->start = 0;
+    file->end = 0;
+}
+
+ObjMap *newMap() {
+    ObjMap *map = ALLOCATE_OBJ(ObjMap, OBJ_MAP);
+    initTable(&map->index);
+    map->count = 0;
+    map->used = 0;
+    map->capacity = 0;
+    map->keys = NULL;
+    map->values = NULL;
+    return map;
+}
+
+bool mapGet(ObjMap *map, ObjString *key, Value *value) {
+    Value position;
+    if (!tableGet(&map->index, key, &position))
+        return false;
+    *value = map->values[(int) AS_NUMBER(position)];
+    return true;
+}
+
+void mapSet(ObjMap *map, ObjString *key, Value value) {
+    Value position;
+    if (tableGet(&map->index, key, &position)) {
+        map->values[(int) AS_NUMBER(position)] = value;
+        return;
+    }
+
+    if (map->used == map->capacity) {
+        int capacity = GROW_CAPACITY(map->capacity);
+        map->keys = GROW_ARRAY(ObjString*, map->keys, map->capacity, capacity);
+        map->values = GROW_ARRAY(Value, map->values, map->capacity, capacity);
+        map->capacity = capacity;
+    }
+    // The entry is in place before the index grows, so the collector sees the key and the value.
+    map->keys[map->used] = key;
+    map->values[map->used] = value;
+    map->used++;
+    map->count++;
+    tableSet(&map->index, key, NUMBER_VAL(map->used - 1));
+}
+
+/**
+ * Move the entries of a map down over the slots of the removed ones, keeping their order.
+ *
+ * @param map The map.
+ */
+static void compactMap(ObjMap *map) {
+    int count = 0;
+    for (int i = 0; i < map->used; i++) {
+        if (map->keys[i] == NULL)
+            continue;
+        if (i != count) {
+            map->keys[count] = map->keys[i];
+            map->values[count] = map->values[i];
+            tableSet(&map->index, map->keys[count], NUMBER_VAL(count));
+        }
+        count++;
+    }
+    map->used = count;
+}
+
+bool mapDelete(ObjMap *map, ObjString *key, Value *value) {
+    Value position;
+    if (!tableGet(&map->index, key, &position))
+        return false;
+
+    int removed = (int) AS_NUMBER(position);
+    *value = map->values[removed];
+    tableDelete(&map->index, key);
+    map->keys[removed] = NULL;
+    map->values[removed] = NIL_VAL;
+    map->count--;
+
+    // Each compaction follows at least as many removals as the entries it moves.
+    if (map->used - map->count > map->count)
+        compactMap(map);
+    return true;
+}
+
+ObjRecordType *newRecordType(ObjString *name, int fieldCount) {
+    ObjRecordType *type = (ObjRecordType *) allocateObject(
+            sizeof(ObjRecordType) + sizeof(ObjString *) * fieldCount, OBJ_RECORD_TYPE
+    );
+    type->name = name;
+    type->fieldCount = fieldCount;
+    for (int i = 0; i < fieldCount; i++) {
+        type->fields[i] = NULL;
+    }
+    return type;
+}
+
+ObjRecord *newRecord(ObjRecordType *type, Value *values) {
+    ObjRecord *record = (ObjRecord *) allocateObject(sizeof(ObjRecord) + sizeof(Value) * type->fieldCount, OBJ_RECORD);
+    record->type = type;
+    record->fieldCount = type->fieldCount;
+    memcpy(record->values, values, sizeof(Value) * type->fieldCount);
+    return record;
+}
+
+bool recordGet(ObjRecord *record, ObjString *name, Value *value) {
+    // Records are small, a scan beats hashing.
+    ObjRecordType *type = record->type;
+    for (int i = 0; i < type->fieldCount; i++) {
+        if (type->fields[i] == name) {
+            *value = record->values[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool recordsEqual(ObjRecord *a, ObjRecord *b) {
+    if (a->type != b->type)
+        return false;
+
+    for (int i = 0; i < a->type->fieldCount; i++) {
+        if (!valuesEqual(a->values[i], b->values[i]))
+            return false;
+    }
+    return true;
+}
+
 ObjNative *newNative(NativeFn function) {
     ObjNative *native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
     native->function = function;
@@ -90,6 +332,7 @@ static ObjString *allocateString(char *chars, int length, uint32_t hash) {
     string->length = length;
     string->chars = chars;
     string->hash = hash;
+    string->symbol = -1;
     // Intern the string.
     push(OBJ_VAL(string));
     tableSet(&vm.strings, string, NIL_VAL);
@@ -113,6 +356,10 @@ static uint32_t hashString(const char *key, int length) {
     return hash;
 }
 
+ObjString *findString(const char *chars, int length) {
+    return tableFindString(&vm.strings, chars, length, hashString(chars, length));
+}
+
 ObjString *copyString(const char *chars, int length) {
     uint32_t hash = hashString(chars, length);
 
@@ -131,16 +378,21 @@ ObjUpvalue *newUpvalue(Value *slot) {
     ObjUpvalue *upvalue = ALLOCATE_OBJ(ObjUpvalue, OBJ_UPVALUE);
     upvalue->closed = NIL_VAL;
     upvalue->location = slot;
-    upvalue->next = NULL;
     return upvalue;
 }
 
-static void printFunction(ObjFunction *function) {
+/**
+ * Write a function the way `print` shows it.
+ *
+ * @param output The output stream.
+ * @param function The function.
+ */
+static void writeFunction(Output *output, ObjFunction *function) {
     if (function->name == NULL) {
-        printf("<script>");
+        writeOutput(output, "<script>", 8);
         return;
     }
-    printf("<function %s>", function->name->chars);
+    writeFormatted(output, "<function %s>", function->name->chars);
 }
 
 ObjString *takeString(char *chars, int length) {
@@ -158,31 +410,122 @@ ObjString *takeString(char *chars, int length) {
     return allocateString(chars, length, hash);
 }
 
-void printObject(Value value) {
+/**
+ * Most lists and maps inside one another that are written out. Past that, a list is written as `[...]` and a map as
+ * `{...}`, as is a list or map inside itself.
+ */
+#define WRITE_MAX_DEPTH 64
+
+/**
+ * The lists and maps being written out, outermost first.
+ */
+static Obj *writing[WRITE_MAX_DEPTH];
+static int writingCount = 0;
+
+/**
+ * Start writing out the content of a list or map, unless it is already being written out, around it, or it is nested
+ * too deeply.
+ *
+ * @param object The list or map.
+ * @return Whether to write out the content, then call `endWriting`.
+ */
+static bool startWriting(Obj *object) {
+    if (writingCount == WRITE_MAX_DEPTH)
+        return false;
+    for (int i = 0; i < writingCount; i++) {
+        if (writing[i] == object)
+            return false;
+    }
+    writing[writingCount++] = object;
+    return true;
+}
+
+static void endWriting() {
+    writingCount--;
+}
+
+void writeObject(Output *output, Value value) {
     switch (OBJ_TYPE(value)) {
         case OBJ_BOUND_METHOD:
-            printFunction(AS_BOUND_METHOD(value)->method->function);
+            writeFunction(output, AS_BOUND_METHOD(value)->method->function);
             break;
         case OBJ_CLASS:
-            printf("<class '%s'>", AS_CLASS(value)->name->chars);
+            writeFormatted(output, "<class '%s'>", AS_CLASS(value)->name->chars);
             break;
         case OBJ_CLOSURE:
-            printFunction(AS_CLOSURE(value)->function);
+            writeFunction(output, AS_CLOSURE(value)->function);
+            break;
+        case OBJ_FILE:
+            writeFormatted(output, "<file '%s'>", AS_FILE(value)->path->chars);
             break;
         case OBJ_FUNCTION:
-            printFunction(AS_FUNCTION(value));
+            writeFunction(output, AS_FUNCTION(value));
             break;
         case OBJ_INSTANCE:
-            printf("<'%s' object>", AS_INSTANCE(value)->klass->name->chars);
+            writeFormatted(output, "<'%s' object>", AS_INSTANCE(value)->klass->name->chars);
+            break;
+        case OBJ_LIST: {
+            ObjList *list = AS_LIST(value);
+            if (!startWriting(AS_OBJ(value))) {
+                writeOutput(output, "[...]", 5);
+                break;
+            }
+            writeOutput(output, "[", 1);
+            for (int i = 0; i < list->count; i++) {
+                if (i > 0)
+                    writeOutput(output, ", ", 2);
+                writeValue(output, list->items[i]);
+            }
+            writeOutput(output, "]", 1);
+            endWriting();
+            break;
+        }
+        case OBJ_MAP: {
+            ObjMap *map = AS_MAP(value);
+            if (!startWriting(AS_OBJ(value))) {
+                writeOutput(output, "{...}", 5);
+                break;
+            }
+            writeOutput(output, "{", 1);
+            bool first = true;
+            for (int i = 0; i < map->used; i++) {
+                if (map->keys[i] == NULL)
+                    continue;
+                if (!first)
+                    writeOutput(output, ", ", 2);
+                first = false;
+                writeOutput(output, map->keys[i]->chars, map->keys[i]->length);
+                writeOutput(output, ": ", 2);
+                writeValue(output, map->values[i]);
+            }
+            writeOutput(output, "}", 1);
+            endWriting();
             break;
+        }
         case OBJ_NATIVE:
-            printf("<native @ %p>", AS_OBJ(value));
+            writeFormatted(output, "<native @ %p>", AS_OBJ(value));
+            break;
+        case OBJ_RECORD: {
+            ObjRecord *record = AS_RECORD(value);
+            ObjString *name = record->type->name;
+            writeOutput(output, name->chars, name->length);
+            writeOutput(output, "(", 1);
+            for (int i = 0; i < record->fieldCount; i++) {
+                if (i > 0)
+                    writeOutput(output, ", ", 2);
+                writeValue(output, record->values[i]);
+            }
+            writeOutput(output, ")", 1);
+            break;
+        }
+        case OBJ_RECORD_TYPE:
+            writeFormatted(output, "<record '%s'>", AS_RECORD_TYPE(value)->name->chars);
             break;
         case OBJ_STRING:
-            printf("%s", AS_C_STRING(value));
+            writeOutput(output, AS_C_STRING(value), AS_STRING(value)->length);
             break;
         case OBJ_UPVALUE:
-            printf("<upvalue>");
+            writeOutput(output, "<upvalue>", 9);
             break;
     }
 }
@@ -16,10 +16,15 @@
  */
 #define IS_BOUND_METHOD(value)  isObjType(value, OBJ_BOUND_METHOD)
 #define IS_CLOSURE(value)       isObjType(value, OBJ_CLOSURE)
+#define IS_FILE(value)          isObjType(value, OBJ_FILE)
 #define IS_FUNCTION(value)      isObjType(value, OBJ_FUNCTION)
 #define IS_NATIVE(value)        isObjType(value, OBJ_NATIVE)
+#define IS_RECORD(value)        isObjType(value, OBJ_RECORD)
+#define IS_RECORD_TYPE(value)   isObjType(value, OBJ_RECORD_TYPE)
 #define IS_CLASS(value)         isObjType(value, OBJ_CLASS)
 #define IS_INSTANCE(value)      isObjType(value, OBJ_INSTANCE)
+#define IS_LIST(value)          isObjType(value, OBJ_LIST)
+#define IS_MAP(value)           isObjType(value, OBJ_MAP)
 #define IS_STRING(value)        isObjType(value, OBJ_STRING)
 
 /**
@@ -27,10 +32,15 @@
  */
 #define AS_BOUND_METHOD(value)  ((ObjBoundMethod*)AS_OBJ(value))
 #define AS_CLOSURE(value)       ((ObjClosure*)AS_OBJ(value))
+#define AS_FILE(value)          ((ObjFile*)AS_OBJ(value))
 #define AS_FUNCTION(value)      ((ObjFunction*)AS_OBJ(value))
 #define AS_NATIVE(value)        (((ObjNative*)AS_OBJ(value))->function)
+#define AS_RECORD(value)        ((ObjRecord*)AS_OBJ(value))
+#define AS_RECORD_TYPE(value)   ((ObjRecordType*)AS_OBJ(value))
 #define AS_CLASS(value)         ((ObjClass*)AS_OBJ(value))
 #define AS_INSTANCE(value)      ((ObjInstance*)AS_OBJ(value))
+#define AS_LIST(value)          ((ObjList*)AS_OBJ(value))
+#define AS_MAP(value)           ((ObjMap*)AS_OBJ(value))
 #define AS_STRING(value)        ((ObjString*)AS_OBJ(value))
 #define AS_C_STRING(value)      (((ObjString*)AS_OBJ(value))->chars)
 
@@ -41,9 +51,14 @@ typedef enum {
     OBJ_BOUND_METHOD,
     OBJ_CLASS,
     OBJ_CLOSURE,
+    OBJ_FILE,
     OBJ_FUNCTION,
     OBJ_INSTANCE,
+    OBJ_LIST,
+    OBJ_MAP,
     OBJ_NATIVE,
+    OBJ_RECORD,
+    OBJ_RECORD_TYPE,
     OBJ_STRING,
     OBJ_UPVALUE
 } ObjType;
@@ -54,6 +69,7 @@ typedef enum {
 struct Obj {
     ObjType type;
     bool isMarked;
+    bool isRegion;      // Whether the object lives in the region arena instead of the heap.
     struct Obj *next;
 };
 
@@ -61,15 +77,18 @@ struct Obj {
  * Structure for a function object.
  */
 typedef struct {
-    Obj obj;            // The base Object structure.
-    int arity;          // How many parameters the function takes.
-    int upvalueCount;   // How many up-values the function references.
-    Chunk chunk;        // The code of the function.
-    ObjString *name;    // The string name of the function.
+    Obj obj;                    // The base Object structure.
+    int arity;                  // How many parameters the function takes.
+    int upvalueCount;           // How many up-values the function references.
+    int capturedCount;          // How many values the function captures by copy.
+    bool hasCapturedLocals;     // Whether some local is captured by reference, so returning must close upvalues.
+    Chunk chunk;                // The code of the function.
+    ObjString *name;            // The string name of the function.
 } ObjFunction;
 
 /**
  * C function to be called from a binding. Takes a pointer to its first argument and how many arguments were passed.
+ * Native methods get the receiver as their first argument. To raise a runtime error, return `nativeError(...)`.
  */
 typedef Value (*NativeFn)(int argCount, Value *args);
 
@@ -90,6 +109,7 @@ struct ObjString {
     uint32_t hash;
     int length;
     char *chars;
+    int symbol;     // Symbol id if the string names a property or method, -1 otherwise. See `symbolFor`.
 };
 
 /**
@@ -97,39 +117,123 @@ struct ObjString {
  */
 typedef struct ObjUpvalue {
     Obj obj;
-    Value *location;
+    Value *location;    // The stack slot while open, `closed` afterwards.
     Value closed;
-    struct ObjUpvalue *next;    // Intrusive linked list. Used to keep track of all upvalues to avoid having duplicates.
 } ObjUpvalue;
 
 /**
- * Representation of a Closure.
+ * Representation of a Closure. Variables that are never assigned are copied right into the closure (flat closure), so
+ * reading them takes a single load. The others go through an upvalue.
  */
 typedef struct {
     Obj obj;
     ObjFunction *function;
     ObjUpvalue **upvalues;
     int upvalueCount;
+    int capturedCount;
+    Value captured[];   // Flexible array member, values captured by copy.
 } ObjClosure;
 
 /**
  * Representation of a Class.
  */
+/**
+ * Entry of the field layout of a class: the slot a field has in the instances.
+ */
+typedef struct {
+    int symbol;             // Symbol of the field name, -1 for an unused entry.
+    int slot;
+} FieldSlot;
+
 typedef struct {
     Obj obj;
     ObjString *name;
     Table methods;
+    Value *vtable;          // Methods indexed by selector, nil where the class has no such method.
+    int vtableSize;         // Length of the vtable, one past the highest selector among the methods.
+    Value initializer;      // The `init` method, cached to make construction fast. Nil if the class has none.
+    FieldSlot *fieldSlots;  // Slot of each field in the instances, a hash table of the field symbols.
+    int fieldSlotsCapacity; // Size of fieldSlots, a power of 2 to mask hashes with, 0 before the first field.
+    int fieldCount;         // How many fields were laid out.
+    int constructedFields;  // Slots the last instance `init` returned used. New instances are sized for as many.
+    bool isSealed;          // No subclasses and no fields but the ones `init` sets, which can't shadow methods.
 } ObjClass;
 
 /**
- * Representation of a Class.
+ * Representation of an instance. Fields sit in the slots the class laid out for them, the first time some instance set
+ * them. Slots of fields this instance never set are empty.
  */
 typedef struct {
     Obj obj;
     ObjClass *klass;
-    Table fields;
+    Value *fields;          // Field values, indexed by the class' fieldSlots.
+    int fieldCapacity;      // How many slots `fields` has, may lag behind the class' fieldCount.
+    bool isConstructing;    // The class was called for this instance and its `init` did not return yet. Sealed
+                            // instances only get new fields then.
 } ObjInstance;
 
+/**
+ * Representation of a record declaration, e.g. `record Point(x, y);`. Calling it builds a record.
+ */
+typedef struct {
+    Obj obj;
+    ObjString *name;
+    int fieldCount;
+    ObjString *fields[];    // Flexible array member, the field names in declaration order.
+} ObjRecordType;
+
+/**
+ * Representation of a record. Records are immutable and compared by value, their fields sit right in the object in
+ * the order of the declaration, so there is no field table.
+ */
+typedef struct {
+    Obj obj;
+    ObjRecordType *type;
+    int fieldCount;         // Same as the type's, kept here so the record never needs its type to be alive.
+    Value values[];         // Flexible array member, one value per field of the type.
+} ObjRecord;
+
+/**
+ * Representation of a list, a growable array of values.
+ */
+typedef struct {
+    Obj obj;
+    int count;              // How many items the list has.
+    int capacity;           // How many items fit in `items`.
+    Value *items;
+} ObjList;
+
+/**
+ * Representation of a map from strings to values. Keys remember the order they were added in, which is the order
+ * they are printed and iterated in. A removed entry leaves a NULL key behind until the map is compacted, which walks
+ * over the entries skip.
+ */
+typedef struct {
+    Obj obj;
+    Table index;            // Position of each key in `keys` and `values`, as a number.
+    int count;              // How many entries the map has.
+    int used;               // How many slots of `keys` and `values` are taken, removed entries included.
+    int capacity;           // How many entries fit in `keys` and `values`.
+    ObjString **keys;       // The keys, in the order they were added, NULL for a removed entry.
+    Value *values;          // The value of each key.
+} ObjMap;
+
+/**
+ * Representation of a file open for reading. The file is read in big chunks into a buffer which records are then cut
+ * from, so reading a record seldom takes a system call. The buffer is reused for the whole file, and only grows for a
+ * record that does not fit.
+ */
+typedef struct {
+    Obj obj;
+    ObjString *path;        // For printing.
+    int fd;                 // File descriptor, -1 once closed.
+    char *buffer;           // Bytes read from the file, NULL until the first read.
+    int capacity;           // Size of the buffer.
+    int start;              // Where the bytes not handed out yet start in the buffer.
+    int end;                // Where they end.
+    bool atEnd;             // The whole file is in the buffer or was handed out.
+} ObjFile;
+
 /**
  * Bound method. References the method and the object it is bound to.
  */
@@ -164,6 +268,23 @@ ObjClass *newClass(ObjString *name);
  */
 ObjClosure *newClosure(ObjFunction *function);
 
+/**
+ * Allocate a new file object.
+ *
+ * @param path The path the file was opened with.
+ * @param fd The file descriptor, which the object now owns.
+ * @return The file object.
+ */
+ObjFile *newFile(ObjString *path, int fd);
+
+/**
+ * Close the file descriptor of a file object and free its buffer, if not done already. Garbage collection does it for
+ * files a program forgot to close.
+ *
+ * @param file The file object.
+ */
+void closeFile(ObjFile *file);
+
 /**
  * Allocate a new function Object.
  *
@@ -179,6 +300,68 @@ ObjFunction *newFunction();
  */
 ObjInstance *newInstance(ObjClass *klass);
 
+/**
+ * Make sure an instance has at least the given number of field slots. New slots are empty. May trigger garbage
+ * collection, so the instance must be reachable.
+ *
+ * @param instance The instance.
+ * @param count The number of slots needed.
+ */
+void reserveFields(ObjInstance *instance, int count);
+
+/**
+ * Allocate a new, empty list.
+ *
+ * @return The list.
+ */
+ObjList *newList();
+
+/**
+ * Add an item at the end of a list. May trigger garbage collection, so the list and the item must be reachable.
+ *
+ * @param list The list.
+ * @param value The item.
+ */
+void appendToList(ObjList *list, Value value);
+
+/**
+ * Allocate a new, empty map.
+ *
+ * @return The map.
+ */
+ObjMap *newMap();
+
+/**
+ * Read an entry of a map.
+ *
+ * @param map The map.
+ * @param key The key.
+ * @param value Output parameter, the value of the key.
+ * @return Whether the map has the key.
+ */
+bool mapGet(ObjMap *map, ObjString *key, Value *value);
+
+/**
+ * Set an entry of a map. A new key goes after the others. May trigger garbage collection, so the map, the key and the
+ * value must be reachable.
+ *
+ * @param map The map.
+ * @param key The key.
+ * @param value The value.
+ */
+void mapSet(ObjMap *map, ObjString *key, Value value);
+
+/**
+ * Remove an entry from a map. Its slot stays empty until the empty slots outnumber the entries, then the entries move
+ * down together, so a removal takes constant time on average.
+ *
+ * @param map The map.
+ * @param key The key.
+ * @param value Output parameter, the value the key had.
+ * @return Whether the map had the key.
+ */
+bool mapDelete(ObjMap *map, ObjString *key, Value *value);
+
 /**
  * Allocate a new native function binding.
  *
@@ -187,6 +370,43 @@ ObjInstance *newInstance(ObjClass *klass);
  */
 ObjNative *newNative(NativeFn function);
 
+/**
+ * Allocate a new record type. Field names are left NULL for the caller to fill.
+ *
+ * @param name The name of the record type.
+ * @param fieldCount How many fields its records have.
+ * @return The record type.
+ */
+ObjRecordType *newRecordType(ObjString *name, int fieldCount);
+
+/**
+ * Allocate a new record.
+ *
+ * @param type The record type.
+ * @param values The values of the fields, `type->fieldCount` of them.
+ * @return The record.
+ */
+ObjRecord *newRecord(ObjRecordType *type, Value *values);
+
+/**
+ * Read a field of a record.
+ *
+ * @param record The record.
+ * @param name The field name.
+ * @param value Output parameter, the value of the field.
+ * @return Whether the record has such field.
+ */
+bool recordGet(ObjRecord *record, ObjString *name, Value *value);
+
+/**
+ * Compare two records by value.
+ *
+ * @param a A record.
+ * @param b Another record.
+ * @return Whether they have the same type and equal fields.
+ */
+bool recordsEqual(ObjRecord *a, ObjRecord *b);
+
 /**
  * Take a string and put it in an object after copying it.
  *
@@ -196,6 +416,15 @@ ObjNative *newNative(NativeFn function);
  */
 ObjString *copyString(const char *chars, int length);
 
+/**
+ * Find the interned string with the given characters, without making one if there is none.
+ *
+ * @param chars The characters.
+ * @param length How many there are.
+ * @return The string, NULL if no string has these characters.
+ */
+ObjString *findString(const char *chars, int length);
+
 /**
  * Allocate space for new upvalue.
  *
@@ -214,11 +443,13 @@ ObjUpvalue *newUpvalue(Value *slot);
 ObjString *takeString(char *chars, int length);
 
 /**
- * Print an Object.
+ * Write an Object to an output stream, the way `print` shows it. A list inside itself is written as `[...]`, a map
+ * inside itself as `{...}`.
  *
+ * @param output The output stream.
  * @param value A Value which must be an Object.
  */
-void printObject(Value value);
+void writeObject(Output *output, Value value);
 
 /**
  * Check an object's type. Why don't we add another couple of macros like we did for built in values? Because here one
@@ -234,4 +465,26 @@ static inline bool isObjType(Value value, ObjType type) {
     return IS_OBJ(value) && AS_OBJ(value)->type == type;
 }
 
+/**
+ * Find the slot of a field in the instances of a class. Symbols are small consecutive numbers, so they hash to
+ * themselves, and the fields of a class seldom collide.
+ *
+ * @param klass The class.
+ * @param symbol The symbol of the field name.
+ * @return The slot, -1 if the class has no such field.
+ */
+static inline int findFieldSlot(ObjClass *klass, int symbol) {
+    // Unused entries have a symbol of -1.
+    if (klass->fieldSlotsCapacity == 0 || symbol < 0)
+        return -1;
+    int mask = klass->fieldSlotsCapacity - 1;
+    int index = symbol & mask;
+    while (klass->fieldSlots[index].symbol != symbol) {
+        if (klass->fieldSlots[index].symbol < 0)
+            return -1;
+        index = (index + 1) & mask;
+    }
+    return klass->fieldSlots[index].slot;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "output.h"
+
+void initOutput(Output *output, size_t capacity, FlushPolicy policy) {
+    output->buffer = NULL;
+    output->capacity = 0;
+    output->used = 0;
+    output->policy = policy;
+    output->sink = streamSink;
+    output->sinkData = stdout;
+    resizeOutput(output, capacity);
+}
+
+void freeOutput(Output *output) {
+    flushOutput(output);
+    free(output->buffer);
+    output->buffer = NULL;
+    output->capacity = 0;
+}
+
+void resizeOutput(Output *output, size_t capacity) {
+    flushOutput(output);
+    free(output->buffer);
+    output->buffer = NULL;
+    output->capacity = 0;
+
+    if (capacity == 0)
+        return;
+
+    output->buffer = malloc(capacity);
+    // Not enough memory: writing through is slower, but still works.
+    if (output->buffer != NULL)
+        output->capacity = capacity;
+}
+
+void flushOutput(Output *output) {
+    if (output->used == 0)
+        return;
+
+    output->sink(output->sinkData, output->buffer, output->used);
+    output->used = 0;
+}
+
+void writeOutput(Output *output, const char *chars, size_t length) {
+    if (length == 0)
+        return;
+
+    if (length > output->capacity - output->used) {
+        flushOutput(output);
+        // Bigger than the whole buffer: no point in copying it.
+        if (length > output->capacity) {
+            output->sink(output->sinkData, chars, length);
+            return;
+        }
+    }
+
+    memcpy(output->buffer + output->used, chars, length);
+    output->used += length;
+
+    if (output->policy == FLUSH_LINE && memchr(chars, '\n', length) != NULL)
+        flushOutput(output);
+}
+
+void writeFormatted(Output *output, const char *format, ...) {
+    // Short texts, like numbers, are formatted right into the buffer.
+    char *end = output->buffer == NULL ? NULL : output->buffer + output->used;
+    size_t room = output->capacity - output->used;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(end, room, format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+
+    if ((size_t) length < room) {
+        output->used += length;
+        if (output->policy == FLUSH_LINE && memchr(end, '\n', length) != NULL)
+            flushOutput(output);
+        return;
+    }
+
+    // Did not fit: format it again, on the side.
+    char small[128];
+    char *text = (size_t) length < sizeof(small) ? small : malloc(length + 1);
+    if (text == NULL)
+        return;
+    va_start(args, format);
+    vsnprintf(text, length + 1, format, args);
+    va_end(args);
+
+    writeOutput(output, text, length);
+    if (text != small)
+        free(text);
+}
+
+void streamSink(void *data, const char *chars, size_t length) {
+    FILE *stream = (FILE *) data;
+    fwrite(chars, sizeof(char), length, stream);
+    fflush(stream);
+}
+
+void fileDescriptorSink(void *data, const char *chars, size_t length) {
+    int fd = (int) (intptr_t) data;
+    while (length > 0) {
+        ssize_t written = write(fd, chars, length);
+        if (written < 0) {
+            // Interrupted before writing anything: try again. Any other error drops the output.
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        chars += written;
+        length -= written;
+    }
+}
+
+void memorySink(void *data, const char *chars, size_t length) {
+    MemorySink *sink = (MemorySink *) data;
+    if (sink->length + length + 1 > sink->capacity) {
+        size_t capacity = sink->capacity < 64 ? 64 : sink->capacity;
+        while (sink->length + length + 1 > capacity)
+            capacity *= 2;
+
+        char *grown = realloc(sink->chars, capacity);
+        if (grown == NULL)
+            return;
+        sink->chars = grown;
+        sink->capacity = capacity;
+    }
+
+    memcpy(sink->chars + sink->length, chars, length);
+    sink->length += length;
+    sink->chars[sink->length] = '\0';
+}
+
+void freeMemorySink(MemorySink *sink) {
+    free(sink->chars);
+    sink->chars = NULL;
+    sink->length = 0;
+    sink->capacity = 0;
+}
@@ -0,0 +1,123 @@
+#ifndef NAMELESS_OUTPUT_H
+#define NAMELESS_OUTPUT_H
+
+#include "common.h"
+
+/**
+ * Default size of the VM's output buffer.
+ */
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/**
+ * When buffered output is handed to the sink. Whatever the policy, output is flushed when the buffer is full, when
+ * `flush()` is called, before a runtime error is reported and when the VM is freed.
+ */
+typedef enum {
+    FLUSH_LINE,         // After every line. For terminals, where someone watches the output.
+    FLUSH_FULL,         // When a call to `interpret` ends.
+    FLUSH_EXPLICIT,     // Never on its own. Output may carry over from one run to the next.
+} FlushPolicy;
+
+/**
+ * Where buffered output ends up. Called with a chunk of bytes each time the buffer is flushed.
+ *
+ * @param data The data the sink was registered with.
+ * @param chars The bytes.
+ * @param length How many bytes.
+ */
+typedef void (*OutputSink)(void *data, const char *chars, size_t length);
+
+/**
+ * Output stream with a buffer in front of a sink, so that many small writes become a few big ones.
+ *
+ * The buffer memory is not managed by garbage collection and does not count towards `vm.bytesAllocated`.
+ */
+typedef struct {
+    char *buffer;           // Bytes waiting to be flushed.
+    size_t capacity;        // Size of the buffer. 0 means every write goes straight to the sink.
+    size_t used;            // How many bytes are in the buffer.
+    FlushPolicy policy;     // When to flush besides when the buffer is full.
+    OutputSink sink;        // Where flushed bytes go.
+    void *sinkData;         // Passed along to the sink.
+} Output;
+
+/**
+ * A sink collecting output in memory, for embedders and tests. Pass a pointer to one as the sink data of `memorySink`.
+ */
+typedef struct {
+    char *chars;            // Everything written so far, NUL terminated. NULL until something is written.
+    size_t length;          // How many bytes were written.
+    size_t capacity;        // Size of `chars`.
+} MemorySink;
+
+/**
+ * Initialize an output stream writing to the standard output.
+ *
+ * @param output The output stream.
+ * @param capacity Size of the buffer, 0 to write through.
+ * @param policy When to flush.
+ */
+void initOutput(Output *output, size_t capacity, FlushPolicy policy);
+
+/**
+ * Flush an output stream and free its buffer.
+ *
+ * @param output The output stream.
+ */
+void freeOutput(Output *output);
+
+/**
+ * Change the buffer size of an output stream. Whatever is buffered is flushed first.
+ *
+ * @param output The output stream.
+ * @param capacity Size of the buffer, 0 to write through.
+ */
+void resizeOutput(Output *output, size_t capacity);
+
+/**
+ * Send the buffered bytes of an output stream to its sink.
+ *
+ * @param output The output stream.
+ */
+void flushOutput(Output *output);
+
+/**
+ * Write bytes to an output stream.
+ *
+ * @param output The output stream.
+ * @param chars The bytes.
+ * @param length How many bytes.
+ */
+void writeOutput(Output *output, const char *chars, size_t length);
+
+/**
+ * Write formatted text to an output stream, like `printf`.
+ *
+ * @param output The output stream.
+ * @param format The format string.
+ */
+void writeFormatted(Output *output, const char *format, ...);
+
+/**
+ * Sink writing to a C stream and flushing it, so the stream adds no buffering of its own. The data is the `FILE *`.
+ */
+void streamSink(void *data, const char *chars, size_t length);
+
+/**
+ * Sink writing to a file descriptor. The data is the descriptor, cast with `(void *) (intptr_t) fd`.
+ */
+void fileDescriptorSink(void *data, const char *chars, size_t length);
+
+/**
+ * Sink appending to a `MemorySink`, which is the data.
+ */
+void memorySink(void *data, const char *chars, size_t length);
+
+/**
+ * Free what a `MemorySink` collected and empty it.
+ *
+ * @param sink The memory sink.
+ */
+void freeMemorySink(MemorySink *sink);
+
+#endif
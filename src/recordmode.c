@@ -0,0 +1,215 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "recordmode.h"
+#include "filelib.h"
+#include "memory.h"
+
+/**
+ * Most parameters `RECORD` can declare: the line, its fields and its number.
+ */
+#define RECORD_MAX_PARAMETERS 3
+
+/**
+ * Report an error of the record mode itself, outside of any call into the program.
+ *
+ * @param format Format string.
+ * @param ... The arguments.
+ */
+static void recordModeError(const char *format, ...) {
+    // What the program printed before the error comes before it.
+    flushOutput(&vm.output);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputs("\n", stderr);
+}
+
+/**
+ * Get a function the program defined as a global.
+ *
+ * @param name The name of the function.
+ * @param function Output parameter, the function.
+ * @return Whether the program defined the global.
+ */
+static bool findGlobal(const char *name, Value *function) {
+    ObjString *string = copyString(name, (int) strlen(name));
+    return tableGet(&vm.globals, string, function);
+}
+
+/**
+ * Call a function of the program that takes no arguments, if the program defined it.
+ *
+ * @param name The name of the function.
+ * @return Whether the call went fine.
+ */
+static bool callIfDefined(const char *name) {
+    Value function, result;
+    if (!findGlobal(name, &function))
+        return true;
+    return callFunction(function, 0, NULL, &result);
+}
+
+/**
+ * Split a line into fields and push the list of the fields on the stack.
+ *
+ * @param line The line.
+ * @param separator The character between the fields, 0 for runs of spaces and tabs, which also surround the fields.
+ */
+static void pushFields(ObjString *line, char separator) {
+    ObjList *fields = newList();
+    push(OBJ_VAL(fields));
+
+    const char *current = line->chars;
+    const char *end = line->chars + line->length;
+    for (;;) {
+        if (separator == 0) {
+            while (current < end && (*current == ' ' || *current == '\t')) current++;
+            if (current == end)
+                break;
+        }
+
+        const char *fieldEnd;
+        if (separator == 0) {
+            fieldEnd = current;
+            while (fieldEnd < end && *fieldEnd != ' ' && *fieldEnd != '\t') fieldEnd++;
+        } else {
+            fieldEnd = memchr(current, separator, end - current);
+            if (fieldEnd == NULL)
+                fieldEnd = end;
+        }
+
+        // Each field stays on the stack while the list grows.
+        push(OBJ_VAL(copyString(current, (int) (fieldEnd - current))));
+        appendToList(fields, vm.stackTop[-1]);
+        pop();
+
+        if (fieldEnd == end)
+            break;
+        current = fieldEnd + 1;
+    }
+}
+
+/**
+ * Call `RECORD` with each line of a file.
+ *
+ * @param record The `RECORD` function.
+ * @param arity How many parameters it declares.
+ * @param file The file, on the stack.
+ * @param fieldSeparator See `runRecordMode`.
+ * @param number How many records came before, counting previous files. Updated.
+ * @return Whether the file was read and the calls went fine.
+ */
+static bool processFile(Value record, int arity, ObjFile *file, char fieldSeparator, double *number) {
+    for (;;) {
+        Value line;
+        if (!nextRecord(file, '\n', true, &line))
+            return false;
+        if (IS_NIL(line))
+            return true;
+        (*number)++;
+
+        // The arguments go on the stack, which keeps them from garbage collection, until the call returns.
+        Value *args = vm.stackTop;
+        if (arity >= 1)
+            push(line);
+        if (arity >= 2)
+            pushFields(AS_STRING(line), fieldSeparator);
+        if (arity >= 3)
+            push(NUMBER_VAL(*number));
+
+        Value result;
+        if (!callFunction(record, arity, args, &result))
+            return false;
+        vm.stackTop = args;
+    }
+}
+
+/**
+ * Open one of the inputs and call `RECORD` with each of its lines.
+ *
+ * @return Whether it went fine.
+ */
+static bool processPath(Value record, int arity, const char *path, char fieldSeparator, double *number) {
+    int fd = 0;
+    if (strcmp(path, "-") != 0) {
+        do {
+            fd = open(path, O_RDONLY);
+        } while (fd < 0 && errno == EINTR);
+        if (fd < 0) {
+            recordModeError("Can't open file '%s': %s.", path, strerror(errno));
+            return false;
+        }
+    }
+
+    // The name is on the stack while the file object is made, then the file is.
+    push(OBJ_VAL(copyString(path, (int) strlen(path))));
+    ObjFile *file = newFile(AS_STRING(vm.stackTop[-1]), fd);
+    pop();
+    push(OBJ_VAL(file));
+    bool processed = processFile(record, arity, file, fieldSeparator, number);
+    if (!processed)
+        return false;
+
+    // The standard input stays open, it is not ours.
+    if (fd == 0)
+        file->fd = -1;
+    closeFile(file);
+    pop();
+    return true;
+}
+
+InterpretResult runRecordMode(const char *source, const char **paths, int pathCount, char fieldSeparator) {
+    InterpretResult result = interpret(source);
+    if (result != INTERPRET_OK)
+        return result;
+
+    Value record = NIL_VAL;
+    int arity = 0;
+    if (findGlobal("RECORD", &record)) {
+        if (!IS_CLOSURE(record)) {
+            recordModeError("RECORD must be a function.");
+            return INTERPRET_RUNTIME_ERROR;
+        }
+        arity = AS_CLOSURE(record)->function->arity;
+        if (arity > RECORD_MAX_PARAMETERS) {
+            recordModeError("RECORD can take the line, its fields and its number, but it has %d parameters.", arity);
+            return INTERPRET_RUNTIME_ERROR;
+        }
+    }
+
+    bool succeeded = callIfDefined("BEGIN");
+
+    // What BEGIN left behind lives on, the records are a run of their own.
+    if (vm.regionMode)
+        endRegion();
+
+    // Without RECORD there is no point in reading the input.
+    if (succeeded && !IS_NIL(record)) {
+        // RECORD sits on the stack for the whole run, the program could assign another function to the global.
+        push(record);
+        double number = 0;
+        if (pathCount == 0) {
+            succeeded = processPath(record, arity, "-", fieldSeparator, &number);
+        } else {
+            for (int i = 0; i < pathCount && succeeded; i++) {
+                succeeded = processPath(record, arity, paths[i], fieldSeparator, &number);
+            }
+        }
+        if (succeeded)
+            pop();
+    }
+
+    if (succeeded)
+        succeeded = callIfDefined("END");
+
+    if (vm.output.policy != FLUSH_EXPLICIT)
+        flushOutput(&vm.output);
+    return succeeded ? INTERPRET_OK : INTERPRET_RUNTIME_ERROR;
+}
@@ -0,0 +1,21 @@
+#ifndef NAMELESS_RECORDMODE_H
+#define NAMELESS_RECORDMODE_H
+
+#include "vm.h"
+
+/**
+ * Run a program over the records of some input, like awk. The program is interpreted once, to define its functions:
+ * - `BEGIN()`, if defined, is called before the input is read.
+ * - `RECORD(line, fields, number)` is called with each line of the input, its fields and its number, counting from 1.
+ * It may declare fewer parameters, the fields are only split when it asks for them.
+ * - `END()`, if defined, is called after the input is read.
+ *
+ * @param source The program.
+ * @param paths The files to read one after the other, "-" for the standard input.
+ * @param pathCount How many files. With none, the standard input is read.
+ * @param fieldSeparator The character between the fields, or 0 for fields separated by runs of spaces and tabs.
+ * @return The result.
+ */
+InterpretResult runRecordMode(const char *source, const char **paths, int pathCount, char fieldSeparator);
+
+#endif
@@ -0,0 +1,915 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "regex.h"
+
+/**
+ * Most instructions a compiled pattern can have. Counted repetitions copy their body, so this is what limits them.
+ */
+#define MAX_INSTRUCTIONS 10000
+
+/**
+ * Highest count allowed in `{n,m}`.
+ */
+#define MAX_REPEAT 1000
+
+/**
+ * How deeply groups can nest in one another.
+ */
+#define MAX_NESTING 64
+
+/**
+ * Instructions of the Pike VM. A thread runs at each position of the program the text so far can reach.
+ */
+typedef enum {
+    RE_CHAR,                // Match the character in `x`.
+    RE_ANY,                 // Match any character but a newline.
+    RE_CLASS,               // Match a character of the class at index `x`.
+    RE_MATCH,               // The pattern matched.
+    RE_JUMP,                // Continue at `x`.
+    RE_SPLIT,               // Continue at both `x` and `y`, `x` first.
+    RE_SAVE,                // Record the position in capture slot `x`.
+    RE_BEGIN,               // Only go on at the beginning of the text.
+    RE_END,                 // Only go on at the end of the text.
+    RE_WORD_BOUNDARY,       // Only go on between a word character and something else.
+    RE_NOT_WORD_BOUNDARY,   // Only go on where there is no word boundary.
+} RegexOp;
+
+typedef struct {
+    RegexOp op;
+    int x;
+    int y;
+} Instruction;
+
+/**
+ * A set of characters, one bit each.
+ */
+typedef struct {
+    uint8_t bits[32];
+} CharClass;
+
+/**
+ * A thread of the Pike VM: where it is in the program and what it captured on the way.
+ */
+typedef struct {
+    int pc;
+    int *captures;
+} Thread;
+
+/**
+ * The threads alive at one position of the text, in priority order.
+ */
+typedef struct {
+    int count;
+    Thread *threads;        // At most one per instruction.
+    int *captures;          // Capture slots of each thread.
+} ThreadList;
+
+/**
+ * Something to do while following the instructions that consume nothing: run from `pc`, or, if `pc` is negative, put
+ * back the old value of a capture slot.
+ */
+typedef struct {
+    int pc;
+    int slot;
+    int value;
+} PendingWork;
+
+struct Regex {
+    Instruction *code;
+    int codeSize;
+    CharClass *classes;
+    int classCount;
+    int groupCount;
+    int firstByte;          // Byte every match starts with, -1 if unknown. The search skips to it with memchr.
+    bool anchored;          // Whether the pattern starts with `^`, so it can only match at the beginning.
+
+    // Scratch space for matching, kept from one search to the next.
+    ThreadList lists[2];
+    unsigned int *marks;    // Generation in which each instruction was last added to a list.
+    unsigned int generation;
+    PendingWork *work;
+    int *captures;
+};
+
+typedef enum {
+    NODE_CHAR,
+    NODE_ANY,
+    NODE_CLASS,
+    NODE_BEGIN,
+    NODE_END,
+    NODE_WORD_BOUNDARY,
+    NODE_NOT_WORD_BOUNDARY,
+    NODE_EMPTY,
+    NODE_CONCAT,
+    NODE_ALTERNATE,
+    NODE_REPEAT,
+    NODE_GROUP,
+} NodeType;
+
+/**
+ * A node of the syntax tree of a pattern.
+ */
+typedef struct {
+    NodeType type;
+    int value;              // Character, class index or group number.
+    int left;               // First child: alternative, repeated node, group content or first node of a sequence.
+    int right;              // Second alternative.
+    int next;               // Next node in a sequence, -1 for the last.
+    int min;                // Repetition bounds, `max` is -1 when unbounded.
+    int max;
+    bool greedy;
+} Node;
+
+typedef struct {
+    const char *current;
+    const char *end;
+    Node *nodes;
+    int nodeCount;
+    int nodeCapacity;
+    CharClass *classes;
+    int classCount;
+    int classCapacity;
+    int groupCount;
+    int depth;
+    const char *error;
+
+    Instruction *code;
+    int codeSize;
+    int codeCapacity;
+} RegexCompiler;
+
+/**
+ * Grow an array allocated with malloc. Running out of memory ends the program, like `reallocate`.
+ */
+static void *growArray(void *array, int *capacity, size_t itemSize) {
+    *capacity = *capacity < 8 ? 8 : *capacity * 2;
+    void *grown = realloc(array, itemSize * *capacity);
+    if (grown == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    return grown;
+}
+
+static int addNode(RegexCompiler *compiler, NodeType type) {
+    if (compiler->nodeCount == compiler->nodeCapacity)
+        compiler->nodes = growArray(compiler->nodes, &compiler->nodeCapacity, sizeof(Node));
+
+    Node *node = &compiler->nodes[compiler->nodeCount];
+    node->type = type;
+    node->value = 0;
+    node->left = -1;
+    node->right = -1;
+    node->next = -1;
+    node->min = 0;
+    node->max = 0;
+    node->greedy = true;
+    return compiler->nodeCount++;
+}
+
+static int addClass(RegexCompiler *compiler) {
+    if (compiler->classCount == compiler->classCapacity)
+        compiler->classes = growArray(compiler->classes, &compiler->classCapacity, sizeof(CharClass));
+    memset(&compiler->classes[compiler->classCount], 0, sizeof(CharClass));
+    return compiler->classCount++;
+}
+
+static int fail(RegexCompiler *compiler, const char *message) {
+    if (compiler->error == NULL)
+        compiler->error = message;
+    return -1;
+}
+
+static inline void addToClass(CharClass *class, int c) {
+    class->bits[c >> 3] |= (uint8_t) (1 << (c & 7));
+}
+
+static inline bool inClass(const CharClass *class, uint8_t c) {
+    return (class->bits[c >> 3] >> (c & 7)) & 1;
+}
+
+static inline bool isWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/**
+ * Add the characters of a class escape such as `\d` to a class.
+ *
+ * @param class The class.
+ * @param escape The letter after the backslash.
+ * @return Whether the letter names a class.
+ */
+static bool addClassEscape(CharClass *class, char escape) {
+    CharClass named;
+    memset(&named, 0, sizeof(named));
+    switch (escape) {
+        case 'd':
+        case 'D':
+            for (int c = '0'; c <= '9'; c++) addToClass(&named, c);
+            break;
+        case 'w':
+        case 'W':
+            for (int c = 0; c < 256; c++) {
+                if (isWordChar((char) c)) addToClass(&named, c);
+            }
+            break;
+        case 's':
+        case 'S':
+            addToClass(&named, ' ');
+            for (int c = '\t'; c <= '\r'; c++) addToClass(&named, c);
+            break;
+        default:
+            return false;
+    }
+
+    // Upper case is the complement.
+    bool negate = escape >= 'A' && escape <= 'Z';
+    for (int i = 0; i < 32; i++) {
+        class->bits[i] |= negate ? (uint8_t) ~named.bits[i] : named.bits[i];
+    }
+    return true;
+}
+
+/**
+ * Turn the letter of a character escape, like the `n` of `\n`, into the character.
+ *
+ * @return The character, -1 if the escape is not valid.
+ */
+static int escapedChar(char escape) {
+    switch (escape) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0': return '\0';
+        default:
+            // Letters and digits are reserved for escapes with a meaning, anything else stands for itself.
+            if ((escape >= 'a' && escape <= 'z') || (escape >= 'A' && escape <= 'Z') || (escape >= '0' && escape <= '9'))
+                return -1;
+            return (uint8_t) escape;
+    }
+}
+
+static int parseAlternation(RegexCompiler *compiler);
+
+/**
+ * Parse a class like `[a-z_]`, after the `[`.
+ */
+static int parseClass(RegexCompiler *compiler) {
+    int index = addClass(compiler);
+    CharClass class;
+    memset(&class, 0, sizeof(class));
+
+    bool negate = compiler->current < compiler->end && *compiler->current == '^';
+    if (negate)
+        compiler->current++;
+
+    bool first = true;
+    while (compiler->current < compiler->end && (*compiler->current != ']' || first)) {
+        first = false;
+        int low = (uint8_t) *compiler->current++;
+        if (low == '\\') {
+            if (compiler->current == compiler->end)
+                return fail(compiler, "Trailing backslash.");
+            char escape = *compiler->current++;
+            if (addClassEscape(&class, escape))
+                continue;
+            if ((low = escapedChar(escape)) < 0)
+                return fail(compiler, "Unknown escape.");
+        }
+
+        int high = low;
+        if (compiler->end - compiler->current >= 2 && compiler->current[0] == '-' && compiler->current[1] != ']') {
+            compiler->current++;
+            high = (uint8_t) *compiler->current++;
+            if (high == '\\') {
+                if (compiler->current == compiler->end)
+                    return fail(compiler, "Trailing backslash.");
+                if ((high = escapedChar(*compiler->current++)) < 0)
+                    return fail(compiler, "Invalid range in class.");
+            }
+            if (high < low)
+                return fail(compiler, "Invalid range in class.");
+        }
+        for (int c = low; c <= high; c++) {
+            addToClass(&class, c);
+        }
+    }
+    if (compiler->current == compiler->end)
+        return fail(compiler, "Unterminated class.");
+    compiler->current++;
+
+    for (int i = 0; i < 32; i++) {
+        compiler->classes[index].bits[i] = negate ? (uint8_t) ~class.bits[i] : class.bits[i];
+    }
+    int node = addNode(compiler, NODE_CLASS);
+    compiler->nodes[node].value = index;
+    return node;
+}
+
+/**
+ * Parse an escape outside a class, after the backslash.
+ */
+static int parseEscape(RegexCompiler *compiler) {
+    if (compiler->current == compiler->end)
+        return fail(compiler, "Trailing backslash.");
+    char escape = *compiler->current++;
+
+    if (escape == 'b')
+        return addNode(compiler, NODE_WORD_BOUNDARY);
+    if (escape == 'B')
+        return addNode(compiler, NODE_NOT_WORD_BOUNDARY);
+
+    CharClass class;
+    memset(&class, 0, sizeof(class));
+    if (addClassEscape(&class, escape)) {
+        int index = addClass(compiler);
+        compiler->classes[index] = class;
+        int node = addNode(compiler, NODE_CLASS);
+        compiler->nodes[node].value = index;
+        return node;
+    }
+
+    int c = escapedChar(escape);
+    if (c < 0)
+        return fail(compiler, "Unknown escape.");
+    int node = addNode(compiler, NODE_CHAR);
+    compiler->nodes[node].value = c;
+    return node;
+}
+
+/**
+ * Parse a group, after the `(`.
+ */
+static int parseGroup(RegexCompiler *compiler) {
+    if (++compiler->depth > MAX_NESTING)
+        return fail(compiler, "Groups nest too deeply.");
+
+    bool capturing = true;
+    if (compiler->end - compiler->current >= 2 && compiler->current[0] == '?' && compiler->current[1] == ':') {
+        capturing = false;
+        compiler->current += 2;
+    }
+
+    int group = 0;
+    if (capturing) {
+        if (compiler->groupCount == REGEX_MAX_GROUPS)
+            return fail(compiler, "Too many groups.");
+        group = ++compiler->groupCount;
+    }
+
+    int content = parseAlternation(compiler);
+    if (content < 0)
+        return -1;
+    if (compiler->current == compiler->end || *compiler->current != ')')
+        return fail(compiler, "Expect ')' after group.");
+    compiler->current++;
+    compiler->depth--;
+
+    if (!capturing)
+        return content;
+    int node = addNode(compiler, NODE_GROUP);
+    compiler->nodes[node].value = group;
+    compiler->nodes[node].left = content;
+    return node;
+}
+
+static int parseAtom(RegexCompiler *compiler) {
+    char c = *compiler->current++;
+    int node;
+    switch (c) {
+        case '(':
+            return parseGroup(compiler);
+        case '[':
+            return parseClass(compiler);
+        case '.':
+            return addNode(compiler, NODE_ANY);
+        case '^':
+            return addNode(compiler, NODE_BEGIN);
+        case '$':
+            return addNode(compiler, NODE_END);
+        case '\\':
+            return parseEscape(compiler);
+        case '*':
+        case '+':
+        case '?':
+            return fail(compiler, "Nothing to repeat.");
+        default:
+            node = addNode(compiler, NODE_CHAR);
+            compiler->nodes[node].value = (uint8_t) c;
+            return node;
+    }
+}
+
+/**
+ * Read a number in a counted repetition.
+ *
+ * @return The number, -1 if there are no digits.
+ */
+static int parseCount(RegexCompiler *compiler) {
+    if (compiler->current == compiler->end || *compiler->current < '0' || *compiler->current > '9')
+        return -1;
+
+    int count = 0;
+    while (compiler->current < compiler->end && *compiler->current >= '0' && *compiler->current <= '9') {
+        if (count <= MAX_REPEAT)
+            count = count * 10 + (*compiler->current - '0');
+        compiler->current++;
+    }
+    return count;
+}
+
+/**
+ * Parse a quantifier, if there is one.
+ *
+ * @param min Output parameter, the fewest repetitions.
+ * @param max Output parameter, the most repetitions, -1 when unbounded.
+ * @return Whether there was a quantifier. A `{` that does not start `{n}`, `{n,}` or `{n,m}` is a plain character.
+ */
+static bool parseQuantifier(RegexCompiler *compiler, int *min, int *max) {
+    switch (*compiler->current) {
+        case '*':
+            compiler->current++;
+            *min = 0;
+            *max = -1;
+            return true;
+        case '+':
+            compiler->current++;
+            *min = 1;
+            *max = -1;
+            return true;
+        case '?':
+            compiler->current++;
+            *min = 0;
+            *max = 1;
+            return true;
+        case '{': {
+            const char *start = compiler->current++;
+            *min = parseCount(compiler);
+            *max = *min;
+            if (*min >= 0 && compiler->current < compiler->end && *compiler->current == ',') {
+                compiler->current++;
+                *max = parseCount(compiler);
+            }
+            if (*min < 0 || compiler->current == compiler->end || *compiler->current != '}') {
+                compiler->current = start;
+                return false;
+            }
+            compiler->current++;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static int parseRepeat(RegexCompiler *compiler) {
+    int node = parseAtom(compiler);
+    int min, max;
+    while (node >= 0 && compiler->current < compiler->end && parseQuantifier(compiler, &min, &max)) {
+        if (min > MAX_REPEAT || max > MAX_REPEAT)
+            return fail(compiler, "Repetition count too big.");
+        if (max >= 0 && max < min)
+            return fail(compiler, "Invalid repetition count.");
+
+        int repeat = addNode(compiler, NODE_REPEAT);
+        compiler->nodes[repeat].left = node;
+        compiler->nodes[repeat].min = min;
+        compiler->nodes[repeat].max = max;
+        if (compiler->current < compiler->end && *compiler->current == '?') {
+            compiler->current++;
+            compiler->nodes[repeat].greedy = false;
+        }
+        node = repeat;
+    }
+    return node;
+}
+
+static int parseConcatenation(RegexCompiler *compiler) {
+    int sequence = addNode(compiler, NODE_CONCAT);
+    int last = -1;
+    while (compiler->current < compiler->end && *compiler->current != '|' && *compiler->current != ')') {
+        int node = parseRepeat(compiler);
+        if (node < 0)
+            return -1;
+        if (last < 0) {
+            compiler->nodes[sequence].left = node;
+        } else {
+            compiler->nodes[last].next = node;
+        }
+        last = node;
+    }
+    return sequence;
+}
+
+static int parseAlternation(RegexCompiler *compiler) {
+    int node = parseConcatenation(compiler);
+    while (node >= 0 && compiler->current < compiler->end && *compiler->current == '|') {
+        compiler->current++;
+        int right = parseConcatenation(compiler);
+        if (right < 0)
+            return -1;
+        int alternation = addNode(compiler, NODE_ALTERNATE);
+        compiler->nodes[alternation].left = node;
+        compiler->nodes[alternation].right = right;
+        node = alternation;
+    }
+    return node;
+}
+
+static int emit(RegexCompiler *compiler, RegexOp op, int x, int y) {
+    if (compiler->codeSize == MAX_INSTRUCTIONS) {
+        fail(compiler, "Pattern is too big.");
+        // Keep writing over the last instruction, the program is thrown away anyway.
+        compiler->codeSize--;
+    }
+    if (compiler->codeSize == compiler->codeCapacity)
+        compiler->code = growArray(compiler->code, &compiler->codeCapacity, sizeof(Instruction));
+
+    compiler->code[compiler->codeSize].op = op;
+    compiler->code[compiler->codeSize].x = x;
+    compiler->code[compiler->codeSize].y = y;
+    return compiler->codeSize++;
+}
+
+static void emitNode(RegexCompiler *compiler, int index) {
+    if (compiler->error != NULL)
+        return;
+
+    Node node = compiler->nodes[index];
+    switch (node.type) {
+        case NODE_CHAR:
+            emit(compiler, RE_CHAR, node.value, 0);
+            break;
+        case NODE_ANY:
+            emit(compiler, RE_ANY, 0, 0);
+            break;
+        case NODE_CLASS:
+            emit(compiler, RE_CLASS, node.value, 0);
+            break;
+        case NODE_BEGIN:
+            emit(compiler, RE_BEGIN, 0, 0);
+            break;
+        case NODE_END:
+            emit(compiler, RE_END, 0, 0);
+            break;
+        case NODE_WORD_BOUNDARY:
+            emit(compiler, RE_WORD_BOUNDARY, 0, 0);
+            break;
+        case NODE_NOT_WORD_BOUNDARY:
+            emit(compiler, RE_NOT_WORD_BOUNDARY, 0, 0);
+            break;
+        case NODE_EMPTY:
+            break;
+        case NODE_CONCAT:
+            for (int child = node.left; child >= 0; child = compiler->nodes[child].next) {
+                emitNode(compiler, child);
+            }
+            break;
+        case NODE_ALTERNATE: {
+            int split = emit(compiler, RE_SPLIT, 0, 0);
+            compiler->code[split].x = compiler->codeSize;
+            emitNode(compiler, node.left);
+            int jump = emit(compiler, RE_JUMP, 0, 0);
+            compiler->code[split].y = compiler->codeSize;
+            emitNode(compiler, node.right);
+            compiler->code[jump].x = compiler->codeSize;
+            break;
+        }
+        case NODE_GROUP:
+            emit(compiler, RE_SAVE, node.value * 2, 0);
+            emitNode(compiler, node.left);
+            emit(compiler, RE_SAVE, node.value * 2 + 1, 0);
+            break;
+        case NODE_REPEAT: {
+            for (int i = 0; i < node.min; i++) {
+                emitNode(compiler, node.left);
+            }
+
+            if (node.max < 0) {
+                // Loop: try the body again, or leave.
+                int split = emit(compiler, RE_SPLIT, 0, 0);
+                emitNode(compiler, node.left);
+                emit(compiler, RE_JUMP, split, 0);
+                int body = split + 1;
+                int out = compiler->codeSize;
+                compiler->code[split].x = node.greedy ? body : out;
+                compiler->code[split].y = node.greedy ? out : body;
+                break;
+            }
+
+            // Optional copies, each inside the previous one: a split skips all that are left.
+            int optional = node.max - node.min;
+            int *splits = malloc(sizeof(int) * (optional > 0 ? optional : 1));
+            if (splits == NULL) {
+                fprintf(stderr, "Out of memory.\n");
+                exit(1);
+            }
+            for (int i = 0; i < optional && compiler->error == NULL; i++) {
+                splits[i] = emit(compiler, RE_SPLIT, 0, 0);
+                emitNode(compiler, node.left);
+            }
+            int out = compiler->codeSize;
+            for (int i = 0; i < optional && compiler->error == NULL; i++) {
+                int body = splits[i] + 1;
+                compiler->code[splits[i]].x = node.greedy ? body : out;
+                compiler->code[splits[i]].y = node.greedy ? out : body;
+            }
+            free(splits);
+            break;
+        }
+    }
+}
+
+Regex *compileRegex(const char *pattern, int length, const char **error) {
+    RegexCompiler compiler;
+    memset(&compiler, 0, sizeof(compiler));
+    compiler.current = pattern;
+    compiler.end = pattern + length;
+
+    int root = parseAlternation(&compiler);
+    if (root >= 0 && compiler.current < compiler.end)
+        fail(&compiler, "Unmatched ')'.");
+
+    if (compiler.error == NULL) {
+        // The whole match is group 0.
+        emit(&compiler, RE_SAVE, 0, 0);
+        emitNode(&compiler, root);
+        emit(&compiler, RE_SAVE, 1, 0);
+        emit(&compiler, RE_MATCH, 0, 0);
+    }
+    free(compiler.nodes);
+
+    if (compiler.error != NULL) {
+        *error = compiler.error;
+        free(compiler.classes);
+        free(compiler.code);
+        return NULL;
+    }
+
+    Regex *regex = calloc(1, sizeof(Regex));
+    if (regex == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    regex->code = compiler.code;
+    regex->codeSize = compiler.codeSize;
+    regex->classes = compiler.classes;
+    regex->classCount = compiler.classCount;
+    regex->groupCount = compiler.groupCount;
+    regex->firstByte = compiler.code[1].op == RE_CHAR ? compiler.code[1].x : -1;
+    regex->anchored = compiler.code[1].op == RE_BEGIN;
+    return regex;
+}
+
+void freeRegex(Regex *regex) {
+    free(regex->code);
+    free(regex->classes);
+    free(regex->lists[0].threads);
+    free(regex->lists[0].captures);
+    free(regex->lists[1].threads);
+    free(regex->lists[1].captures);
+    free(regex->marks);
+    free(regex->work);
+    free(regex->captures);
+    free(regex);
+}
+
+int regexGroupCount(Regex *regex) {
+    return regex->groupCount;
+}
+
+/**
+ * Allocate the scratch space of a pattern the first time it is searched.
+ */
+static void prepareSearch(Regex *regex) {
+    if (regex->marks != NULL)
+        return;
+
+    int slots = 2 * (regex->groupCount + 1);
+    for (int i = 0; i < 2; i++) {
+        regex->lists[i].threads = malloc(sizeof(Thread) * regex->codeSize);
+        regex->lists[i].captures = malloc(sizeof(int) * regex->codeSize * slots);
+    }
+    regex->marks = calloc(regex->codeSize, sizeof(unsigned int));
+    // Each instruction adds at most one piece of work, plus the first one.
+    regex->work = malloc(sizeof(PendingWork) * (regex->codeSize + 1));
+    regex->captures = malloc(sizeof(int) * slots);
+    if (regex->lists[0].threads == NULL || regex->lists[0].captures == NULL || regex->lists[1].threads == NULL ||
+        regex->lists[1].captures == NULL || regex->marks == NULL || regex->work == NULL || regex->captures == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+}
+
+/**
+ * Start a new list of threads: instructions added to the previous lists may be added again.
+ */
+static void nextGeneration(Regex *regex) {
+    if (++regex->generation == 0) {
+        memset(regex->marks, 0, sizeof(unsigned int) * regex->codeSize);
+        regex->generation = 1;
+    }
+}
+
+/**
+ * Add a thread to a list, following the instructions that do not consume a character right away, so that the list only
+ * holds threads waiting for a character or a match.
+ *
+ * @param regex The pattern.
+ * @param list The list.
+ * @param pc Where the thread is.
+ * @param captures Its capture slots. Changed along the way, but put back as they were.
+ * @param text The text.
+ * @param length The length of the text.
+ * @param sp The position in the text.
+ */
+static void addThread(Regex *regex, ThreadList *list, int pc, int *captures, const char *text, int length, int sp) {
+    int slots = 2 * (regex->groupCount + 1);
+    PendingWork *work = regex->work;
+    int workCount = 0;
+    work[workCount++] = (PendingWork) {pc, 0, 0};
+
+    while (workCount > 0) {
+        PendingWork next = work[--workCount];
+        if (next.pc < 0) {
+            captures[next.slot] = next.value;
+            continue;
+        }
+
+        pc = next.pc;
+        for (;;) {
+            if (regex->marks[pc] == regex->generation)
+                break;
+            regex->marks[pc] = regex->generation;
+
+            Instruction *instruction = &regex->code[pc];
+            bool before, after;
+            switch (instruction->op) {
+                case RE_JUMP:
+                    pc = instruction->x;
+                    continue;
+                case RE_SPLIT:
+                    // The second branch waits until the first was followed all the way.
+                    work[workCount++] = (PendingWork) {instruction->y, 0, 0};
+                    pc = instruction->x;
+                    continue;
+                case RE_SAVE:
+                    work[workCount++] = (PendingWork) {-1, instruction->x, captures[instruction->x]};
+                    captures[instruction->x] = sp;
+                    pc++;
+                    continue;
+                case RE_BEGIN:
+                    if (sp != 0)
+                        break;
+                    pc++;
+                    continue;
+                case RE_END:
+                    if (sp != length)
+                        break;
+                    pc++;
+                    continue;
+                case RE_WORD_BOUNDARY:
+                case RE_NOT_WORD_BOUNDARY:
+                    before = sp > 0 && isWordChar(text[sp - 1]);
+                    after = sp < length && isWordChar(text[sp]);
+                    if ((before != after) != (instruction->op == RE_WORD_BOUNDARY))
+                        break;
+                    pc++;
+                    continue;
+                default: {
+                    Thread *thread = &list->threads[list->count];
+                    thread->pc = pc;
+                    thread->captures = list->captures + list->count * slots;
+                    memcpy(thread->captures, captures, sizeof(int) * slots);
+                    list->count++;
+                    break;
+                }
+            }
+            break;
+        }
+    }
+}
+
+bool searchRegex(Regex *regex, const char *text, int length, int start, int *captures) {
+    prepareSearch(regex);
+    int slots = 2 * (regex->groupCount + 1);
+    ThreadList *current = &regex->lists[0];
+    ThreadList *next = &regex->lists[1];
+    current->count = 0;
+    bool matched = false;
+    nextGeneration(regex);
+
+    for (int sp = start; sp <= length; sp++) {
+        if (!matched) {
+            if (current->count == 0) {
+                // Nothing going on: skip right to where a match can start.
+                if (regex->anchored && sp > 0)
+                    break;
+                if (regex->firstByte >= 0) {
+                    const char *found = memchr(text + sp, regex->firstByte, length - sp);
+                    if (found == NULL)
+                        break;
+                    sp = (int) (found - text);
+                }
+            }
+            // A match starting here comes after the ones that started earlier.
+            for (int i = 0; i < slots; i++) {
+                regex->captures[i] = -1;
+            }
+            addThread(regex, current, 0, regex->captures, text, length, sp);
+        }
+        if (current->count == 0) {
+            // A match that started earlier is over, or none can start here: try the next position.
+            if (matched)
+                break;
+            nextGeneration(regex);
+            continue;
+        }
+
+        nextGeneration(regex);
+        next->count = 0;
+        for (int i = 0; i < current->count; i++) {
+            Thread *thread = &current->threads[i];
+            Instruction *instruction = &regex->code[thread->pc];
+            bool consumed = false;
+            switch (instruction->op) {
+                case RE_CHAR:
+                    consumed = sp < length && (uint8_t) text[sp] == instruction->x;
+                    break;
+                case RE_ANY:
+                    consumed = sp < length && text[sp] != '\n';
+                    break;
+                case RE_CLASS:
+                    consumed = sp < length && inClass(&regex->classes[instruction->x], (uint8_t) text[sp]);
+                    break;
+                case RE_MATCH:
+                    memcpy(captures, thread->captures, sizeof(int) * slots);
+                    matched = true;
+                    break;
+                default:
+                    break;
+            }
+            if (consumed)
+                addThread(regex, next, thread->pc + 1, thread->captures, text, length, sp + 1);
+            // Threads after a match have lower priority, they can't change the result.
+            if (instruction->op == RE_MATCH)
+                break;
+        }
+
+        ThreadList *swap = current;
+        current = next;
+        next = swap;
+    }
+    return matched;
+}
+
+void initRegexCache(RegexCache *cache) {
+    for (int i = 0; i < REGEX_CACHE_SIZE; i++) {
+        cache->entries[i].pattern = NULL;
+        cache->entries[i].regex = NULL;
+    }
+}
+
+void freeRegexCache(RegexCache *cache) {
+    for (int i = 0; i < REGEX_CACHE_SIZE; i++) {
+        RegexCacheEntry *entry = &cache->entries[i];
+        if (entry->pattern == NULL)
+            continue;
+        free(entry->pattern);
+        freeRegex(entry->regex);
+        entry->pattern = NULL;
+        entry->regex = NULL;
+    }
+}
+
+Regex *cachedRegex(RegexCache *cache, const char *pattern, int length, uint32_t hash, const char **error) {
+    RegexCacheEntry *entry = &cache->entries[hash % REGEX_CACHE_SIZE];
+    if (entry->pattern != NULL && entry->hash == hash && entry->length == length &&
+        memcmp(entry->pattern, pattern, length) == 0)
+        return entry->regex;
+
+    Regex *regex = compileRegex(pattern, length, error);
+    if (regex == NULL)
+        return NULL;
+
+    char *copy = malloc(length > 0 ? length : 1);
+    if (copy == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    memcpy(copy, pattern, length);
+
+    if (entry->pattern != NULL) {
+        free(entry->pattern);
+        freeRegex(entry->regex);
+    }
+    entry->pattern = copy;
+    entry->length = length;
+    entry->hash = hash;
+    entry->regex = regex;
+    return regex;
+}
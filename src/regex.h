@@ -0,0 +1,109 @@
+#ifndef NAMELESS_REGEX_H
+#define NAMELESS_REGEX_H
+
+#include "common.h"
+
+/**
+ * How many compiled patterns the cache keeps.
+ */
+#define REGEX_CACHE_SIZE 64
+
+/**
+ * Most capturing groups a pattern can have.
+ */
+#define REGEX_MAX_GROUPS 32
+
+/**
+ * A compiled pattern: a program for a Pike VM, which runs every possible match at once so matching takes time linear
+ * in the length of the text, whatever the pattern.
+ *
+ * Supported syntax: literals, `.`, classes like `[a-z_]` and `[^0-9]`, the escapes `\d \w \s \D \W \S \b \B \n \t \r`,
+ * anchors `^` and `$`, groups `(...)` and `(?:...)`, alternation `|`, and the quantifiers `* + ? {n} {n,} {n,m}`, all of
+ * which may be followed by `?` to match as little as possible.
+ */
+typedef struct Regex Regex;
+
+/**
+ * One compiled pattern in the cache, with a copy of its text.
+ */
+typedef struct {
+    char *pattern;          // The pattern, NULL if the entry is free.
+    int length;             // Length of the pattern.
+    uint32_t hash;          // Hash of the pattern, the same as its string's.
+    Regex *regex;           // The compiled pattern.
+} RegexCacheEntry;
+
+/**
+ * Compiled patterns by pattern text, so a pattern used in a loop is only compiled once. Direct mapped: a pattern takes
+ * the place of the one with the same slot.
+ */
+typedef struct {
+    RegexCacheEntry entries[REGEX_CACHE_SIZE];
+} RegexCache;
+
+/**
+ * Compile a pattern.
+ *
+ * @param pattern The pattern.
+ * @param length The length of the pattern.
+ * @param error Output parameter, what is wrong with the pattern when it can't be compiled.
+ * @return The compiled pattern, NULL if the pattern is not valid.
+ */
+Regex *compileRegex(const char *pattern, int length, const char **error);
+
+/**
+ * Free a compiled pattern.
+ *
+ * @param regex The compiled pattern.
+ */
+void freeRegex(Regex *regex);
+
+/**
+ * @param regex A compiled pattern.
+ * @return How many capturing groups the pattern has.
+ */
+int regexGroupCount(Regex *regex);
+
+/**
+ * Find the leftmost match of a pattern in a text. Among the matches starting there, the one a backtracking engine
+ * would find first wins, as far as where the match ends goes. Groups may differ inside a repetition that can match
+ * nothing: an iteration matching the empty string is never taken, so in `(a*)*` against "b", group 1 did not take part
+ * (-1, -1) where a backtracking engine has it match the empty string (0, 0).
+ *
+ * @param regex The compiled pattern.
+ * @param text The text.
+ * @param length The length of the text.
+ * @param start Where to start looking.
+ * @param captures Output parameter, where the match (pair 0) and each group (pairs 1 onwards) start and end, -1 for
+ * groups that did not take part in the match. Room for 2 * (group count + 1) integers.
+ * @return Whether the pattern matched.
+ */
+bool searchRegex(Regex *regex, const char *text, int length, int start, int *captures);
+
+/**
+ * Initialize an empty cache of compiled patterns.
+ *
+ * @param cache The cache.
+ */
+void initRegexCache(RegexCache *cache);
+
+/**
+ * Free a cache of compiled patterns, and the patterns.
+ *
+ * @param cache The cache.
+ */
+void freeRegexCache(RegexCache *cache);
+
+/**
+ * Get the compiled version of a pattern from a cache, compiling it if it is not there.
+ *
+ * @param cache The cache.
+ * @param pattern The pattern.
+ * @param length The length of the pattern.
+ * @param hash The hash of the pattern.
+ * @param error Output parameter, what is wrong with the pattern when it can't be compiled.
+ * @return The compiled pattern, NULL if the pattern is not valid.
+ */
+Regex *cachedRegex(RegexCache *cache, const char *pattern, int length, uint32_t hash, const char **error);
+
+#endif
@@ -3,10 +3,17 @@
 #include "common.h"
 #include "scanner.h"
 
+/**
+ * How many string interpolations can be nested in one another.
+ */
+#define MAX_INTERPOLATION_DEPTH 8
+
 typedef struct {
     const char *start;      // Beginning of current lexeme.
     const char *current;    // Current character.
     int line;
+    int interpolationDepth; // How many `${` are open.
+    int braces[MAX_INTERPOLATION_DEPTH]; // For each open `${`, how many `{` are open inside it.
 } Scanner;
 
 Scanner scanner;
@@ -15,6 +22,7 @@ void initScanner(const char *source) {
     scanner.start = source;
     scanner.current = source;
     scanner.line = 1;
+    scanner.interpolationDepth = 0;
 }
 
 // TODO: macro???
@@ -123,9 +131,25 @@ static TokenType identifierType() {
         case 'a':
             return checkKeyword(1, 2, "nd", TOKEN_AND);
         case 'c':
-            return checkKeyword(1, 4, "lass", TOKEN_CLASS);
+            if (scanner.current - scanner.start > 1) {
+                switch (scanner.start[1]) {
+                    case 'l':
+                        return checkKeyword(2, 3, "ass", TOKEN_CLASS);
+                    case 'o':
+                        return checkKeyword(2, 3, "nst", TOKEN_CONST);
+                }
+            }
+            break;
         case 'e':
-            return checkKeyword(1, 3, "lse", TOKEN_ELSE);
+            if (scanner.current - scanner.start > 1) {
+                switch (scanner.start[1]) {
+                    case 'l':
+                        return checkKeyword(2, 2, "se", TOKEN_ELSE);
+                    case 'n':
+                        return checkKeyword(2, 2, "um", TOKEN_ENUM);
+                }
+            }
+            break;
         case 'i':
             return checkKeyword(1, 1, "f", TOKEN_IF);
         case 'n':
@@ -135,9 +159,25 @@ static TokenType identifierType() {
         case 'p':
             return checkKeyword(1, 4, "rint", TOKEN_PRINT);
         case 'r':
-            return checkKeyword(1, 5, "eturn", TOKEN_RETURN);
+            if (scanner.current - scanner.start > 2 && scanner.start[1] == 'e') {
+                switch (scanner.start[2]) {
+                    case 'c':
+                        return checkKeyword(3, 3, "ord", TOKEN_RECORD);
+                    case 't':
+                        return checkKeyword(3, 3, "urn", TOKEN_RETURN);
+                }
+            }
+            break;
         case 's':
-            return checkKeyword(1, 4, "uper", TOKEN_SUPER);
+            if (scanner.current - scanner.start > 1) {
+                switch (scanner.start[1]) {
+                    case 'e':
+                        return checkKeyword(2, 4, "aled", TOKEN_SEALED);
+                    case 'u':
+                        return checkKeyword(2, 3, "per", TOKEN_SUPER);
+                }
+            }
+            break;
         case 'v':
             return checkKeyword(1, 2, "ar", TOKEN_VAR);
         case 'w':
@@ -185,13 +225,45 @@ static Token number() {
         while (isDigit(peek())) advance();
     }
 
+    // Look for an exponent, the way numbers are printed when very big or very small.
+    if ((peek() == 'e' || peek() == 'E')
+        && (isDigit(peekNext()) || ((peekNext() == '+' || peekNext() == '-') && isDigit(scanner.current[2])))) {
+        // Consume the "e" and the sign.
+        advance();
+        if (peek() == '+' || peek() == '-') advance();
+
+        while (isDigit(peek())) advance();
+    }
+
     return makeToken(TOKEN_NUMBER);
 }
 
+/**
+ * Scan the rest of a string, or of the literal part of an interpolated string. A `${` ends the part, the expression
+ * that follows is scanned as usual, and the `}` closing it resumes the string. A `\${` does not.
+ *
+ * @return TOKEN_STRING when the string ends, TOKEN_INTERPOLATION when a `${` comes first.
+ */
 static Token string() {
     // Parse string, remember they are like Python raw multiline strings by default.
     while (peek() != '"' && !isAtEnd()) {
         if (peek() == '\n') scanner.line++;
+        // `\${` stands for `${` itself, the compiler takes the backslash out.
+        if (peek() == '\\' && peekNext() == '$' && scanner.current[2] == '{') {
+            advance();
+            advance();
+            advance();
+            continue;
+        }
+        if (peek() == '$' && peekNext() == '{') {
+            if (scanner.interpolationDepth == MAX_INTERPOLATION_DEPTH)
+                return errorToken("Interpolation nested too deeply.");
+
+            advance();
+            advance();
+            scanner.braces[scanner.interpolationDepth++] = 0;
+            return makeToken(TOKEN_INTERPOLATION);
+        }
         advance();
     }
 
@@ -218,11 +290,27 @@ Token scanToken() {
         case ')':
             return makeToken(TOKEN_RIGHT_PAREN);
         case '{':
+            if (scanner.interpolationDepth > 0)
+                scanner.braces[scanner.interpolationDepth - 1]++;
             return makeToken(TOKEN_LEFT_BRACE);
         case '}':
+            if (scanner.interpolationDepth > 0) {
+                // Closing the `${`: back to the string.
+                if (scanner.braces[scanner.interpolationDepth - 1] == 0) {
+                    scanner.interpolationDepth--;
+                    return string();
+                }
+                scanner.braces[scanner.interpolationDepth - 1]--;
+            }
             return makeToken(TOKEN_RIGHT_BRACE);
+        case '[':
+            return makeToken(TOKEN_LEFT_BRACKET);
+        case ']':
+            return makeToken(TOKEN_RIGHT_BRACKET);
         case ';':
             return makeToken(TOKEN_SEMICOLON);
+        case ':':
+            return makeToken(TOKEN_COLON);
         case ',':
             return makeToken(TOKEN_COMMA);
         case '.':
@@ -249,3 +337,10 @@ Token scanToken() {
 
     return errorToken("Unexpected character.");
 }
+
+Token peekToken() {
+    Scanner saved = scanner;
+    Token token = scanToken();
+    scanner = saved;
+    return token;
+}
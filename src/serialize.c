@@ -0,0 +1,633 @@
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "serialize.h"
+#include "memory.h"
+#include "vm.h"
+
+/**
+ * What comes before the version at the start of serialized data.
+ */
+#define MAGIC "NL"
+#define MAGIC_LENGTH 2
+
+/**
+ * The first byte of each value, telling what follows. Counts, lengths and references are unsigned varints: seven bits
+ * per byte, lowest first, the high bit set on all bytes but the last.
+ */
+typedef enum {
+    TAG_NIL,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_INTEGER,        // A whole number, as a zigzag varint, so small negative numbers stay short too.
+    TAG_NUMBER,         // Any other number, as the 8 bytes of the double, lowest first.
+    TAG_STRING,         // The length, then the bytes.
+    TAG_LIST,           // The count, then the items.
+    TAG_MAP,            // The count, then each key, a string, and its value.
+    TAG_INSTANCE,       // The class name, a string, the count of fields, then each field name, a string, and its value.
+    TAG_RECORD,         // The type name, a string, the count of fields, then the values in declaration order.
+    TAG_REFERENCE,      // The index of a string or object read before, counting from 0 in the order they were read.
+} Tag;
+
+/**
+ * Biggest whole number a double holds exactly, along with all the smaller ones.
+ */
+#define MAX_EXACT_INTEGER 9007199254740992.0
+
+// Writing.
+
+/**
+ * A string or object written already, with its reference index.
+ */
+typedef struct {
+    Obj *object;
+    int index;
+} SeenObject;
+
+typedef struct {
+    char *bytes;            // What was written so far. Unmanaged memory, so writing never triggers garbage collection.
+    size_t length;          // How many bytes were written.
+    size_t capacity;        // Size of `bytes`.
+    SeenObject *seen;       // Hash set of the strings and objects written so far, a NULL object for a free bucket.
+    int seenCount;          // How many there are, which is also the next reference index.
+    int seenCapacity;       // How many buckets there are, a power of two.
+    ObjString **names;      // The name of each symbol, built the first time an instance is written.
+    int depth;              // How many lists, maps, instances and records the writer is in.
+} Serializer;
+
+/**
+ * Make room for more bytes at the end of the output.
+ */
+static void reserveBytes(Serializer *serializer, size_t count) {
+    if (serializer->length + count <= serializer->capacity)
+        return;
+    size_t capacity = serializer->capacity < 256 ? 256 : serializer->capacity;
+    while (serializer->length + count > capacity)
+        capacity *= 2;
+    serializer->bytes = GROW_ARRAY_UNMANAGED(char, serializer->bytes, capacity);
+    serializer->capacity = capacity;
+}
+
+static void writeByte(Serializer *serializer, uint8_t byte) {
+    reserveBytes(serializer, 1);
+    serializer->bytes[serializer->length++] = (char) byte;
+}
+
+static void writeBytes(Serializer *serializer, const char *bytes, size_t count) {
+    reserveBytes(serializer, count);
+    memcpy(serializer->bytes + serializer->length, bytes, count);
+    serializer->length += count;
+}
+
+static void writeVarint(Serializer *serializer, uint64_t value) {
+    // Ten bytes hold the 64 bits at seven a byte.
+    reserveBytes(serializer, 10);
+    char *out = serializer->bytes + serializer->length;
+    int count = 0;
+    while (value >= 0x80) {
+        out[count++] = (char) (value | 0x80);
+        value >>= 7;
+    }
+    out[count++] = (char) value;
+    serializer->length += count;
+}
+
+static void writeNumber(Serializer *serializer, double number) {
+    // NaN fails the range check. Negative zero is whole but would come back positive.
+    if (number >= -MAX_EXACT_INTEGER && number <= MAX_EXACT_INTEGER && (double) (int64_t) number == number &&
+        !(number == 0 && signbit(number))) {
+        int64_t integer = (int64_t) number;
+        writeByte(serializer, TAG_INTEGER);
+        writeVarint(serializer, ((uint64_t) integer << 1) ^ (uint64_t) (integer >> 63));
+        return;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    reserveBytes(serializer, 9);
+    serializer->bytes[serializer->length++] = TAG_NUMBER;
+    for (int i = 0; i < 8; i++) {
+        serializer->bytes[serializer->length++] = (char) (bits >> (8 * i));
+    }
+}
+
+/**
+ * @return The bucket of an object in the set of written ones, or the free bucket where it would go.
+ */
+static SeenObject *findSeen(Serializer *serializer, Obj *object) {
+    // The low bits of a pointer are always the same, the multiplication spreads the others.
+    uint64_t hash = ((uintptr_t) object >> 3) * 0x9E3779B97F4A7C15ULL;
+    uint32_t index = (uint32_t) (hash >> 32) & (serializer->seenCapacity - 1);
+    for (;;) {
+        SeenObject *bucket = &serializer->seen[index];
+        if (bucket->object == object || bucket->object == NULL)
+            return bucket;
+        index = (index + 1) & (serializer->seenCapacity - 1);
+    }
+}
+
+/**
+ * Give a string or object the next reference index, the one it is referenced by from then on.
+ */
+static void addSeen(Serializer *serializer, Obj *object) {
+    // Kept at most half full.
+    if (2 * (serializer->seenCount + 1) > serializer->seenCapacity) {
+        SeenObject *old = serializer->seen;
+        int oldCapacity = serializer->seenCapacity;
+        serializer->seenCapacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+        serializer->seen = calloc(serializer->seenCapacity, sizeof(SeenObject));
+        for (int i = 0; i < oldCapacity; i++) {
+            if (old[i].object != NULL)
+                *findSeen(serializer, old[i].object) = old[i];
+        }
+        free(old);
+    }
+    *findSeen(serializer, object) = (SeenObject) {object, serializer->seenCount++};
+}
+
+/**
+ * Write a reference if a string or object was written before.
+ *
+ * @return Whether it was.
+ */
+static bool writeReference(Serializer *serializer, Obj *object) {
+    if (serializer->seenCount == 0)
+        return false;
+    SeenObject *bucket = findSeen(serializer, object);
+    if (bucket->object == NULL)
+        return false;
+    writeByte(serializer, TAG_REFERENCE);
+    writeVarint(serializer, bucket->index);
+    return true;
+}
+
+static void writeString(Serializer *serializer, ObjString *string) {
+    if (writeReference(serializer, (Obj *) string))
+        return;
+    addSeen(serializer, (Obj *) string);
+    writeByte(serializer, TAG_STRING);
+    writeVarint(serializer, string->length);
+    writeBytes(serializer, string->chars, string->length);
+}
+
+/**
+ * Find the names of the symbols, which the fields of instances are laid out by.
+ */
+static void collectNames(Serializer *serializer) {
+    serializer->names = calloc(vm.symbolCount, sizeof(ObjString *));
+    for (int i = 0; i < vm.symbols.capacity; i++) {
+        Entry *entry = &vm.symbols.entries[i];
+        if (entry->key != NULL)
+            serializer->names[(int) AS_NUMBER(entry->value)] = entry->key;
+    }
+}
+
+static bool serializeValue(Serializer *serializer, Value value);
+
+static bool writeInstance(Serializer *serializer, ObjInstance *instance) {
+    ObjClass *klass = instance->klass;
+    if (serializer->names == NULL)
+        collectNames(serializer);
+
+    // The class name comes first, it is read before the instance can be made.
+    writeByte(serializer, TAG_INSTANCE);
+    writeString(serializer, klass->name);
+    addSeen(serializer, (Obj *) instance);
+    int count = 0;
+    for (int i = 0; i < klass->fieldSlotsCapacity; i++) {
+        FieldSlot *entry = &klass->fieldSlots[i];
+        if (entry->symbol >= 0 && entry->slot < instance->fieldCapacity && !IS_EMPTY(instance->fields[entry->slot]))
+            count++;
+    }
+    writeVarint(serializer, count);
+    for (int i = 0; i < klass->fieldSlotsCapacity; i++) {
+        FieldSlot *entry = &klass->fieldSlots[i];
+        if (entry->symbol < 0 || entry->slot >= instance->fieldCapacity || IS_EMPTY(instance->fields[entry->slot]))
+            continue;
+        writeString(serializer, serializer->names[entry->symbol]);
+        if (!serializeValue(serializer, instance->fields[entry->slot]))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Write a value, after its tag.
+ *
+ * @return Whether the value could be written, if not an error was reported.
+ */
+static bool serializeValue(Serializer *serializer, Value value) {
+    if (IS_NIL(value)) {
+        writeByte(serializer, TAG_NIL);
+        return true;
+    }
+    if (IS_BOOL(value)) {
+        writeByte(serializer, AS_BOOL(value) ? TAG_TRUE : TAG_FALSE);
+        return true;
+    }
+    if (IS_NUMBER(value)) {
+        writeNumber(serializer, AS_NUMBER(value));
+        return true;
+    }
+    if (IS_STRING(value)) {
+        writeString(serializer, AS_STRING(value));
+        return true;
+    }
+    if (!IS_LIST(value) && !IS_MAP(value) && !IS_INSTANCE(value) && !IS_RECORD(value)) {
+        nativeError("Can't serialize %s.", typeName(value));
+        return false;
+    }
+
+    if (writeReference(serializer, AS_OBJ(value)))
+        return true;
+    if (serializer->depth == SERIALIZE_MAX_DEPTH) {
+        nativeError("Too deeply nested to serialize.");
+        return false;
+    }
+    serializer->depth++;
+
+    // A record is only referenced once it was written whole, because it is only made once all of its values are read. A
+    // record inside itself, through a list or the like, is written again in there, and comes back as an equal record.
+    if (IS_RECORD(value)) {
+        ObjRecord *record = AS_RECORD(value);
+        writeByte(serializer, TAG_RECORD);
+        writeString(serializer, record->type->name);
+        writeVarint(serializer, record->fieldCount);
+        for (int i = 0; i < record->fieldCount; i++) {
+            if (!serializeValue(serializer, record->values[i]))
+                return false;
+        }
+        addSeen(serializer, AS_OBJ(value));
+        serializer->depth--;
+        return true;
+    }
+
+    if (IS_LIST(value)) {
+        ObjList *list = AS_LIST(value);
+        addSeen(serializer, AS_OBJ(value));
+        writeByte(serializer, TAG_LIST);
+        writeVarint(serializer, list->count);
+        for (int i = 0; i < list->count; i++) {
+            if (!serializeValue(serializer, list->items[i]))
+                return false;
+        }
+    } else if (IS_MAP(value)) {
+        ObjMap *map = AS_MAP(value);
+        addSeen(serializer, AS_OBJ(value));
+        writeByte(serializer, TAG_MAP);
+        writeVarint(serializer, map->count);
+        for (int i = 0; i < map->used; i++) {
+            if (map->keys[i] == NULL)
+                continue;
+            writeString(serializer, map->keys[i]);
+            if (!serializeValue(serializer, map->values[i]))
+                return false;
+        }
+    } else if (!writeInstance(serializer, AS_INSTANCE(value))) {
+        return false;
+    }
+    serializer->depth--;
+    return true;
+}
+
+/**
+ * `serialize(value)`, see `initSerializeLibrary`.
+ */
+static Value serializeNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount, 1, 1))
+        return EMPTY_VAL;
+
+    Serializer serializer = {NULL, 0, 0, NULL, 0, 0, NULL, 0};
+    writeBytes(&serializer, MAGIC, MAGIC_LENGTH);
+    writeByte(&serializer, SERIALIZE_VERSION);
+    bool written = serializeValue(&serializer, args[0]);
+    free(serializer.seen);
+    free(serializer.names);
+    if (written && serializer.length > INT_MAX) {
+        nativeError("Resulting string is too long.");
+        written = false;
+    }
+
+    Value result = EMPTY_VAL;
+    if (written)
+        result = OBJ_VAL(copyString(serializer.bytes, (int) serializer.length));
+    FREE_UNMANAGED(serializer.bytes);
+    return result;
+}
+
+// Reading.
+
+typedef struct {
+    const uint8_t *start;   // The data, for the position in error messages.
+    const uint8_t *current; // The next byte to read.
+    const uint8_t *end;     // Where the data ends.
+    ObjList *objects;       // Every string and object read so far, by reference index. On the stack, so all of them are
+                            // reachable while the value is being put together.
+    int depth;              // How many lists, maps, instances and records the reader is in.
+} Deserializer;
+
+/**
+ * Report malformed data.
+ *
+ * @return False, for convenience.
+ */
+static bool dataError(Deserializer *deserializer, const char *message) {
+    nativeError("Invalid serialized data at byte %d: %s.", (int) (deserializer->current - deserializer->start), message);
+    return false;
+}
+
+static bool readVarint(Deserializer *deserializer, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (deserializer->current == deserializer->end)
+            return dataError(deserializer, "data ends in the middle of a value");
+        uint8_t byte = *deserializer->current++;
+        result |= (uint64_t) (byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            *value = result;
+            return true;
+        }
+    }
+    return dataError(deserializer, "number too long");
+}
+
+/**
+ * Read a count of bytes or of items, which can't be more than the bytes left since each takes at least one.
+ *
+ * @param itemSize The least bytes each item takes.
+ */
+static bool readCount(Deserializer *deserializer, int itemSize, int *count) {
+    uint64_t value;
+    if (!readVarint(deserializer, &value))
+        return false;
+    if (value > (uint64_t) (deserializer->end - deserializer->current) / itemSize)
+        return dataError(deserializer, "count larger than the data");
+    *count = (int) value;
+    return true;
+}
+
+/**
+ * Make a string or object the next one references can point to.
+ */
+static void addObject(Deserializer *deserializer, Value value) {
+    // Growing the list may collect garbage, and the value is not reachable yet.
+    push(value);
+    appendToList(deserializer->objects, value);
+    pop();
+}
+
+static bool deserializeValue(Deserializer *deserializer, Value *value);
+
+/**
+ * Read a value that has to be a string: a key, a field name, a class or record type name.
+ */
+static bool readString(Deserializer *deserializer, ObjString **string) {
+    Value value;
+    if (!deserializeValue(deserializer, &value))
+        return false;
+    if (!IS_STRING(value))
+        return dataError(deserializer, "expected a string");
+    *string = AS_STRING(value);
+    return true;
+}
+
+/**
+ * Read the name of a class or record type and find the global it names.
+ *
+ * @param name Output parameter, the name.
+ * @param global Output parameter, the value of the global.
+ * @return Whether there is such a global, if not an error was reported.
+ */
+static bool readGlobal(Deserializer *deserializer, ObjString **name, Value *global) {
+    if (!readString(deserializer, name))
+        return false;
+    if (!tableGet(&vm.globals, *name, global)) {
+        nativeError("Can't deserialize '%s', there is no such global.", (*name)->chars);
+        return false;
+    }
+    return true;
+}
+
+static bool readInstance(Deserializer *deserializer, Value *value) {
+    ObjString *name;
+    Value global;
+    if (!readGlobal(deserializer, &name, &global))
+        return false;
+    if (!IS_CLASS(global)) {
+        nativeError("Can't deserialize an instance of '%s', it is %s.", name->chars, typeName(global));
+        return false;
+    }
+    ObjClass *klass = AS_CLASS(global);
+    ObjInstance *instance = newInstance(klass);
+    *value = OBJ_VAL(instance);
+    addObject(deserializer, *value);
+
+    int count;
+    if (!readCount(deserializer, 2, &count))
+        return false;
+    for (int i = 0; i < count; i++) {
+        Value field;
+        if (!readString(deserializer, &name) || !deserializeValue(deserializer, &field))
+            return false;
+
+        // Sealed classes only have the fields their `init` sets, which were laid out by the first instance.
+        int symbol = symbolFor(name);
+        if (klass->isSealed && findFieldSlot(klass, symbol) < 0) {
+            nativeError("Can't add field '%s' to an instance of sealed class '%s'.", name->chars, klass->name->chars);
+            return false;
+        }
+        int slot = layoutField(klass, symbol);
+        if (slot >= instance->fieldCapacity)
+            reserveFields(instance, klass->fieldCount);
+        instance->fields[slot] = field;
+    }
+    return true;
+}
+
+static bool readRecord(Deserializer *deserializer, Value *value) {
+    ObjString *name;
+    Value global;
+    if (!readGlobal(deserializer, &name, &global))
+        return false;
+    if (!IS_RECORD_TYPE(global)) {
+        nativeError("Can't deserialize a record of '%s', it is %s.", name->chars, typeName(global));
+        return false;
+    }
+    ObjRecordType *type = AS_RECORD_TYPE(global);
+
+    int count;
+    if (!readCount(deserializer, 1, &count))
+        return false;
+    if (count != type->fieldCount) {
+        nativeError("Can't deserialize a record of '%s' with %d fields, it has %d.", type->name->chars, count,
+                    type->fieldCount);
+        return false;
+    }
+
+    // The values wait on the stack for the record to be made.
+    Value *values = vm.stackTop;
+    for (int i = 0; i < count; i++) {
+        Value field;
+        if (!deserializeValue(deserializer, &field))
+            return false;
+        push(field);
+    }
+    *value = OBJ_VAL(newRecord(type, values));
+    vm.stackTop = values;
+    addObject(deserializer, *value);
+    return true;
+}
+
+/**
+ * Read a value, tag first.
+ *
+ * @return Whether the value could be read, if not an error was reported.
+ */
+static bool deserializeValue(Deserializer *deserializer, Value *value) {
+    if (deserializer->current == deserializer->end)
+        return dataError(deserializer, "data ends in the middle of a value");
+    uint8_t tag = *deserializer->current++;
+
+    switch (tag) {
+        case TAG_NIL:
+            *value = NIL_VAL;
+            return true;
+        case TAG_FALSE:
+        case TAG_TRUE:
+            *value = BOOL_VAL(tag == TAG_TRUE);
+            return true;
+        case TAG_INTEGER: {
+            uint64_t zigzag;
+            if (!readVarint(deserializer, &zigzag))
+                return false;
+            int64_t integer = (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+            *value = NUMBER_VAL((double) integer);
+            return true;
+        }
+        case TAG_NUMBER: {
+            if (deserializer->end - deserializer->current < 8)
+                return dataError(deserializer, "data ends in the middle of a value");
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits |= (uint64_t) deserializer->current[i] << (8 * i);
+            }
+            deserializer->current += 8;
+            double number;
+            memcpy(&number, &bits, sizeof(number));
+            *value = NUMBER_VAL(number);
+            return true;
+        }
+        case TAG_STRING: {
+            int length;
+            if (!readCount(deserializer, 1, &length))
+                return false;
+            *value = OBJ_VAL(copyString((const char *) deserializer->current, length));
+            deserializer->current += length;
+            addObject(deserializer, *value);
+            return true;
+        }
+        case TAG_REFERENCE: {
+            uint64_t index;
+            if (!readVarint(deserializer, &index))
+                return false;
+            if (index >= (uint64_t) deserializer->objects->count)
+                return dataError(deserializer, "reference to something not read yet");
+            *value = deserializer->objects->items[index];
+            return true;
+        }
+        case TAG_LIST:
+        case TAG_MAP:
+        case TAG_INSTANCE:
+        case TAG_RECORD:
+            break;
+        default:
+            return dataError(deserializer, "unknown tag");
+    }
+
+    if (deserializer->depth == SERIALIZE_MAX_DEPTH)
+        return dataError(deserializer, "too deeply nested");
+    deserializer->depth++;
+    bool read;
+    if (tag == TAG_LIST) {
+        ObjList *list = newList();
+        *value = OBJ_VAL(list);
+        addObject(deserializer, *value);
+        int count;
+        read = readCount(deserializer, 1, &count);
+        if (read && count > 0) {
+            list->items = GROW_ARRAY(Value, NULL, 0, count);
+            list->capacity = count;
+        }
+        for (int i = 0; read && i < count; i++) {
+            Value item;
+            read = deserializeValue(deserializer, &item);
+            if (read)
+                list->items[list->count++] = item;
+        }
+    } else if (tag == TAG_MAP) {
+        ObjMap *map = newMap();
+        *value = OBJ_VAL(map);
+        addObject(deserializer, *value);
+        int count;
+        read = readCount(deserializer, 2, &count);
+        for (int i = 0; read && i < count; i++) {
+            ObjString *key;
+            Value item;
+            read = readString(deserializer, &key) && deserializeValue(deserializer, &item);
+            if (read)
+                mapSet(map, key, item);
+        }
+    } else if (tag == TAG_INSTANCE) {
+        read = readInstance(deserializer, value);
+    } else {
+        read = readRecord(deserializer, value);
+    }
+    deserializer->depth--;
+    return read;
+}
+
+/**
+ * `deserialize(data)`, see `initSerializeLibrary`.
+ */
+static Value deserializeNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount, 1, 1))
+        return EMPTY_VAL;
+    if (!IS_STRING(args[0]))
+        return nativeError("Expected a string as argument 1 but got %s.", typeName(args[0]));
+
+    ObjString *data = AS_STRING(args[0]);
+    if (data->length < MAGIC_LENGTH + 1 || memcmp(data->chars, MAGIC, MAGIC_LENGTH) != 0)
+        return nativeError("Not serialized data.");
+    if ((uint8_t) data->chars[MAGIC_LENGTH] != SERIALIZE_VERSION)
+        return nativeError("Serialized data of version %d, only version %d can be read.",
+                           (uint8_t) data->chars[MAGIC_LENGTH], SERIALIZE_VERSION);
+
+    Deserializer deserializer;
+    deserializer.start = (const uint8_t *) data->chars;
+    deserializer.current = deserializer.start + MAGIC_LENGTH + 1;
+    deserializer.end = deserializer.start + data->length;
+    deserializer.depth = 0;
+
+    // Everything read stays on the stack, above the arguments, until it is returned.
+    Value *base = vm.stackTop;
+    deserializer.objects = newList();
+    push(OBJ_VAL(deserializer.objects));
+
+    // On failure the error was reported already, and the stack may be gone with it.
+    Value result;
+    if (!deserializeValue(&deserializer, &result))
+        return EMPTY_VAL;
+    if (deserializer.current != deserializer.end) {
+        dataError(&deserializer, "unexpected bytes after the value");
+        return EMPTY_VAL;
+    }
+    vm.stackTop = base;
+    return result;
+}
+
+void initSerializeLibrary() {
+    defineNative("serialize", serializeNative);
+    defineNative("deserialize", deserializeNative);
+}
@@ -0,0 +1,27 @@
+#ifndef NAMELESS_SERIALIZE_H
+#define NAMELESS_SERIALIZE_H
+
+#include "common.h"
+
+/**
+ * Version of the binary format, written after the "NL" magic. Data of another version is refused.
+ */
+#define SERIALIZE_VERSION 1
+
+/**
+ * Most levels of lists, maps, instances and records inside one another, writing or reading.
+ */
+#define SERIALIZE_MAX_DEPTH 512
+
+/**
+ * Define the natives of the binary format, made for caching values and passing them between processes:
+ * - `serialize(value)` turns nil, booleans, numbers, strings, lists, maps, instances and records into a string of
+ * bytes. Instances and records are written with the name of their class or record type, and a string or object met a
+ * second time is written as a reference to the first one, so shared parts stay shared and cycles through lists, maps
+ * and instances come back as cycles.
+ * - `deserialize(data)` turns the bytes back into a value. Classes and record types are looked up by name among the
+ * globals, and instances are rebuilt field by field without calling `init`.
+ */
+void initSerializeLibrary();
+
+#endif
@@ -0,0 +1,559 @@
+#include <string.h>
+
+#include "sortlib.h"
+#include "memory.h"
+#include "vm.h"
+
+/**
+ * Ranges this short are sorted by insertion, which beats partitioning them.
+ */
+#define INSERTION_SORT_THRESHOLD 16
+
+/**
+ * How many items an insertion sort may move before giving up on a range that looked sorted already.
+ */
+#define PARTIAL_INSERTION_LIMIT 8
+
+/**
+ * Ranges longer than this take their pivot from three medians of three rather than one.
+ */
+#define NINTHER_THRESHOLD 128
+
+/**
+ * How items are compared.
+ */
+typedef enum {
+    ORDER_NUMBERS,
+    ORDER_STRINGS,
+    ORDER_COMPARATOR,
+} SortOrder;
+
+typedef struct {
+    SortOrder order;
+    Value comparator;       // The program's comparator, for ORDER_COMPARATOR.
+    bool failed;            // The comparator failed and an error was reported. Every comparison is false from then on,
+                            // so the algorithms wind down quickly, leaving the items in some order.
+} Sorter;
+
+/**
+ * Compare two strings byte by byte, a prefix first.
+ *
+ * @return Negative, 0 or positive, like `memcmp`.
+ */
+static inline int compareStrings(ObjString *a, ObjString *b) {
+    int length = a->length < b->length ? a->length : b->length;
+    int result = memcmp(a->chars, b->chars, length);
+    return result != 0 ? result : a->length - b->length;
+}
+
+/**
+ * Call the program's comparator.
+ *
+ * @return What it returned, 0 if it failed.
+ */
+static double callComparator(Sorter *sorter, Value a, Value b) {
+    if (sorter->failed)
+        return 0;
+
+    // The items are reachable from the list being sorted, the call copies them to the stack.
+    Value args[2] = {a, b};
+    Value result;
+    if (!callFunction(sorter->comparator, 2, args, &result)) {
+        sorter->failed = true;
+        return 0;
+    }
+    if (!IS_NUMBER(result)) {
+        nativeError("Comparator must return a number but got %s.", typeName(result));
+        sorter->failed = true;
+        return 0;
+    }
+    return AS_NUMBER(result);
+}
+
+/**
+ * @return Whether `a` goes strictly before `b`.
+ */
+static inline bool lessThan(Sorter *sorter, Value a, Value b) {
+    switch (sorter->order) {
+        case ORDER_NUMBERS:
+            return AS_NUMBER(a) < AS_NUMBER(b);
+        case ORDER_STRINGS:
+            // Strings are interned, the same object is the same string.
+            return AS_STRING(a) != AS_STRING(b) && compareStrings(AS_STRING(a), AS_STRING(b)) < 0;
+        default:
+            return callComparator(sorter, a, b) < 0;
+    }
+}
+
+/**
+ * Find how to compare the items of a list without a comparator, raising an error if they are not all numbers or all
+ * strings.
+ *
+ * @param items The items.
+ * @param count How many there are.
+ * @param sorter Its order is set.
+ * @return Whether the items can be compared.
+ */
+static bool findNaturalOrder(Value *items, int count, Sorter *sorter) {
+    sorter->comparator = NIL_VAL;
+    sorter->failed = false;
+    sorter->order = count > 0 && IS_STRING(items[0]) ? ORDER_STRINGS : ORDER_NUMBERS;
+    for (int i = 0; i < count; i++) {
+        bool matches = sorter->order == ORDER_STRINGS ? IS_STRING(items[i]) : IS_NUMBER(items[i]);
+        if (!matches) {
+            nativeError("Can't compare %s and %s without a comparator.", typeName(items[0]), typeName(items[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline void swap(Value *items, int a, int b) {
+    Value item = items[a];
+    items[a] = items[b];
+    items[b] = item;
+}
+
+// Unstable sort: pattern-defeating quicksort, an introsort that also takes advantage of sorted runs and of many equal
+// items. None of the loops trusts the comparator to stay within the range, a comparator that contradicts itself only
+// makes for some order.
+
+static void insertionSort(Sorter *sorter, Value *items, int count) {
+    for (int i = 1; i < count; i++) {
+        Value item = items[i];
+        int j = i;
+        while (j > 0 && lessThan(sorter, item, items[j - 1])) {
+            items[j] = items[j - 1];
+            j--;
+        }
+        items[j] = item;
+    }
+}
+
+/**
+ * Insertion sort a range, unless it takes more than a few moves.
+ *
+ * @return Whether the range got sorted.
+ */
+static bool partialInsertionSort(Sorter *sorter, Value *items, int count) {
+    int moves = 0;
+    for (int i = 1; i < count; i++) {
+        Value item = items[i];
+        int j = i;
+        while (j > 0 && lessThan(sorter, item, items[j - 1])) {
+            items[j] = items[j - 1];
+            j--;
+        }
+        items[j] = item;
+        moves += i - j;
+        if (moves > PARTIAL_INSERTION_LIMIT)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Move an item down a max heap until the items below it are not greater.
+ */
+static void siftDown(Sorter *sorter, Value *items, int root, int count) {
+    Value item = items[root];
+    for (;;) {
+        int child = 2 * root + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count && lessThan(sorter, items[child], items[child + 1]))
+            child++;
+        if (!lessThan(sorter, item, items[child]))
+            break;
+        items[root] = items[child];
+        root = child;
+    }
+    items[root] = item;
+}
+
+static void heapify(Sorter *sorter, Value *items, int count) {
+    for (int i = count / 2 - 1; i >= 0; i--) {
+        siftDown(sorter, items, i, count);
+    }
+}
+
+/**
+ * Sort a max heap, greatest last.
+ */
+static void sortHeap(Sorter *sorter, Value *items, int count) {
+    for (int end = count - 1; end > 0; end--) {
+        swap(items, 0, end);
+        siftDown(sorter, items, 0, end);
+    }
+}
+
+/**
+ * Put the smallest of three items first and the greatest last.
+ */
+static void sortThree(Sorter *sorter, Value *items, int a, int b, int c) {
+    if (lessThan(sorter, items[b], items[a]))
+        swap(items, a, b);
+    if (lessThan(sorter, items[c], items[b]))
+        swap(items, b, c);
+    if (lessThan(sorter, items[b], items[a]))
+        swap(items, a, b);
+}
+
+/**
+ * Move the pivot of a range to its start: the median of the first, middle and last items, or of three such medians for
+ * long ranges.
+ */
+static void choosePivot(Sorter *sorter, Value *items, int count) {
+    int middle = count / 2;
+    if (count > NINTHER_THRESHOLD) {
+        sortThree(sorter, items, 0, middle, count - 1);
+        sortThree(sorter, items, 1, middle - 1, count - 2);
+        sortThree(sorter, items, 2, middle + 1, count - 3);
+        sortThree(sorter, items, middle - 1, middle, middle + 1);
+        swap(items, 0, middle);
+    } else {
+        sortThree(sorter, items, middle, 0, count - 1);
+    }
+}
+
+/**
+ * Partition a range around its first item: the items less than the pivot go before it, the others after it.
+ *
+ * @param alreadyPartitioned Output parameter, whether no item had to move, in which case the range may be sorted.
+ * @return Where the pivot ends up.
+ */
+static int partitionRight(Sorter *sorter, Value *items, int count, bool *alreadyPartitioned) {
+    Value pivot = items[0];
+    int first = 1;
+    int last = count - 1;
+    while (first <= last && lessThan(sorter, items[first], pivot)) first++;
+    while (first <= last && !lessThan(sorter, items[last], pivot)) last--;
+    *alreadyPartitioned = first > last;
+
+    while (first < last) {
+        swap(items, first++, last--);
+        while (first <= last && lessThan(sorter, items[first], pivot)) first++;
+        while (first <= last && !lessThan(sorter, items[last], pivot)) last--;
+    }
+
+    int position = first - 1;
+    items[0] = items[position];
+    items[position] = pivot;
+    return position;
+}
+
+/**
+ * Partition a range around its first item, the items not greater than the pivot going before it. Used when the pivot
+ * equals the item before the range, which no item of the range is less than: all items before the pivot equal it, and
+ * need no more sorting.
+ *
+ * @return Where the pivot ends up.
+ */
+static int partitionLeft(Sorter *sorter, Value *items, int count) {
+    Value pivot = items[0];
+    int first = 1;
+    int last = count - 1;
+    while (first <= last && !lessThan(sorter, pivot, items[first])) first++;
+    while (first <= last && lessThan(sorter, pivot, items[last])) last--;
+
+    while (first < last) {
+        swap(items, first++, last--);
+        while (first <= last && !lessThan(sorter, pivot, items[first])) first++;
+        while (first <= last && lessThan(sorter, pivot, items[last])) last--;
+    }
+
+    int position = first - 1;
+    items[0] = items[position];
+    items[position] = pivot;
+    return position;
+}
+
+/**
+ * Sort a range.
+ *
+ * @param badAllowed How many more unbalanced partitions to put up with before switching to heap sort, which bounds the
+ * sort to O(n log n) whatever the input.
+ * @param leftmost Whether the range starts the list. If not, the item before it is not greater than any in the range.
+ */
+static void introSort(Sorter *sorter, Value *items, int count, int badAllowed, bool leftmost) {
+    for (;;) {
+        if (sorter->failed)
+            return;
+        if (count <= INSERTION_SORT_THRESHOLD) {
+            insertionSort(sorter, items, count);
+            return;
+        }
+        if (badAllowed == 0) {
+            heapify(sorter, items, count);
+            sortHeap(sorter, items, count);
+            return;
+        }
+
+        choosePivot(sorter, items, count);
+        if (!leftmost && !lessThan(sorter, items[-1], items[0])) {
+            int position = partitionLeft(sorter, items, count);
+            items += position + 1;
+            count -= position + 1;
+            continue;
+        }
+
+        bool alreadyPartitioned;
+        int position = partitionRight(sorter, items, count, &alreadyPartitioned);
+        int leftCount = position;
+        int rightCount = count - position - 1;
+
+        if (leftCount < count / 8 || rightCount < count / 8) {
+            // A bad pivot. Swapping a few items breaks the patterns that keep giving bad pivots.
+            badAllowed--;
+            if (leftCount >= INSERTION_SORT_THRESHOLD) {
+                swap(items, 0, leftCount / 4);
+                swap(items, position - 1, position - leftCount / 4);
+            }
+            if (rightCount >= INSERTION_SORT_THRESHOLD) {
+                swap(items, position + 1, position + 1 + rightCount / 4);
+                swap(items, count - 1, count - rightCount / 4);
+            }
+        } else if (alreadyPartitioned && partialInsertionSort(sorter, items, leftCount) &&
+                   partialInsertionSort(sorter, items + position + 1, rightCount)) {
+            // Nothing moved: the range was probably sorted already, and the insertion sorts checked it was.
+            return;
+        }
+
+        // Recursing into the smaller side and looping on the larger one keeps the C stack logarithmic.
+        if (leftCount < rightCount) {
+            introSort(sorter, items, leftCount, badAllowed, leftmost);
+            items += position + 1;
+            count = rightCount;
+            leftmost = false;
+        } else {
+            introSort(sorter, items + position + 1, rightCount, badAllowed, false);
+            count = leftCount;
+        }
+    }
+}
+
+static void unstableSort(Sorter *sorter, Value *items, int count) {
+    int log = 0;
+    while ((1 << log) < count && log < 30) log++;
+    introSort(sorter, items, count, log, true);
+}
+
+// Stable sort: merge sort, with insertion sort for short ranges.
+
+/**
+ * Sort a range, stably.
+ *
+ * @param buffer Room for half the range.
+ */
+static void mergeSort(Sorter *sorter, Value *items, int count, Value *buffer) {
+    if (count <= INSERTION_SORT_THRESHOLD) {
+        insertionSort(sorter, items, count);
+        return;
+    }
+
+    int half = count / 2;
+    mergeSort(sorter, items, half, buffer);
+    mergeSort(sorter, items + half, count - half, buffer);
+    // Halves already in order are common, e.g. items appended to a sorted list.
+    if (sorter->failed || !lessThan(sorter, items[half], items[half - 1]))
+        return;
+
+    // The left half moves out of the way. Merged items never catch up with the right half's items not merged yet.
+    memcpy(buffer, items, sizeof(Value) * half);
+    int left = 0;
+    int right = half;
+    int merged = 0;
+    while (left < half && right < count) {
+        if (lessThan(sorter, items[right], buffer[left])) {
+            items[merged++] = items[right++];
+        } else {
+            items[merged++] = buffer[left++];
+        }
+    }
+    while (left < half) {
+        items[merged++] = buffer[left++];
+    }
+}
+
+// Natives.
+
+/**
+ * Push a new list of the given size on the stack, its items nil.
+ */
+static ObjList *pushListOfSize(int count) {
+    ObjList *list = newList();
+    push(OBJ_VAL(list));
+    if (count > 0) {
+        list->items = GROW_ARRAY(Value, NULL, 0, count);
+        list->capacity = count;
+        list->count = count;
+        for (int i = 0; i < count; i++) {
+            list->items[i] = NIL_VAL;
+        }
+    }
+    return list;
+}
+
+/**
+ * Set up the sorter of a native taking an optional comparator.
+ *
+ * @param list The list whose items are compared.
+ * @param argCount How many arguments the native got, not counting the receiver.
+ * @param comparatorIndex Where the comparator is among the arguments, counting the receiver.
+ * @return Whether the items can be compared, if not an error was reported.
+ */
+static bool initSorter(Sorter *sorter, ObjList *list, int argCount, Value *args, int comparatorIndex) {
+    if (argCount < comparatorIndex)
+        return findNaturalOrder(list->items, list->count, sorter);
+    sorter->order = ORDER_COMPARATOR;
+    sorter->comparator = args[comparatorIndex];
+    sorter->failed = false;
+    return true;
+}
+
+/**
+ * `items.sort()` and `items.stableSort()`, with or without a comparator.
+ *
+ * @param stable Whether the sort is stable.
+ */
+static Value sortList(int argCount, Value *args, bool stable) {
+    if (!checkArgumentCount(argCount - 1, 0, 1))
+        return EMPTY_VAL;
+    ObjList *list = AS_LIST(args[0]);
+    Sorter sorter;
+    if (!initSorter(&sorter, list, argCount - 1, args, 1))
+        return EMPTY_VAL;
+    int count = list->count;
+
+    // A comparator could change the list as it is sorted, so its items are sorted apart and put back afterwards.
+    Value *base = vm.stackTop;
+    Value *items = list->items;
+    if (sorter.order == ORDER_COMPARATOR) {
+        ObjList *copy = pushListOfSize(count);
+        if (count > 0)
+            memcpy(copy->items, list->items, sizeof(Value) * count);
+        items = copy->items;
+    }
+
+    if (stable) {
+        // Items only in the buffer must stay reachable, in case the comparator collects garbage.
+        ObjList *buffer = pushListOfSize(count / 2);
+        mergeSort(&sorter, items, count, buffer->items);
+    } else {
+        unstableSort(&sorter, items, count);
+    }
+    if (sorter.failed)
+        return EMPTY_VAL;
+
+    if (items != list->items && count > 0) {
+        if (list->count != count)
+            return nativeError("List changed while sorting.");
+        memcpy(list->items, items, sizeof(Value) * count);
+    }
+    vm.stackTop = base;
+    return args[0];
+}
+
+/**
+ * `items.sort()` and `items.sort(compare)`, see `initSortLibrary`.
+ */
+static Value sortNative(int argCount, Value *args) {
+    return sortList(argCount, args, false);
+}
+
+/**
+ * `items.stableSort()` and `items.stableSort(compare)`, see `initSortLibrary`.
+ */
+static Value stableSortNative(int argCount, Value *args) {
+    return sortList(argCount, args, true);
+}
+
+/**
+ * `items.binarySearch(item)` and `items.binarySearch(item, compare)`, see `initSortLibrary`.
+ */
+static Value binarySearchNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 2))
+        return EMPTY_VAL;
+    ObjList *list = AS_LIST(args[0]);
+    Value item = args[1];
+
+    Sorter sorter;
+    if (!initSorter(&sorter, list, argCount - 1, args, 2))
+        return EMPTY_VAL;
+    // The natural order was found from the list, the item must fit in it too. An empty list takes anything.
+    if (sorter.order != ORDER_COMPARATOR && list->count > 0) {
+        bool matches = sorter.order == ORDER_STRINGS ? IS_STRING(item) : IS_NUMBER(item);
+        if (!matches)
+            return nativeError("Can't compare %s and %s without a comparator.", typeName(list->items[0]),
+                               typeName(item));
+    }
+
+    // The first item not less than the one searched. The comparator could shrink the list, hence the bound checks.
+    int low = 0;
+    int high = list->count;
+    while (low < high) {
+        if (high > list->count)
+            high = list->count;
+        int middle = low + (high - low) / 2;
+        if (middle >= high)
+            break;
+        if (lessThan(&sorter, list->items[middle], item)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+        if (sorter.failed)
+            return EMPTY_VAL;
+    }
+
+    bool found = low < list->count && !lessThan(&sorter, item, list->items[low]);
+    if (sorter.failed)
+        return EMPTY_VAL;
+    return NUMBER_VAL(found ? low : -low - 1);
+}
+
+/**
+ * `items.topK(k)` and `items.topK(k, compare)`, see `initSortLibrary`. A max heap keeps the k first items seen so far,
+ * so it takes O(n log k) comparisons and room for k items only.
+ */
+static Value topKNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 1, 2))
+        return EMPTY_VAL;
+    ObjList *list = AS_LIST(args[0]);
+    if (!IS_NUMBER(args[1]) || AS_NUMBER(args[1]) < 0 || AS_NUMBER(args[1]) != (int) AS_NUMBER(args[1]))
+        return nativeError("Count must be a whole number, at least 0.");
+    int k = (int) AS_NUMBER(args[1]);
+    if (k > list->count)
+        k = list->count;
+
+    Sorter sorter;
+    if (!initSorter(&sorter, list, argCount - 1, args, 2))
+        return EMPTY_VAL;
+
+    Value *base = vm.stackTop;
+    ObjList *heap = pushListOfSize(k);
+    if (k > 0) {
+        memcpy(heap->items, list->items, sizeof(Value) * k);
+        heapify(&sorter, heap->items, k);
+        // The comparator could shrink the list as it goes.
+        for (int i = k; i < list->count && !sorter.failed; i++) {
+            if (lessThan(&sorter, list->items[i], heap->items[0]) && i < list->count) {
+                heap->items[0] = list->items[i];
+                siftDown(&sorter, heap->items, 0, k);
+            }
+        }
+        sortHeap(&sorter, heap->items, k);
+    }
+    if (sorter.failed)
+        return EMPTY_VAL;
+
+    vm.stackTop = base;
+    return OBJ_VAL(heap);
+}
+
+void initSortLibrary() {
+    defineNativeMethod(vm.listClass, "sort", sortNative);
+    defineNativeMethod(vm.listClass, "stableSort", stableSortNative);
+    defineNativeMethod(vm.listClass, "binarySearch", binarySearchNative);
+    defineNativeMethod(vm.listClass, "topK", topKNative);
+}
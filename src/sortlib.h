@@ -0,0 +1,19 @@
+#ifndef NAMELESS_SORTLIB_H
+#define NAMELESS_SORTLIB_H
+
+#include "common.h"
+
+/**
+ * Define the native methods of lists that order them, see `vm.listClass`. Without a comparator the items must be all
+ * numbers or all strings, compared byte by byte, and no code of the program runs. A comparator `compare(a, b)` returns
+ * a negative number when `a` goes before `b`, a positive one when it goes after, 0 when either will do.
+ * - `items.sort()`, `items.sort(compare)`: sort the list in place, and return it.
+ * - `items.stableSort()`, `items.stableSort(compare)`: same, but items comparing equal keep their order.
+ * - `items.binarySearch(item)`, `items.binarySearch(item, compare)`: the index of an item in a sorted list. If the list
+ * does not have the item, `-index - 1` where `index` is where the item would go.
+ * - `items.topK(k)`, `items.topK(k, compare)`: a new list of the `k` first items in sorted order, sorted, items
+ * comparing equal in no particular order. The list does not change.
+ */
+void initSortLibrary();
+
+#endif
@@ -0,0 +1,655 @@
+// For memmem, which is a two-way search on top of vectorized memchr/memcmp in the C libraries that have it.
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+
+#include "stringlib.h"
+#include "memory.h"
+#include "vm.h"
+
+int findBytes(const char *haystack, int haystackLength, const char *needle, int needleLength) {
+    if (needleLength == 0)
+        return 0;
+    if (needleLength > haystackLength)
+        return -1;
+
+    const char *found;
+    if (needleLength == 1) {
+        found = memchr(haystack, needle[0], haystackLength);
+    } else {
+        found = memmem(haystack, haystackLength, needle, needleLength);
+    }
+    return found == NULL ? -1 : (int) (found - haystack);
+}
+
+/**
+ * Find the last occurrence of some bytes in others.
+ *
+ * @return The offset of the last occurrence, -1 if there is none.
+ */
+static int findLastBytes(const char *haystack, int haystackLength, const char *needle, int needleLength) {
+    if (needleLength == 0)
+        return haystackLength;
+
+    for (int i = haystackLength - needleLength; i >= 0; i--) {
+        if (haystack[i] == needle[0] && memcmp(haystack + i, needle, needleLength) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Get a string argument of a native method, raising an error if it is something else.
+ *
+ * @param args The arguments, the receiver first.
+ * @param index The index of the argument, 1 for the first after the receiver.
+ * @param string Output parameter, the string.
+ * @return Whether the argument is a string.
+ */
+static bool stringArgument(Value *args, int index, ObjString **string) {
+    if (!IS_STRING(args[index])) {
+        nativeError("Expected a string as argument %d but got %s.", index, typeName(args[index]));
+        return false;
+    }
+    *string = AS_STRING(args[index]);
+    return true;
+}
+
+/**
+ * Get an integer argument of a native method, raising an error if it is something else.
+ *
+ * @param args The arguments, the receiver first.
+ * @param index The index of the argument, 1 for the first after the receiver.
+ * @param value Output parameter, the integer.
+ * @return Whether the argument is an integer.
+ */
+static bool integerArgument(Value *args, int index, int *value) {
+    if (!IS_NUMBER(args[index])) {
+        nativeError("Expected a number as argument %d but got %s.", index, typeName(args[index]));
+        return false;
+    }
+
+    double number = AS_NUMBER(args[index]);
+    if (!(number >= INT_MIN && number <= INT_MAX) || number != (int) number) {
+        nativeError("Expected an integer as argument %d.", index);
+        return false;
+    }
+    *value = (int) number;
+    return true;
+}
+
+/**
+ * Add a copy of some characters to a list, as a string. Strings are interned, so a piece that already exists is not
+ * copied again.
+ *
+ * @param list The list, which must be reachable.
+ * @param chars The characters.
+ * @param length How many characters.
+ */
+static void appendPiece(ObjList *list, const char *chars, int length) {
+    // On the stack while the list grows.
+    push(OBJ_VAL(copyString(chars, length)));
+    appendToList(list, vm.stackTop[-1]);
+    pop();
+}
+
+/**
+ * Text being put together a piece at a time, when its length is not known up front.
+ */
+typedef struct {
+    char *chars;
+    int length;
+    int capacity;
+} TextBuffer;
+
+/**
+ * Add some characters at the end of a text buffer.
+ *
+ * @param buffer The buffer.
+ * @param chars The characters.
+ * @param length How many characters.
+ */
+static void appendText(TextBuffer *buffer, const char *chars, int length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        int capacity = GROW_CAPACITY(buffer->capacity);
+        while (buffer->length + length + 1 > capacity)
+            capacity *= 2;
+        buffer->chars = GROW_ARRAY(char, buffer->chars, buffer->capacity, capacity);
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->chars + buffer->length, chars, length);
+    buffer->length += length;
+}
+
+/**
+ * Turn a text buffer into a string. The buffer is left empty.
+ *
+ * @param buffer The buffer.
+ * @return The string.
+ */
+static ObjString *takeText(TextBuffer *buffer) {
+    // Strings own exactly their length plus the terminator.
+    char *chars = GROW_ARRAY(char, buffer->chars, buffer->capacity, buffer->length + 1);
+    chars[buffer->length] = '\0';
+    ObjString *string = takeString(chars, buffer->length);
+    buffer->chars = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    return string;
+}
+
+/**
+ * Get the compiled pattern for an argument of a native method, raising an error if it is not a valid pattern. Patterns
+ * are compiled once and cached by their text.
+ *
+ * @param args The arguments, the receiver first.
+ * @param index The index of the argument, 1 for the first after the receiver.
+ * @return The compiled pattern, NULL on error.
+ */
+static Regex *patternArgument(Value *args, int index) {
+    ObjString *pattern;
+    if (!stringArgument(args, index, &pattern))
+        return NULL;
+
+    const char *error;
+    Regex *regex = cachedRegex(&vm.regexCache, pattern->chars, pattern->length, pattern->hash, &error);
+    if (regex == NULL)
+        nativeError("Invalid pattern: %s", error);
+    return regex;
+}
+
+/**
+ * Make the list of what a match captured: the whole match, then each group, nil for groups that did not take part.
+ *
+ * @param string The string that was searched.
+ * @param captures Where the match and the groups start and end.
+ * @param groupCount How many groups the pattern has.
+ * @return The list.
+ */
+static ObjList *matchList(ObjString *string, int *captures, int groupCount) {
+    ObjList *list = newList();
+    push(OBJ_VAL(list));
+    for (int i = 0; i <= groupCount; i++) {
+        int start = captures[2 * i];
+        int end = captures[2 * i + 1];
+        if (start < 0 || end < 0) {
+            appendToList(list, NIL_VAL);
+        } else {
+            appendPiece(list, string->chars + start, end - start);
+        }
+    }
+    pop();
+    return list;
+}
+
+/**
+ * Where to search after a match: right after it, or one further after an empty match so it is not found again.
+ */
+static inline int afterMatch(int *captures) {
+    return captures[1] == captures[0] ? captures[1] + 1 : captures[1];
+}
+
+/**
+ * `s.matches(pattern)`: whether a pattern matches somewhere in the string.
+ */
+static Value matchesNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    Regex *regex;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || (regex = patternArgument(args, 1)) == NULL)
+        return EMPTY_VAL;
+
+    int captures[2 * (REGEX_MAX_GROUPS + 1)];
+    return BOOL_VAL(searchRegex(regex, string->chars, string->length, 0, captures));
+}
+
+/**
+ * `s.match(pattern)`: the first match of a pattern in the string, as a list of the matched text and the text of each
+ * group. Nil if the pattern does not match.
+ */
+static Value matchNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    Regex *regex;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || (regex = patternArgument(args, 1)) == NULL)
+        return EMPTY_VAL;
+
+    int captures[2 * (REGEX_MAX_GROUPS + 1)];
+    if (!searchRegex(regex, string->chars, string->length, 0, captures))
+        return NIL_VAL;
+    return OBJ_VAL(matchList(string, captures, regexGroupCount(regex)));
+}
+
+/**
+ * `s.matchAll(pattern)`: every match of a pattern in the string, without overlaps, each as `match` would give it.
+ */
+static Value matchAllNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    Regex *regex;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || (regex = patternArgument(args, 1)) == NULL)
+        return EMPTY_VAL;
+
+    ObjList *matches = newList();
+    push(OBJ_VAL(matches));
+    int captures[2 * (REGEX_MAX_GROUPS + 1)];
+    for (int at = 0; at <= string->length && searchRegex(regex, string->chars, string->length, at, captures);
+         at = afterMatch(captures)) {
+        push(OBJ_VAL(matchList(string, captures, regexGroupCount(regex))));
+        appendToList(matches, vm.stackTop[-1]);
+        pop();
+    }
+    pop();
+    return OBJ_VAL(matches);
+}
+
+/**
+ * `s.splitPattern(pattern)`: the list of the parts between matches of a pattern. Empty matches right after the
+ * previous part, or at the end, do not split.
+ */
+static Value splitPatternNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    Regex *regex;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || (regex = patternArgument(args, 1)) == NULL)
+        return EMPTY_VAL;
+
+    ObjList *list = newList();
+    push(OBJ_VAL(list));
+    int captures[2 * (REGEX_MAX_GROUPS + 1)];
+    int pieceStart = 0;
+    for (int at = 0; at <= string->length && searchRegex(regex, string->chars, string->length, at, captures);
+         at = afterMatch(captures)) {
+        if (captures[0] == captures[1] && (captures[0] == pieceStart || captures[0] == string->length))
+            continue;
+        appendPiece(list, string->chars + pieceStart, captures[0] - pieceStart);
+        pieceStart = captures[1];
+    }
+    appendPiece(list, string->chars + pieceStart, string->length - pieceStart);
+    pop();
+    return OBJ_VAL(list);
+}
+
+/**
+ * `s.replacePattern(pattern, replacement)`: the string with every match of a pattern replaced. In the replacement,
+ * `$0` stands for the match, `$1` to `$9` for the groups and `$$` for a dollar sign.
+ */
+static Value replacePatternNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    Regex *regex;
+    ObjString *replacement;
+    if (!checkArgumentCount(argCount - 1, 2, 2) || (regex = patternArgument(args, 1)) == NULL ||
+        !stringArgument(args, 2, &replacement))
+        return EMPTY_VAL;
+
+    // Check the group references before doing any work.
+    int groupCount = regexGroupCount(regex);
+    for (int i = 0; i + 1 < replacement->length; i++) {
+        if (replacement->chars[i] != '$')
+            continue;
+        char next = replacement->chars[++i];
+        if (next >= '0' && next <= '9' && next - '0' > groupCount)
+            return nativeError("Replacement refers to group %d but the pattern has %d.", next - '0', groupCount);
+    }
+
+    TextBuffer buffer = {NULL, 0, 0};
+    int captures[2 * (REGEX_MAX_GROUPS + 1)];
+    int copied = 0;
+    for (int at = 0; at <= string->length && searchRegex(regex, string->chars, string->length, at, captures);
+         at = afterMatch(captures)) {
+        appendText(&buffer, string->chars + copied, captures[0] - copied);
+        for (int i = 0; i < replacement->length; i++) {
+            char c = replacement->chars[i];
+            char next = i + 1 < replacement->length ? replacement->chars[i + 1] : '\0';
+            if (c == '$' && next >= '0' && next <= '9') {
+                int group = next - '0';
+                if (captures[2 * group] >= 0 && captures[2 * group + 1] >= 0)
+                    appendText(&buffer, string->chars + captures[2 * group],
+                               captures[2 * group + 1] - captures[2 * group]);
+                i++;
+            } else if (c == '$' && next == '$') {
+                appendText(&buffer, "$", 1);
+                i++;
+            } else {
+                appendText(&buffer, &c, 1);
+            }
+        }
+        copied = captures[1];
+    }
+    appendText(&buffer, string->chars + copied, string->length - copied);
+    return OBJ_VAL(takeText(&buffer));
+}
+
+/**
+ * `s.length()`: how many bytes the string has.
+ */
+static Value lengthNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return NUMBER_VAL(AS_STRING(args[0])->length);
+}
+
+/**
+ * `s.indexOf(part)`, `s.indexOf(part, from)`: where the first occurrence of a part starts, from some index on. -1 if the
+ * part is not there.
+ */
+static Value indexOfNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *part;
+    int from = 0;
+    if (!checkArgumentCount(argCount - 1, 1, 2) || !stringArgument(args, 1, &part) ||
+        (argCount > 2 && !integerArgument(args, 2, &from)))
+        return EMPTY_VAL;
+    if (from < 0 || from > string->length)
+        return nativeError("Start index out of range.");
+
+    int found = findBytes(string->chars + from, string->length - from, part->chars, part->length);
+    return NUMBER_VAL(found < 0 ? -1 : found + from);
+}
+
+/**
+ * `s.lastIndexOf(part)`: where the last occurrence of a part starts, -1 if the part is not there.
+ */
+static Value lastIndexOfNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *part;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !stringArgument(args, 1, &part))
+        return EMPTY_VAL;
+    return NUMBER_VAL(findLastBytes(string->chars, string->length, part->chars, part->length));
+}
+
+/**
+ * `s.contains(part)`: whether a part occurs in the string.
+ */
+static Value containsNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *part;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !stringArgument(args, 1, &part))
+        return EMPTY_VAL;
+    return BOOL_VAL(findBytes(string->chars, string->length, part->chars, part->length) >= 0);
+}
+
+/**
+ * `s.count(part)`: how many times a part occurs in the string, without overlaps.
+ */
+static Value countNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *part;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !stringArgument(args, 1, &part))
+        return EMPTY_VAL;
+    if (part->length == 0)
+        return nativeError("Can't count empty strings.");
+
+    int count = 0;
+    const char *start = string->chars;
+    int remaining = string->length;
+    int found;
+    while ((found = findBytes(start, remaining, part->chars, part->length)) >= 0) {
+        count++;
+        start += found + part->length;
+        remaining -= found + part->length;
+    }
+    return NUMBER_VAL(count);
+}
+
+/**
+ * `s.startsWith(prefix)`.
+ */
+static Value startsWithNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *prefix;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !stringArgument(args, 1, &prefix))
+        return EMPTY_VAL;
+    return BOOL_VAL(prefix->length <= string->length && memcmp(string->chars, prefix->chars, prefix->length) == 0);
+}
+
+/**
+ * `s.endsWith(suffix)`.
+ */
+static Value endsWithNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *suffix;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !stringArgument(args, 1, &suffix))
+        return EMPTY_VAL;
+    return BOOL_VAL(suffix->length <= string->length &&
+                    memcmp(string->chars + string->length - suffix->length, suffix->chars, suffix->length) == 0);
+}
+
+/**
+ * `s.split(separator)`: the list of the parts between separators. An empty separator splits every character.
+ */
+static Value splitNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *separator;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !stringArgument(args, 1, &separator))
+        return EMPTY_VAL;
+
+    ObjList *list = newList();
+    push(OBJ_VAL(list));
+
+    if (separator->length == 0) {
+        for (int i = 0; i < string->length; i++) {
+            appendPiece(list, string->chars + i, 1);
+        }
+    } else {
+        const char *start = string->chars;
+        int remaining = string->length;
+        int found;
+        while ((found = findBytes(start, remaining, separator->chars, separator->length)) >= 0) {
+            appendPiece(list, start, found);
+            start += found + separator->length;
+            remaining -= found + separator->length;
+        }
+        appendPiece(list, start, remaining);
+    }
+
+    pop();
+    return OBJ_VAL(list);
+}
+
+/**
+ * `s.replace(old, new)`: the string with every occurrence of a part replaced by another. The result is sized up front,
+ * then filled in one pass.
+ */
+static Value replaceNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjString *old, *new;
+    if (!checkArgumentCount(argCount - 1, 2, 2) || !stringArgument(args, 1, &old) || !stringArgument(args, 2, &new))
+        return EMPTY_VAL;
+    if (old->length == 0)
+        return nativeError("Can't replace empty strings.");
+
+    int count = 0;
+    for (int at = 0, found; (found = findBytes(string->chars + at, string->length - at, old->chars, old->length)) >= 0;
+         at += found + old->length) {
+        count++;
+    }
+    if (count == 0)
+        return args[0];
+
+    int64_t length = (int64_t) string->length + (int64_t) count * (new->length - old->length);
+    if (length > INT_MAX)
+        return nativeError("Resulting string is too long.");
+
+    char *chars = ALLOCATE(char, length + 1);
+    char *end = chars;
+    const char *start = string->chars;
+    int remaining = string->length;
+    int found;
+    while ((found = findBytes(start, remaining, old->chars, old->length)) >= 0) {
+        memcpy(end, start, found);
+        end += found;
+        memcpy(end, new->chars, new->length);
+        end += new->length;
+        start += found + old->length;
+        remaining -= found + old->length;
+    }
+    memcpy(end, start, remaining);
+    chars[length] = '\0';
+    return OBJ_VAL(takeString(chars, (int) length));
+}
+
+/**
+ * Trim white space off the ends of a string.
+ *
+ * @param string The string.
+ * @param start Whether to trim the start.
+ * @param end Whether to trim the end.
+ * @return The trimmed string.
+ */
+static Value trim(Value string, bool start, bool end) {
+    const char *chars = AS_C_STRING(string);
+    int from = 0;
+    int to = AS_STRING(string)->length;
+    while (start && from < to && isspace((unsigned char) chars[from]))
+        from++;
+    while (end && to > from && isspace((unsigned char) chars[to - 1]))
+        to--;
+
+    if (from == 0 && to == AS_STRING(string)->length)
+        return string;
+    return OBJ_VAL(copyString(chars + from, to - from));
+}
+
+/**
+ * `s.trim()`: the string without white space at either end.
+ */
+static Value trimNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return trim(args[0], true, true);
+}
+
+/**
+ * `s.trimStart()`: the string without white space at the start.
+ */
+static Value trimStartNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return trim(args[0], true, false);
+}
+
+/**
+ * `s.trimEnd()`: the string without white space at the end.
+ */
+static Value trimEndNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return trim(args[0], false, true);
+}
+
+/**
+ * `s.repeat(times)`: the string repeated a number of times.
+ */
+static Value repeatNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    int times;
+    if (!checkArgumentCount(argCount - 1, 1, 1) || !integerArgument(args, 1, &times))
+        return EMPTY_VAL;
+    if (times < 0)
+        return nativeError("Can't repeat a string a negative number of times.");
+    if (times == 1)
+        return args[0];
+
+    int64_t length = (int64_t) string->length * times;
+    if (length > INT_MAX)
+        return nativeError("Resulting string is too long.");
+
+    char *chars = ALLOCATE(char, length + 1);
+    // Copy what is there already, doubling it each time.
+    int64_t filled = length == 0 ? 0 : string->length;
+    memcpy(chars, string->chars, filled);
+    while (filled < length) {
+        int64_t chunk = filled < length - filled ? filled : length - filled;
+        memcpy(chars + filled, chars, chunk);
+        filled += chunk;
+    }
+    chars[length] = '\0';
+    return OBJ_VAL(takeString(chars, (int) length));
+}
+
+/**
+ * Change the case of the ASCII letters of a string.
+ *
+ * @param string The string.
+ * @param upper Whether to make them upper case, lower case otherwise.
+ * @return The string with the letters changed, the same string if none had to.
+ */
+static Value changeCase(Value string, bool upper) {
+    ObjString *source = AS_STRING(string);
+    char from = upper ? 'a' : 'A';
+    int offset = upper ? 'A' - 'a' : 'a' - 'A';
+
+    int first = 0;
+    while (first < source->length && !(source->chars[first] >= from && source->chars[first] <= from + 25))
+        first++;
+    if (first == source->length)
+        return string;
+
+    char *chars = ALLOCATE(char, source->length + 1);
+    memcpy(chars, source->chars, first);
+    for (int i = first; i < source->length; i++) {
+        char c = source->chars[i];
+        chars[i] = (char) (c >= from && c <= from + 25 ? c + offset : c);
+    }
+    chars[source->length] = '\0';
+    return OBJ_VAL(takeString(chars, source->length));
+}
+
+/**
+ * `s.toUpper()`: the string with ASCII letters in upper case.
+ */
+static Value toUpperNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return changeCase(args[0], true);
+}
+
+/**
+ * `s.toLower()`: the string with ASCII letters in lower case.
+ */
+static Value toLowerNative(int argCount, Value *args) {
+    if (!checkArgumentCount(argCount - 1, 0, 0))
+        return EMPTY_VAL;
+    return changeCase(args[0], false);
+}
+
+/**
+ * `s.substring(start)`, `s.substring(start, end)`: the part of the string from an index, up to another or to the end.
+ */
+static Value substringNative(int argCount, Value *args) {
+    ObjString *string = AS_STRING(args[0]);
+    int start;
+    int end = string->length;
+    if (!checkArgumentCount(argCount - 1, 1, 2) || !integerArgument(args, 1, &start) ||
+        (argCount > 2 && !integerArgument(args, 2, &end)))
+        return EMPTY_VAL;
+    if (start < 0 || end > string->length || start > end)
+        return nativeError("Substring bounds out of range.");
+
+    if (start == 0 && end == string->length)
+        return args[0];
+    return OBJ_VAL(copyString(string->chars + start, end - start));
+}
+
+void initStringLibrary() {
+    defineNativeMethod(vm.stringClass, "length", lengthNative);
+    defineNativeMethod(vm.stringClass, "indexOf", indexOfNative);
+    defineNativeMethod(vm.stringClass, "lastIndexOf", lastIndexOfNative);
+    defineNativeMethod(vm.stringClass, "contains", containsNative);
+    defineNativeMethod(vm.stringClass, "count", countNative);
+    defineNativeMethod(vm.stringClass, "startsWith", startsWithNative);
+    defineNativeMethod(vm.stringClass, "endsWith", endsWithNative);
+    defineNativeMethod(vm.stringClass, "split", splitNative);
+    defineNativeMethod(vm.stringClass, "replace", replaceNative);
+    defineNativeMethod(vm.stringClass, "trim", trimNative);
+    defineNativeMethod(vm.stringClass, "trimStart", trimStartNative);
+    defineNativeMethod(vm.stringClass, "trimEnd", trimEndNative);
+    defineNativeMethod(vm.stringClass, "repeat", repeatNative);
+    defineNativeMethod(vm.stringClass, "toUpper", toUpperNative);
+    defineNativeMethod(vm.stringClass, "toLower", toLowerNative);
+    defineNativeMethod(vm.stringClass, "substring", substringNative);
+    defineNativeMethod(vm.stringClass, "matches", matchesNative);
+    defineNativeMethod(vm.stringClass, "match", matchNative);
+    defineNativeMethod(vm.stringClass, "matchAll", matchAllNative);
+    defineNativeMethod(vm.stringClass, "splitPattern", splitPatternNative);
+    defineNativeMethod(vm.stringClass, "replacePattern", replacePatternNative);
+}
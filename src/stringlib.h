@@ -0,0 +1,23 @@
+#ifndef NAMELESS_STRINGLIB_H
+#define NAMELESS_STRINGLIB_H
+
+#include "common.h"
+
+/**
+ * Find the first occurrence of some bytes in others.
+ *
+ * @param haystack Where to look.
+ * @param haystackLength How many bytes to look through.
+ * @param needle What to look for.
+ * @param needleLength How many bytes to look for. An empty needle is found right away.
+ * @return The offset of the first occurrence, -1 if there is none.
+ */
+int findBytes(const char *haystack, int haystackLength, const char *needle, int needleLength);
+
+/**
+ * Define the native methods of strings: `"a,b".split(",")`, `s.indexOf("x")` and so on. They are called right on the
+ * string, see `vm.stringClass`.
+ */
+void initStringLibrary();
+
+#endif
@@ -130,6 +130,16 @@ bool tableSet(Table *table, ObjString *key, Value value) {
     return isNewKey;
 }
 
+void tableReserve(Table *table, int count) {
+    // Same growth sequence as `tableSet`, so that capacities stay powers of two.
+    int capacity = table->capacity;
+    while (count > capacity * TABLE_MAX_LOAD)
+        capacity = GROW_CAPACITY(capacity);
+
+    if (capacity > table->capacity)
+        adjustCapacity(table, capacity);
+}
+
 bool tableDelete(Table *table, ObjString *key) {
     // Empty table -> no entry.
     if (table->size == 0)
@@ -67,6 +67,14 @@ bool tableGet(Table *table, ObjString *key, Value *value);
  */
 bool tableSet(Table *table, ObjString *key, Value value);
 
+/**
+ * Make room in a table for the given number of entries, so that inserting them will not cause it to grow.
+ *
+ * @param table The target table.
+ * @param count How many entries the table should hold without growing.
+ */
+void tableReserve(Table *table, int count);
+
 /**
  * Remove an entry from a table, replacing it with a tombstone.
  *
@@ -1,6 +1,7 @@
 #include <stdio.h>
 
 #include "value.h"
+#include "number.h"
 #include "object.h"
 #include "memory.h"
 
@@ -26,23 +27,43 @@ void freeValueArray(ValueArray *array) {
     initValueArray(array);
 }
 
-void printValue(Value value) {
+void writeValue(Output *output, Value value) {
     switch (value.type) {
         case VAL_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false");
+            if (AS_BOOL(value))
+                writeOutput(output, "true", 4);
+            else
+                writeOutput(output, "false", 5);
             break;
         case VAL_NIL:
-            printf("nil");
+            writeOutput(output, "nil", 3);
             break;
-        case VAL_NUMBER:
-            printf("%g", AS_NUMBER(value));
+        case VAL_NUMBER: {
+            char text[NUMBER_BUFFER_SIZE];
+            writeOutput(output, text, formatNumber(AS_NUMBER(value), text));
             break;
+        }
         case VAL_OBJ:
-            printObject(value);
+            writeObject(output, value);
+            break;
+        case VAL_EMPTY:
+            writeOutput(output, "<empty>", 7);
             break;
     }
 }
 
+/**
+ * Sink for `printValue`: the C stream keeps debugging output in order with the rest of the `printf`s.
+ */
+static void stdoutSink(void *data, const char *chars, size_t length) {
+    fwrite(chars, sizeof(char), length, stdout);
+}
+
+void printValue(Value value) {
+    Output output = {NULL, 0, 0, FLUSH_FULL, stdoutSink, NULL};
+    writeValue(&output, value);
+}
+
 bool isFalsey(Value value) {
     return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
 }
@@ -64,7 +85,10 @@ bool valuesEqual(Value a, Value b) {
             // Objects (including strings thanks to interning)
             // are only equal if their address is equal.
             // Remember `as.obj` in structure Value is a pointer.
-            return AS_OBJ(a) == AS_OBJ(b);
+            if (AS_OBJ(a) == AS_OBJ(b))
+                return true;
+            // Except records, which are compared by value.
+            return IS_RECORD(a) && IS_RECORD(b) && recordsEqual(AS_RECORD(a), AS_RECORD(b));
         default:
             return false; // Unreachable.
     }
@@ -2,6 +2,7 @@
 #define NAMELESS_VALUE_H
 
 #include "common.h"
+#include "output.h"
 
 // Just typedef the struct for ease of use.
 typedef struct Obj Obj;
@@ -14,7 +15,8 @@ typedef enum {
     VAL_BOOL,
     VAL_NIL,
     VAL_NUMBER,
-    VAL_OBJ
+    VAL_OBJ,
+    VAL_EMPTY       // No value at all, marks unset instance fields. Never reaches the program.
 } ValueType;
 
 /**
@@ -49,6 +51,11 @@ typedef struct {
  */
 #define OBJ_VAL(object)   ((Value){VAL_OBJ, {.obj = (Obj*)(object)}})
 
+/**
+ * Make an empty value, the content of a field slot the instance never set.
+ */
+#define EMPTY_VAL         ((Value){VAL_EMPTY, {.number = 0}})
+
 /**
  * Cast Value to bool. If you do this unsafely, you may open a portal to the shadow realm. Check the type before.
  */
@@ -73,6 +80,7 @@ typedef struct {
 #define IS_NIL(value)     ((value).type == VAL_NIL)
 #define IS_NUMBER(value)  ((value).type == VAL_NUMBER)
 #define IS_OBJ(value)     ((value).type == VAL_OBJ)
+#define IS_EMPTY(value)   ((value).type == VAL_EMPTY)
 
 /**
  * Just like a Chunk. C has no generics. Shame.
@@ -107,7 +115,15 @@ void writeValueArray(ValueArray *array, Value value);
 void freeValueArray(ValueArray *array);
 
 /**
- * Print a value.
+ * Write a value to an output stream, the way `print` shows it.
+ *
+ * @param output The output stream.
+ * @param value The value to write.
+ */
+void writeValue(Output *output, Value value);
+
+/**
+ * Print a value to the standard output, through the C stream. Meant for debugging, programs print to `vm.output`.
  *
  * @param value The value to print.
  */
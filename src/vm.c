@@ -7,6 +7,14 @@
 #include "compiler.h"
 #include "memory.h"
 #include "debug.h"
+#include "number.h"
+#include "stringlib.h"
+#include "listlib.h"
+#include "sortlib.h"
+#include "maplib.h"
+#include "json.h"
+#include "filelib.h"
+#include "serialize.h"
 
 // Just a global member.
 VM vm;
@@ -18,26 +26,52 @@ static Value clockNative(int argCount, Value *args) {
     return NUMBER_VAL((double) clock() / CLOCKS_PER_SEC);
 }
 
+/**
+ * Write out whatever the program printed so far.
+ */
+static Value flushNative(int argCount, Value *args) {
+    flushOutput(&vm.output);
+    return NIL_VAL;
+}
+
+/**
+ * Read a number from a string, nil if it is not one.
+ */
+static Value parseNumberNative(int argCount, Value *args) {
+    if (argCount < 1 || !IS_STRING(args[0]))
+        return NIL_VAL;
+
+    ObjString *string = AS_STRING(args[0]);
+    double value;
+    if (!parseNumber(string->chars, string->length, &value))
+        return NIL_VAL;
+    return NUMBER_VAL(value);
+}
+
 /**
  * Helper function to reset a vm's stack.
  */
 static void resetStack() {
+    // Upvalues left open by an error point to slots that are gone.
+    if (vm.openUpvalueCount > 0) {
+        memset(vm.openUpvalues, 0, sizeof(vm.openUpvalues));
+        vm.openUpvalueCount = 0;
+    }
     vm.stackTop = vm.stack;
     vm.frameCount = 0;
-    vm.openUpvalues = NULL;
 }
 
 /**
- * Print a runtime error. Basically printf with line information as an extra.
+ * Print a runtime error, like `runtimeError`, with the arguments in a `va_list`.
  *
  * @param format Format string.
- * @param ... The arguments.
+ * @param args The arguments.
  */
-static void runtimeError(const char *format, ...) {
-    va_list args;
-    va_start(args, format);
+static void reportRuntimeError(const char *format, va_list args) {
+    // What the program printed before the error comes before it.
+    flushOutput(&vm.output);
+
     vfprintf(stderr, format, args);
-    va_end(args);
     fputs("\n", stderr);
 
     // Print the stack trace.
@@ -57,12 +91,39 @@ static void runtimeError(const char *format, ...) {
 }
 
 /**
- * Add a native function binding.
+ * Print a runtime error. Basically printf with line information as an extra.
  *
- * @param name The name of the function in the global namespace.
- * @param function The C function containing the implementation.
+ * @param format Format string.
+ * @param ... The arguments.
  */
-static void defineNative(const char *name, NativeFn function) {
+static void runtimeError(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    reportRuntimeError(format, args);
+    va_end(args);
+}
+
+Value nativeError(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    reportRuntimeError(format, args);
+    va_end(args);
+    return EMPTY_VAL;
+}
+
+bool checkArgumentCount(int count, int min, int max) {
+    if (count >= min && count <= max)
+        return true;
+
+    if (min == max) {
+        runtimeError("Expected %d arguments but got %d.", min, count);
+    } else {
+        runtimeError("Expected %d to %d arguments but got %d.", min, max, count);
+    }
+    return false;
+}
+
+void defineNative(const char *name, NativeFn function) {
     // We're putting the objects in the stack to avoid garbage collection.
     push(OBJ_VAL(copyString(name, (int) strlen(name))));
     push(OBJ_VAL(newNative(function)));
@@ -74,27 +135,114 @@ static void defineNative(const char *name, NativeFn function) {
 void initVM() {
     resetStack();
     vm.objects = NULL;
-    initTable(&vm.globals);
-    initTable(&vm.strings);
-    vm.initString = NULL;   // Since we allocate it dynamically, the gc may read it before initializing it.
-    vm.initString = copyString("init", 4);
+    vm.boundMethodPool = NULL;
+    vm.boundMethodPoolCount = 0;
+    vm.instancePool = NULL;
+    vm.instancePoolCount = 0;
+    vm.regionMode = false;
+    vm.regionFull = false;
+    initArena(&vm.arena, 0);
+    vm.regionObjects = NULL;
 
-    // GC stuff
+    // GC stuff. Must be ready before the first allocation.
     vm.grayCount = 0;
     vm.grayCapacity = 0;
     vm.grayStack = NULL;
     vm.bytesAllocated = 0;
     vm.nextGC = 1024 * 1024;
 
+    initTable(&vm.globals);
+    initTable(&vm.strings);
+    initTable(&vm.constants);
+    initTable(&vm.symbols);
+    vm.symbolCount = 0;
+    initOutput(&vm.output, OUTPUT_BUFFER_SIZE, FLUSH_FULL);
+    initRegexCache(&vm.regexCache);
+    vm.initString = NULL;   // Since we allocate it dynamically, the gc may read it before initializing it.
+    vm.stringClass = NULL;
+    vm.listClass = NULL;
+    vm.mapClass = NULL;
+    vm.fileClass = NULL;
+    vm.initString = copyString("init", 4);
+    // The names sit on the stack while their class is allocated.
+    push(OBJ_VAL(copyString("String", 6)));
+    vm.stringClass = newClass(AS_STRING(vm.stack[0]));
+    pop();
+    push(OBJ_VAL(copyString("List", 4)));
+    vm.listClass = newClass(AS_STRING(vm.stack[0]));
+    pop();
+    push(OBJ_VAL(copyString("Map", 3)));
+    vm.mapClass = newClass(AS_STRING(vm.stack[0]));
+    pop();
+    push(OBJ_VAL(copyString("File", 4)));
+    vm.fileClass = newClass(AS_STRING(vm.stack[0]));
+    pop();
+
     // Temporary solution to define natives.
     defineNative("clock", clockNative);
+    defineNative("flush", flushNative);
+    defineNative("parseNumber", parseNumberNative);
+    initStringLibrary();
+    initListLibrary();
+    initSortLibrary();
+    initMapLibrary();
+    initJsonLibrary();
+    initFileLibrary();
+    initSerializeLibrary();
 }
 
 void freeVM() {
+    freeOutput(&vm.output);
+    freeRegexCache(&vm.regexCache);
     freeTable(&vm.globals);
     freeTable(&vm.strings);
+    freeTable(&vm.constants);
+    freeTable(&vm.symbols);
     vm.initString = NULL;
+    vm.stringClass = NULL;
+    vm.listClass = NULL;
+    vm.mapClass = NULL;
+    vm.fileClass = NULL;
     freeObjects();
+    freeArena(&vm.arena);
+}
+
+int symbolFor(ObjString *name) {
+    if (name->symbol >= 0)
+        return name->symbol;
+
+    // The table keeps the name alive, a string that died would take its symbol with it.
+    push(OBJ_VAL(name));
+    tableSet(&vm.symbols, name, NUMBER_VAL(vm.symbolCount));
+    pop();
+    name->symbol = vm.symbolCount;
+    return vm.symbolCount++;
+}
+
+void enableRegionMode(size_t arenaLimit) {
+    vm.arena.limit = arenaLimit;
+    vm.regionMode = true;
+}
+
+void disableRegionMode() {
+    // Objects allocated outside of a run (e.g. by natives being defined) may still be in the arena.
+    endRegion();
+    vm.regionMode = false;
+}
+
+void configureOutput(size_t bufferSize, FlushPolicy policy) {
+    resizeOutput(&vm.output, bufferSize);
+    vm.output.policy = policy;
+}
+
+void redirectOutput(OutputSink sink, void *data) {
+    flushOutput(&vm.output);
+    vm.output.sink = sink;
+    vm.output.sinkData = data;
+}
+
+void redirectOutputToFile(int fd) {
+    redirectOutput(fileDescriptorSink, (void *) (intptr_t) fd);
 }
 
 void push(Value value) {
@@ -139,6 +287,7 @@ static bool call(ObjClosure *closure, int argCount) {
     frame->closure = closure;                       // Set the function.
     frame->ip = closure->function->chunk.code;      // Set the instruction pointer.
     frame->slots = vm.stackTop - argCount - 1;      // Point at where the arguments begin (argument 0 is callee).
+    frame->constructs = false;
     return true;
 }
 
@@ -160,11 +309,17 @@ static bool callValue(Value callee, int argCount) {
             }
             case OBJ_CLASS: {
                 ObjClass *klass = AS_CLASS(callee);
-                vm.stackTop[-argCount - 1] = OBJ_VAL(newInstance(klass));
-                // Look for the initialized method. Run it if any.
-                Value initializer;
-                if (tableGet(&klass->methods, vm.initString, &initializer)) {
-                    return call(AS_CLOSURE(initializer), argCount);
+                ObjInstance *instance = newInstance(klass);
+                vm.stackTop[-argCount - 1] = OBJ_VAL(instance);
+                // Run the initializer, if any. A sealed instance may get its fields until it returns, and only then:
+                // calling `init` again later must not add any. When it returns, the class learns how many fields
+                // the next instance needs.
+                if (!IS_NIL(klass->initializer)) {
+                    if (!call(AS_CLOSURE(klass->initializer), argCount))
+                        return false;
+                    instance->isConstructing = true;
+                    vm.frames[vm.frameCount - 1].constructs = true;
+                    return true;
                 } else if (argCount != 0) {
                     // No initializer method -> can't pass arguments.
                     runtimeError("Expected 0 arguments but got %d.", argCount);
@@ -174,9 +329,23 @@ static bool callValue(Value callee, int argCount) {
             }
             case OBJ_CLOSURE:
                 return call(AS_CLOSURE(callee), argCount);
+            case OBJ_RECORD_TYPE: {
+                ObjRecordType *type = AS_RECORD_TYPE(callee);
+                if (argCount != type->fieldCount) {
+                    runtimeError("Expected %d arguments but got %d.", type->fieldCount, argCount);
+                    return false;
+                }
+                // The arguments stay on the stack while the record is allocated.
+                ObjRecord *record = newRecord(type, vm.stackTop - argCount);
+                vm.stackTop -= argCount + 1;
+                push(OBJ_VAL(record));
+                return true;
+            }
             case OBJ_NATIVE: {
                 NativeFn native = AS_NATIVE(callee);
                 Value result = native(argCount, vm.stackTop - argCount);
+                if (IS_EMPTY(result))
+                    return false;
                 vm.stackTop -= argCount + 1;
                 push(result);
                 return true;
@@ -189,33 +358,134 @@ static bool callValue(Value callee, int argCount) {
     return false;
 }
 
+static InterpretResult run(int baseFrame);
+
+bool callFunction(Value callee, int argCount, Value *args, Value *result) {
+    if (vm.stackTop + argCount + 1 > vm.stack + STACK_MAX) {
+        runtimeError("You did it, my boy. You have finally become Stack Overflow.");
+        return false;
+    }
+
+    push(callee);
+    for (int i = 0; i < argCount; i++) {
+        push(args[i]);
+    }
+    int baseFrame = vm.frameCount;
+    if (!callValue(callee, argCount))
+        return false;
+    // Natives, records and classes without an initializer are done already.
+    if (vm.frameCount > baseFrame && run(baseFrame) != INTERPRET_OK)
+        return false;
+    *result = pop();
+    return true;
+}
+
+/**
+ * Find a method in a class' vtable. Raise an error if the class has no such method.
+ *
+ * @param klass The class.
+ * @param name The method's name, for the error message.
+ * @param selector The method's selector.
+ * @return The method's closure or NULL if it was not found.
+ */
+static ObjClosure *findMethod(ObjClass *klass, ObjString *name, int selector) {
+    if (selector >= klass->vtableSize || IS_NIL(klass->vtable[selector])) {
+        runtimeError("Undefined property '%s'.", name->chars);
+        return NULL;
+    }
+    return AS_CLOSURE(klass->vtable[selector]);
+}
+
 /**
  * Call a method.
  *
  * @param klass The class.
  * @param name The method's name.
+ * @param selector The method's selector.
  * @param argCount The argument count.
  * @return the result of `call`.
  */
-static bool invokeFromClass(ObjClass *klass, ObjString *name, int argCount) {
-    Value method;
-    if (!tableGet(&klass->methods, name, &method)) {
+static bool invokeFromClass(ObjClass *klass, ObjString *name, int selector, int argCount) {
+    ObjClosure *method = findMethod(klass, name, selector);
+    if (method == NULL)
+        return false;
+    return call(method, argCount);
+}
+
+/**
+ * Read a field of an instance.
+ *
+ * @param instance The instance.
+ * @param name The field name.
+ * @param value Output parameter, the value of the field.
+ * @return Whether the instance has such field.
+ */
+static inline bool getField(ObjInstance *instance, ObjString *name, Value *value) {
+    int slot = findFieldSlot(instance->klass, name->symbol);
+    if (slot < 0 || slot >= instance->fieldCapacity || IS_EMPTY(instance->fields[slot]))
+        return false;
+
+    *value = instance->fields[slot];
+    return true;
+}
+
+/**
+ * Call a native method of a built-in type. The receiver and the arguments are on the stack.
+ *
+ * @param klass The class holding the type's methods.
+ * @param name The method's name, for the error message.
+ * @param selector The method's selector.
+ * @param argCount The argument count, not counting the receiver.
+ * @return Whether the method was found and did not fail.
+ */
+static bool invokeNative(ObjClass *klass, ObjString *name, int selector, int argCount) {
+    if (selector >= klass->vtableSize || IS_NIL(klass->vtable[selector])) {
         runtimeError("Undefined property '%s'.", name->chars);
         return false;
     }
-    return call(AS_CLOSURE(method), argCount);
+
+    // The receiver goes in as the first argument, then it makes room for the result.
+    NativeFn native = AS_NATIVE(klass->vtable[selector]);
+    Value result = native(argCount + 1, vm.stackTop - argCount - 1);
+    if (IS_EMPTY(result))
+        return false;
+    vm.stackTop -= argCount + 1;
+    push(result);
+    return true;
 }
 
 /**
  * Invoke a method.
  *
  * @param name The name of the method.
+ * @param selector The selector of the method, its index in the vtables.
  * @param argCount The number of arguments.
- * @return the result of `invokeFromClass`.
+ * @return the result of `call`.
  */
-static bool invoke(ObjString *name, int argCount) {
+static bool invoke(ObjString *name, int selector, int argCount) {
     Value receiver = peek(argCount);
 
+    // Records have no methods, but their fields may hold something callable.
+    Value value;
+    if (IS_RECORD(receiver)) {
+        if (!recordGet(AS_RECORD(receiver), name, &value)) {
+            runtimeError("Undefined property '%s'.", name->chars);
+            return false;
+        }
+        vm.stackTop[-argCount - 1] = value;
+        return callValue(value, argCount);
+    }
+
+    // Strings, lists, maps and files have native methods, without an instance around them.
+    if (IS_STRING(receiver))
+        return invokeNative(vm.stringClass, name, selector, argCount);
+    if (IS_LIST(receiver))
+        return invokeNative(vm.listClass, name, selector, argCount);
+    if (IS_MAP(receiver))
+        return invokeNative(vm.mapClass, name, selector, argCount);
+    if (IS_FILE(receiver))
+        return invokeNative(vm.fileClass, name, selector, argCount);
+
     // Binding does something similar.
     if (!IS_INSTANCE(receiver)) {
         runtimeError("Only instances have methods.");
@@ -223,15 +493,25 @@ static bool invoke(ObjString *name, int argCount) {
     }
     ObjInstance *instance = AS_INSTANCE(receiver);
 
-    // If a field in the object has been overwritten, call that instead.
-    Value value;
-    if (tableGet(&instance->fields, name, &value)) {
+    // If a field in the object has been overwritten, call that instead. Fields of sealed instances never shadow methods.
+    if (!instance->klass->isSealed && getField(instance, name, &value)) {
         vm.stackTop[-argCount - 1] = value;
         return callValue(value, argCount);
     }
 
-    // Or just call the method.
-    return invokeFromClass(instance->klass, name, argCount);
+    // Or just call the method, straight from the vtable.
+    return invokeFromClass(instance->klass, name, selector, argCount);
+}
+
+/**
+ * Bind a method to the object at the top of the stack. Pop object, push bound method.
+ *
+ * @param method The method.
+ */
+static void bind(ObjClosure *method) {
+    ObjBoundMethod *bound = newBoundMethod(peek(0), method);
+    pop();
+    push(OBJ_VAL(bound));
 }
 
 /**
@@ -242,66 +522,169 @@ static bool invoke(ObjString *name, int argCount) {
  * @return True if the method was found and pushed, False otherwise.
  */
 static bool bindMethod(ObjClass *klass, ObjString *name) {
-    Value method;
     // No method -> can't bind.
-    if (!tableGet(&klass->methods, name, &method)) {
-        runtimeError("Undefined property '%s'.", name->chars);
+    ObjClosure *method = findMethod(klass, name, symbolFor(name));
+    if (method == NULL)
         return false;
-    }
 
-    // Method found -> bind, pop object, push method.
-    ObjBoundMethod *bound = newBoundMethod(peek(0), AS_CLOSURE(method));
-    pop();
-    push(OBJ_VAL(bound));
+    bind(method);
     return true;
 }
 
 /**
- * Initialize a new upvalue pointing to an existing runtime value.
+ * Initialize a new upvalue pointing to an existing runtime value. Open upvalues are indexed by stack slot, so finding
+ * an existing one takes a single lookup.
  *
  * @param local The Value to point to.
  * @return An upvalue.
  */
 static ObjUpvalue *captureUpvalue(Value *local) {
-    ObjUpvalue *prevUpvalue = NULL;
-    ObjUpvalue *upvalue = vm.openUpvalues;
-    // Loop through the upvalues until the list is over
-    // Or we found the position for the new upvalue.
-    // > can be used because open upvalues are physically in the stack.
-    while (upvalue != NULL && upvalue->location > local) {
-        prevUpvalue = upvalue;
-        upvalue = upvalue->next;
+    ObjUpvalue **open = &vm.openUpvalues[local - vm.stack];
+    if (*open != NULL)
+        return *open;
+
+    *open = newUpvalue(local);
+    vm.openUpvalueCount++;
+    return *open;
+}
+
+/**
+ * Close upvalues instead of only popping. Closes every open upvalue from the top of the stack down to `last`.
+ *
+ * @param last The last upvalue to close.
+ */
+static void closeUpvalues(Value *last) {
+    for (Value *slot = vm.stackTop - 1; slot >= last && vm.openUpvalueCount > 0; slot--) {
+        ObjUpvalue **open = &vm.openUpvalues[slot - vm.stack];
+        if (*open == NULL)
+            continue;
+
+        ObjUpvalue *upvalue = *open;
+        upvalue->closed = *upvalue->location;
+        upvalue->location = &upvalue->closed;
+        *open = NULL;
+        vm.openUpvalueCount--;
     }
+}
+
+/**
+ * Make room in a class' vtable for the given number of selectors.
+ *
+ * @param klass The class.
+ * @param size The minimum size of the vtable.
+ */
+static void growVtable(ObjClass *klass, int size) {
+    if (size <= klass->vtableSize)
+        return;
 
-    // Found the upvalue.
-    if (upvalue != NULL && upvalue->location == local) {
-        return upvalue;
+    klass->vtable = GROW_ARRAY(Value, klass->vtable, klass->vtableSize, size);
+    for (int i = klass->vtableSize; i < size; i++) {
+        klass->vtable[i] = NIL_VAL;
     }
+    klass->vtableSize = size;
+}
 
-    ObjUpvalue *createdUpvalue = newUpvalue(local);
-    createdUpvalue->next = upvalue;
+/**
+ * Put a field in the layout of a class, which must not have it yet and must have room for it.
+ */
+static void addFieldSlot(FieldSlot *slots, int capacity, int symbol, int slot) {
+    int index = symbol & (capacity - 1);
+    while (slots[index].symbol >= 0) {
+        index = (index + 1) & (capacity - 1);
+    }
+    slots[index].symbol = symbol;
+    slots[index].slot = slot;
+}
+
+int layoutField(ObjClass *klass, int symbol) {
+    int slot = findFieldSlot(klass, symbol);
+    if (slot >= 0)
+        return slot;
 
-    // Created first upvalue.
-    if (prevUpvalue == NULL)
-        vm.openUpvalues = createdUpvalue;
-    else
-        prevUpvalue->next = createdUpvalue;
+    // Kept at most half full, so that probes stay short.
+    if ((klass->fieldCount + 1) * 2 > klass->fieldSlotsCapacity) {
+        int capacity = klass->fieldSlotsCapacity == 0 ? 8 : klass->fieldSlotsCapacity * 2;
+        FieldSlot *slots = GROW_ARRAY(FieldSlot, NULL, 0, capacity);
+        for (int i = 0; i < capacity; i++) {
+            slots[i].symbol = -1;
+        }
+        for (int i = 0; i < klass->fieldSlotsCapacity; i++) {
+            if (klass->fieldSlots[i].symbol >= 0)
+                addFieldSlot(slots, capacity, klass->fieldSlots[i].symbol, klass->fieldSlots[i].slot);
+        }
+        FREE_ARRAY(FieldSlot, klass->fieldSlots, klass->fieldSlotsCapacity);
+        klass->fieldSlots = slots;
+        klass->fieldSlotsCapacity = capacity;
+    }
 
-    return createdUpvalue;
+    addFieldSlot(klass->fieldSlots, klass->fieldSlotsCapacity, symbol, klass->fieldCount);
+    return klass->fieldCount++;
 }
 
 /**
- * Close upvalues instead of only popping.
+ * Mark the end of the construction of an instance, when its `init` returns. The slots up to the last field it set are
+ * what the next instances of the class are made with: fields that some instances only get later do not count.
  *
- * @param last The last upvalue to close.
+ * @param instance The instance.
  */
-static void closeUpvalues(Value *last) {
-    while (vm.openUpvalues != NULL && vm.openUpvalues->location >= last) {
-        ObjUpvalue *upvalue = vm.openUpvalues;
-        upvalue->closed = *upvalue->location;
-        upvalue->location = &upvalue->closed;
-        vm.openUpvalues = upvalue->next;
+static void endConstruction(ObjInstance *instance) {
+    instance->isConstructing = false;
+    int used = instance->fieldCapacity;
+    while (used > 0 && IS_EMPTY(instance->fields[used - 1])) {
+        used--;
     }
+    instance->klass->constructedFields = used;
+}
+
+/**
+ * Set a property of the instance second to last on the stack to the last value. Pop both, push the value.
+ *
+ * @param name The name of the property.
+ * @param initializing Whether this is `this.name = ...` in an initializer, which may add fields to sealed instances
+ * while they are being constructed.
+ * @return Whether the property could be set.
+ */
+static bool setProperty(ObjString *name, bool initializing) {
+    if (IS_RECORD(peek(1))) {
+        runtimeError("Records are immutable.");
+        return false;
+    }
+    if (!IS_INSTANCE(peek(1))) {
+        runtimeError("Only instances have fields.");
+        return false;
+    }
+
+    ObjInstance *instance = AS_INSTANCE(peek(1));
+    ObjClass *klass = instance->klass;
+
+    int symbol = symbolFor(name);
+    Value value;
+    if (klass->isSealed && !getField(instance, name, &value)) {
+        if (!initializing || !instance->isConstructing) {
+            runtimeError("Can't add field '%s' to an instance of sealed class '%s'.", name->chars, klass->name->chars);
+            return false;
+        }
+        // Invoking methods of sealed instances does not look at the fields.
+        if (symbol < klass->vtableSize && !IS_NIL(klass->vtable[symbol])) {
+            runtimeError("Field '%s' would shadow a method of sealed class '%s'.", name->chars, klass->name->chars);
+            return false;
+        }
+    }
+
+    // A new field grows the layout of the class, the instance catches up. It only grows for its own fields, not for
+    // every field some other instance of the class got.
+    int slot = findFieldSlot(klass, symbol);
+    if (slot < 0)
+        slot = layoutField(klass, symbol);
+    if (slot >= instance->fieldCapacity) {
+        int capacity = instance->fieldCapacity * 2;
+        reserveFields(instance, capacity > slot ? capacity : slot + 1);
+    }
+    instance->fields[slot] = peek(0);
+    value = pop();
+    pop();
+    push(value);
+    return true;
 }
 
 /**
@@ -313,22 +696,94 @@ static void defineMethod(ObjString *name) {
     Value method = peek(0);
     ObjClass *klass = AS_CLASS(peek(1));
     tableSet(&klass->methods, name, method);
+    if (name == vm.initString)
+        klass->initializer = method;
+
+    int selector = symbolFor(name);
+    growVtable(klass, selector + 1);
+    klass->vtable[selector] = method;
     pop();
 }
 
+void defineNativeMethod(ObjClass *klass, const char *name, NativeFn function) {
+    // We're putting the objects in the stack to avoid garbage collection.
+    push(OBJ_VAL(copyString(name, (int) strlen(name))));
+    push(OBJ_VAL(newNative(function)));
+    int selector = symbolFor(AS_STRING(peek(1)));
+    growVtable(klass, selector + 1);
+    klass->vtable[selector] = peek(0);
+    pop();
+    pop();
+}
+
+const char *typeName(Value value) {
+    switch (value.type) {
+        case VAL_BOOL:
+            return "a boolean";
+        case VAL_NIL:
+            return "nil";
+        case VAL_NUMBER:
+            return "a number";
+        case VAL_EMPTY:
+            return "nothing";
+        case VAL_OBJ:
+            break;
+    }
+
+    switch (OBJ_TYPE(value)) {
+        case OBJ_STRING:
+            return "a string";
+        case OBJ_CLASS:
+            return "a class";
+        case OBJ_INSTANCE:
+            return "an instance";
+        case OBJ_LIST:
+            return "a list";
+        case OBJ_MAP:
+            return "a map";
+        case OBJ_FILE:
+            return "a file";
+        case OBJ_RECORD:
+            return "a record";
+        case OBJ_RECORD_TYPE:
+            return "a record type";
+        default:
+            return "a function";
+    }
+}
+
+/**
+ * Get the text of a string, or of a number turned into a string.
+ *
+ * @param value A string or a number.
+ * @param buffer Where a number is formatted, NUMBER_BUFFER_SIZE bytes.
+ * @param length Output parameter, the length of the text.
+ * @return The text.
+ */
+static const char *textOf(Value value, char *buffer, int *length) {
+    if (IS_NUMBER(value)) {
+        *length = formatNumber(AS_NUMBER(value), buffer);
+        return buffer;
+    }
+    *length = AS_STRING(value)->length;
+    return AS_C_STRING(value);
+}
+
 /**
- * Concatenate the two last strings in the stack.
+ * Concatenate the two last values in the stack: strings, or a string and a number.
  */
 static void concatenate() {
     // Instead of popping, we keep them on the stack to avoid garbage collection.
-    ObjString *b = AS_STRING(peek(0));
-    ObjString *a = AS_STRING(peek(1));
+    char bBuffer[NUMBER_BUFFER_SIZE], aBuffer[NUMBER_BUFFER_SIZE];
+    int bLength, aLength;
+    const char *b = textOf(peek(0), bBuffer, &bLength);
+    const char *a = textOf(peek(1), aBuffer, &aLength);
 
-    int length = a->length + b->length;
+    int length = aLength + bLength;
     char *chars = ALLOCATE(
             char, length + 1);
-    memcpy(chars, a->chars, a->length);
-    memcpy(chars + a->length, b->chars, b->length);
+    memcpy(chars, a, aLength);
+    memcpy(chars + aLength, b, bLength);
     chars[length] = '\0';
 
     // Take result, pop operands, push result.
@@ -338,7 +793,168 @@ static void concatenate() {
     push(OBJ_VAL(result));
 }
 
-static InterpretResult run() {
+/**
+ * Turn a value into a string the way print writes it.
+ *
+ * @param value The value.
+ * @return The string.
+ */
+static ObjString *stringOf(Value value) {
+    MemorySink sink = {NULL, 0, 0};
+    Output output;
+    initOutput(&output, 0, FLUSH_EXPLICIT);
+    output.sink = memorySink;
+    output.sinkData = &sink;
+    writeValue(&output, value);
+    freeOutput(&output);
+
+    ObjString *string = copyString(sink.chars == NULL ? "" : sink.chars, (int) sink.length);
+    freeMemorySink(&sink);
+    return string;
+}
+
+/**
+ * Join the last values in the stack into one string, for an interpolated string. Strings and numbers are copied into
+ * the result as they are, other values are turned into strings first.
+ *
+ * @param count How many values.
+ */
+static void buildString(int count) {
+    // The parts stay on the stack until the result is made, to keep them from garbage collection.
+    Value *parts = vm.stackTop - count;
+    // Numbers are formatted once, one after the other in scratch space, while measuring the result.
+    char numbers[UINT8_COUNT * NUMBER_BUFFER_SIZE];
+    char *number = numbers;
+    int length = 0;
+    for (int i = 0; i < count; i++) {
+        if (IS_NUMBER(parts[i])) {
+            int numberLength = formatNumber(AS_NUMBER(parts[i]), number);
+            number += numberLength + 1;
+            length += numberLength;
+            continue;
+        }
+        if (!IS_STRING(parts[i]))
+            parts[i] = OBJ_VAL(stringOf(parts[i]));
+        length += AS_STRING(parts[i])->length;
+    }
+
+    char *chars = ALLOCATE(char, length + 1);
+    char *end = chars;
+    number = numbers;
+    for (int i = 0; i < count; i++) {
+        if (IS_NUMBER(parts[i])) {
+            // Each text keeps its terminator, which tells where it ends.
+            int numberLength = (int) strlen(number);
+            memcpy(end, number, numberLength);
+            number += numberLength + 1;
+            end += numberLength;
+        } else {
+            ObjString *string = AS_STRING(parts[i]);
+            memcpy(end, string->chars, string->length);
+            end += string->length;
+        }
+    }
+    chars[length] = '\0';
+
+    ObjString *result = takeString(chars, length);
+    vm.stackTop = parts;
+    push(OBJ_VAL(result));
+}
+
+/**
+ * Make a list out of the last values in the stack, for a list literal. Pops them, pushes the list.
+ *
+ * @param count How many values.
+ */
+static void buildList(int count) {
+    ObjList *list = newList();
+    // The items stay on the stack, below the list, until they are copied.
+    push(OBJ_VAL(list));
+    if (count > 0) {
+        list->items = GROW_ARRAY(Value, NULL, 0, count);
+        list->capacity = count;
+        memcpy(list->items, vm.stackTop - 1 - count, sizeof(Value) * count);
+        list->count = count;
+    }
+    vm.stackTop -= count + 1;
+    push(OBJ_VAL(list));
+}
+
+/**
+ * Make a map out of the last values in the stack, keys and values taking turns, for a map literal. Pops them, pushes
+ * the map.
+ *
+ * @param count How many entries.
+ * @return Whether the keys were all strings.
+ */
+static bool buildMap(int count) {
+    Value *entries = vm.stackTop - 2 * count;
+    for (int i = 0; i < count; i++) {
+        if (!IS_STRING(entries[2 * i])) {
+            runtimeError("Map keys must be strings but got %s.", typeName(entries[2 * i]));
+            return false;
+        }
+    }
+
+    // The entries stay on the stack, below the map, until they are in.
+    ObjMap *map = newMap();
+    push(OBJ_VAL(map));
+    for (int i = 0; i < count; i++) {
+        mapSet(map, AS_STRING(entries[2 * i]), entries[2 * i + 1]);
+    }
+    vm.stackTop = entries;
+    push(OBJ_VAL(map));
+    return true;
+}
+
+/**
+ * Check a value can be a key of a map, raising an error if not.
+ *
+ * @param value The key.
+ * @return Whether it is a string.
+ */
+static bool checkKey(Value value) {
+    if (IS_STRING(value))
+        return true;
+    runtimeError("Map keys must be strings but got %s.", typeName(value));
+    return false;
+}
+
+/**
+ * Check a value can index something with a number of items, raising an error if not.
+ *
+ * @param value The index.
+ * @param count How many items can be indexed.
+ * @param index Output parameter, the index.
+ * @return Whether the index is valid.
+ */
+static bool toIndex(Value value, int count, int *index) {
+    if (!IS_NUMBER(value)) {
+        runtimeError("Index must be a number but got %s.", typeName(value));
+        return false;
+    }
+
+    double number = AS_NUMBER(value);
+    if (!(number >= 0 && number < count)) {
+        runtimeError("Index out of range.");
+        return false;
+    }
+    *index = (int) number;
+    if (*index != number) {
+        runtimeError("Index must be an integer.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Run the code of the current frame, and of the functions it calls, until it returns.
+ *
+ * @param baseFrame How many frames there were below the one to run. A native calling a function leaves its caller's
+ * frames there, the result of the function is left on the stack for it.
+ * @return The result.
+ */
+static InterpretResult run(int baseFrame) {
 
     CallFrame *frame = &vm.frames[vm.frameCount - 1];
 
@@ -360,6 +976,13 @@ static InterpretResult run() {
         push(valueType(a op b)); \
     } // ! Careful with semicolons after this macro !
 
+// Same as BINARY_OP, for operands the compiler proved to be numbers. Works on the stack in place.
+#define NUMBER_OP(valueType, op) { \
+        double b = AS_NUMBER(vm.stackTop[-1]); \
+        vm.stackTop--; \
+        vm.stackTop[-1] = valueType(AS_NUMBER(vm.stackTop[-1]) op b); \
+    }
+
     for (;;) {
 
 #ifdef DEBUG_TRACE_EXECUTION
@@ -437,7 +1060,23 @@ static InterpretResult run() {
                 *frame->closure->upvalues[slot]->location = peek(0);
                 break;
             }
+            case OP_GET_CAPTURED: {
+                uint8_t slot = READ_BYTE();
+                push(frame->closure->captured[slot]);
+                break;
+            }
             case OP_GET_PROPERTY: {
+                if (IS_RECORD(peek(0))) {
+                    ObjString *name = READ_STRING();
+                    Value value;
+                    if (!recordGet(AS_RECORD(peek(0)), name, &value)) {
+                        runtimeError("Undefined property '%s'.", name->chars);
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+                    pop(); // Record.
+                    push(value);
+                    break;
+                }
                 if (!IS_INSTANCE(peek(0))) {
                     runtimeError("Only instances have properties.");
                     return INTERPRET_RUNTIME_ERROR;
@@ -447,7 +1086,7 @@ static InterpretResult run() {
                 ObjString *name = READ_STRING();
 
                 Value value;
-                if (tableGet(&instance->fields, name, &value)) {
+                if (getField(instance, name, &value)) {
                     pop(); // Instance.
                     push(value);
                     break;
@@ -459,26 +1098,27 @@ static InterpretResult run() {
                 }
                 break;
             }
-            case OP_SET_PROPERTY: {
-                if (!IS_INSTANCE(peek(1))) {
-                    runtimeError("Only instances have fields.");
+            case OP_SET_PROPERTY:
+                if (!setProperty(READ_STRING(), false)) {
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            case OP_INIT_PROPERTY:
+                if (!setProperty(READ_STRING(), true)) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
-
-                ObjInstance *instance = AS_INSTANCE(peek(1));
-                tableSet(&instance->fields, READ_STRING(), peek(0));
-                Value value = pop();
-                pop();
-                push(value);
                 break;
-            }
             case OP_GET_SUPER: {
+                // The superclass of a method is fixed, so is its vtable: the selector finds the method right away.
                 ObjString *name = READ_STRING();
+                int selector = READ_SHORT();
                 ObjClass *superclass = AS_CLASS(pop());
 
-                if (!bindMethod(superclass, name)) {
+                ObjClosure *method = findMethod(superclass, name, selector);
+                if (method == NULL) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
+                bind(method);
                 break;
             }
             case OP_EQUAL: {
@@ -491,16 +1131,80 @@ static InterpretResult run() {
                 break;
             case OP_LESS: BINARY_OP(BOOL_VAL, <);
                 break;
+            case OP_BUILD_STRING:
+                buildString(READ_BYTE());
+                break;
+            case OP_BUILD_MAP:
+                if (!buildMap(READ_BYTE()))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            case OP_BUILD_LIST:
+                buildList(READ_BYTE());
+                break;
+            case OP_GET_INDEX: {
+                int index;
+                Value value;
+                if (IS_LIST(peek(1))) {
+                    ObjList *list = AS_LIST(peek(1));
+                    if (!toIndex(peek(0), list->count, &index))
+                        return INTERPRET_RUNTIME_ERROR;
+                    value = list->items[index];
+                } else if (IS_STRING(peek(1))) {
+                    // A string of one character, interned like any other.
+                    ObjString *string = AS_STRING(peek(1));
+                    if (!toIndex(peek(0), string->length, &index))
+                        return INTERPRET_RUNTIME_ERROR;
+                    value = OBJ_VAL(copyString(string->chars + index, 1));
+                } else if (IS_MAP(peek(1))) {
+                    // Missing keys read as nil.
+                    if (!checkKey(peek(0)))
+                        return INTERPRET_RUNTIME_ERROR;
+                    if (!mapGet(AS_MAP(peek(1)), AS_STRING(peek(0)), &value))
+                        value = NIL_VAL;
+                } else {
+                    runtimeError("Only lists, maps and strings can be indexed.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                vm.stackTop -= 2;
+                push(value);
+                break;
+            }
+            case OP_SET_INDEX: {
+                if (IS_MAP(peek(2))) {
+                    // Everything stays on the stack while the map grows.
+                    if (!checkKey(peek(1)))
+                        return INTERPRET_RUNTIME_ERROR;
+                    mapSet(AS_MAP(peek(2)), AS_STRING(peek(1)), peek(0));
+                    Value value = pop();
+                    vm.stackTop -= 2;
+                    push(value);
+                    break;
+                }
+                if (!IS_LIST(peek(2))) {
+                    runtimeError("Only list items and map entries can be assigned.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                ObjList *list = AS_LIST(peek(2));
+                int index;
+                if (!toIndex(peek(1), list->count, &index))
+                    return INTERPRET_RUNTIME_ERROR;
+                Value value = pop();
+                list->items[index] = value;
+                vm.stackTop -= 2;
+                push(value);
+                break;
+            }
             case OP_ADD: {
-                if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
-                    concatenate();
-                } else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
+                if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
                     double b = AS_NUMBER(pop());
                     double a = AS_NUMBER(pop());
                     push(NUMBER_VAL(a + b));
+                } else if ((IS_STRING(peek(0)) || IS_NUMBER(peek(0))) && (IS_STRING(peek(1)) || IS_NUMBER(peek(1)))) {
+                    // At least one is a string, numbers join it as text.
+                    concatenate();
                 } else {
                     runtimeError(
-                            "Operands must be two numbers or two strings.");
+                            "Operands must be two numbers, or strings and numbers.");
                     return INTERPRET_RUNTIME_ERROR;
                 }
                 break;
@@ -521,9 +1225,33 @@ static InterpretResult run() {
                 }
                 push(NUMBER_VAL(-AS_NUMBER(pop())));
                 break;
+            case OP_GREATER_NUMBER: NUMBER_OP(BOOL_VAL, >)
+                break;
+            case OP_LESS_NUMBER: NUMBER_OP(BOOL_VAL, <)
+                break;
+            case OP_ADD_NUMBER: NUMBER_OP(NUMBER_VAL, +)
+                break;
+            case OP_SUBTRACT_NUMBER: NUMBER_OP(NUMBER_VAL, -)
+                break;
+            case OP_MULTIPLY_NUMBER: NUMBER_OP(NUMBER_VAL, *)
+                break;
+            case OP_DIVIDE_NUMBER: NUMBER_OP(NUMBER_VAL, /)
+                break;
+            case OP_NEGATE_NUMBER:
+                vm.stackTop[-1] = NUMBER_VAL(-AS_NUMBER(vm.stackTop[-1]));
+                break;
+            case OP_CHECK_NUMBER: {
+                // Guards a value going into something declared `: num`, code using it skips the type checks.
+                ObjString *what = READ_STRING();
+                if (!IS_NUMBER(peek(0))) {
+                    runtimeError("Expected a number for %s but got %s.", what->chars, typeName(peek(0)));
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            }
             case OP_PRINT: {
-                printValue(pop());
-                printf("\n");
+                writeValue(&vm.output, pop());
+                writeOutput(&vm.output, "\n", 1);
                 break;
             }
             case OP_JUMP: {
@@ -553,7 +1281,8 @@ static InterpretResult run() {
             case OP_INVOKE: {
                 ObjString *method = READ_STRING();
                 int argCount = READ_BYTE();
-                if (!invoke(method, argCount)) {
+                int selector = READ_SHORT();
+                if (!invoke(method, selector, argCount)) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
                 frame = &vm.frames[vm.frameCount - 1];
@@ -562,8 +1291,9 @@ static InterpretResult run() {
             case OP_SUPER_INVOKE: {
                 ObjString *method = READ_STRING();
                 int argCount = READ_BYTE();
+                int selector = READ_SHORT();
                 ObjClass *superclass = AS_CLASS(pop());
-                if (!invokeFromClass(superclass, method, argCount)) {
+                if (!invokeFromClass(superclass, method, selector, argCount)) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
                 frame = &vm.frames[vm.frameCount - 1];
@@ -577,14 +1307,24 @@ static InterpretResult run() {
                 push(OBJ_VAL(closure));
                 // Load the upvalues.
                 for (int i = 0; i < closure->upvalueCount; i++) {
-                    uint8_t isLocal = READ_BYTE();
+                    uint8_t kind = READ_BYTE();
                     uint8_t index = READ_BYTE();
-                    if (isLocal) {
+                    if (kind == CAPTURE_LOCAL) {
                         closure->upvalues[i] = captureUpvalue(frame->slots + index);
                     } else {
                         closure->upvalues[i] = frame->closure->upvalues[index];
                     }
                 }
+                // Then copy the values that are never assigned.
+                for (int i = 0; i < closure->capturedCount; i++) {
+                    uint8_t kind = READ_BYTE();
+                    uint8_t index = READ_BYTE();
+                    if (kind == CAPTURE_VALUE) {
+                        closure->captured[i] = frame->slots[index];
+                    } else {
+                        closure->captured[i] = frame->closure->captured[index];
+                    }
+                }
                 break;
             }
             case OP_CLOSE_UPVALUE: {
@@ -601,25 +1341,58 @@ static InterpretResult run() {
                     runtimeError("Superclass must be a class.");
                     return INTERPRET_RUNTIME_ERROR;
                 }
+                if (AS_CLASS(superclass)->isSealed) {
+                    runtimeError("Can't inherit from sealed class '%s'.", AS_CLASS(superclass)->name->chars);
+                    return INTERPRET_RUNTIME_ERROR;
+                }
                 ObjClass *subclass = AS_CLASS(peek(0));
                 tableAddAll(&AS_CLASS(superclass)->methods, &subclass->methods);
+                growVtable(subclass, AS_CLASS(superclass)->vtableSize);
+                memcpy(subclass->vtable, AS_CLASS(superclass)->vtable, sizeof(Value) * AS_CLASS(superclass)->vtableSize);
+                subclass->initializer = AS_CLASS(superclass)->initializer;
+                // Start from the layout of the superclass, its initializer is likely to set the same fields.
+                ObjClass *parent = AS_CLASS(superclass);
+                if (parent->fieldSlotsCapacity > 0) {
+                    subclass->fieldSlots = GROW_ARRAY(FieldSlot, NULL, 0, parent->fieldSlotsCapacity);
+                    memcpy(subclass->fieldSlots, parent->fieldSlots, sizeof(FieldSlot) * parent->fieldSlotsCapacity);
+                    subclass->fieldSlotsCapacity = parent->fieldSlotsCapacity;
+                    subclass->fieldCount = parent->fieldCount;
+                    subclass->constructedFields = parent->constructedFields;
+                }
                 pop(); // Subclass.
                 break;
             }
             case OP_METHOD:
                 defineMethod(READ_STRING());
                 break;
+            case OP_SEAL:
+                AS_CLASS(peek(0))->isSealed = true;
+                break;
+            case OP_RECORD: {
+                ObjString *name = READ_STRING();
+                int fieldCount = READ_BYTE();
+                ObjRecordType *type = newRecordType(name, fieldCount);
+                for (int i = 0; i < fieldCount; i++) {
+                    type->fields[i] = READ_STRING();
+                }
+                push(OBJ_VAL(type));
+                break;
+            }
             case OP_RETURN: {
                 // Pop the result, the last value the function left on the stack is its return.
                 Value result = pop();
-                // Close the upvalues.
-                closeUpvalues(frame->slots);
+                // Close the upvalues, if the compiler saw any local being captured.
+                if (frame->closure->function->hasCapturedLocals)
+                    closeUpvalues(frame->slots);
+                if (frame->constructs)
+                    endConstruction(AS_INSTANCE(frame->slots[0]));
                 // Drop the function frame.
                 vm.frameCount--;
-                // Last stack -> program is done.
-                if (vm.frameCount == 0) {
-                    // Pop reserved main stack slot.
-                    pop();
+                // Back to where the run started -> done.
+                if (vm.frameCount == baseFrame) {
+                    // Whoever started the run takes the result from the stack.
+                    vm.stackTop = frame->slots;
+                    push(result);
                     return INTERPRET_OK;
                 }
                 // Push the result after coming back and removing the function call from the stack.
@@ -628,10 +1401,41 @@ static InterpretResult run() {
                 frame = &vm.frames[vm.frameCount - 1];
                 break;
             }
+            case OP_RETURN_VALUES: {
+                // The values go straight to the caller's stack, which must be unpacking just as many of them. A
+                // function called from a native or from the program embedding the VM, e.g. in record mode, is the
+                // base frame: it has no caller frame, and takes a single value.
+                int count = READ_BYTE();
+                CallFrame *caller = vm.frameCount - 1 > baseFrame ? &vm.frames[vm.frameCount - 2] : NULL;
+                if (caller == NULL || caller->ip[0] != OP_UNPACK || caller->ip[1] != count) {
+                    int expected = caller != NULL && caller->ip[0] == OP_UNPACK ? caller->ip[1] : 1;
+                    runtimeError("Expected %d value%s but the function returned %d.",
+                                 expected, expected == 1 ? "" : "s", count);
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                if (frame->closure->function->hasCapturedLocals)
+                    closeUpvalues(frame->slots);
+                vm.frameCount--;
+
+                // Slide the values down over the callee's slots, then skip the caller's OP_UNPACK.
+                memmove(frame->slots, vm.stackTop - count, sizeof(Value) * count);
+                vm.stackTop = frame->slots + count;
+                caller->ip += 2;
+                frame = caller;
+                break;
+            }
+            case OP_UNPACK: {
+                // Calls returning several values skip this. Getting here means there was a single value.
+                int count = READ_BYTE();
+                runtimeError("Expected %d values but got 1.", count);
+                return INTERPRET_RUNTIME_ERROR;
+            }
         }
     }
 
 // Won't need the macros outside the function.
+#undef NUMBER_OP
 #undef BINARY_OP
 #undef READ_STRING
 #undef READ_CONSTANT
@@ -641,17 +1445,30 @@ static InterpretResult run() {
 }
 
 InterpretResult interpret(const char *source) {
+    InterpretResult result = INTERPRET_COMPILE_ERROR;
     ObjFunction *function = compile(source);
-    if (function == NULL)
-        return INTERPRET_COMPILE_ERROR;
 
-    // The compiler still returns a function.
-    // Wrap the function and replace it, then call it.
-    push(OBJ_VAL(function));
-    ObjClosure *closure = newClosure(function);
-    pop();
-    push(OBJ_VAL(closure));
-    call(closure, 0);
+    if (function != NULL) {
+        // The compiler still returns a function.
+        // Wrap the function and replace it, then call it.
+        push(OBJ_VAL(function));
+        ObjClosure *closure = newClosure(function);
+        pop();
+        push(OBJ_VAL(closure));
+        call(closure, 0);
+
+        result = run(0);
+        // The script's result, nil.
+        if (result == INTERPRET_OK)
+            pop();
+    }
+
+    // Whatever the run did not leave in the globals is garbage now.
+    if (vm.regionMode)
+        endRegion();
+
+    if (vm.output.policy != FLUSH_EXPLICIT)
+        flushOutput(&vm.output);
 
-    return run();
+    return result;
 }
\ No newline at end of file
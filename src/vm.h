@@ -1,14 +1,31 @@
 #ifndef NAMELESS_VM_H
 #define NAMELESS_VM_H
 
+#include "arena.h"
 #include "chunk.h"
 #include "value.h"
 #include "table.h"
 #include "object.h"
+#include "regex.h"
 
 #define FRAMES_MAX 64
 #define STACK_MAX (FRAMES_MAX * UINT8_COUNT)
 
+/**
+ * How many dead bound methods are kept around for reuse, instead of being freed.
+ */
+#define BOUND_METHOD_POOL_MAX 256
+
+/**
+ * How many dead instances are kept around for reuse, together with their field slots.
+ */
+#define INSTANCE_POOL_MAX 256
+
+/**
+ * Instances with more field slots than this are not worth keeping in the pool.
+ */
+#define POOLED_FIELDS_MAX 64
+
 /**
  * Representation of a single function call.
  */
@@ -16,6 +33,7 @@ typedef struct {
     ObjClosure *closure;    // The function (closure) being called.
     uint8_t *ip;            // Return address. Jump to here when the call ends.
     Value *slots;           // Pointer to the first slot of the stack that this function owns.
+    bool constructs;        // Runs `init` for a class call making an instance, see `isConstructing`.
 } CallFrame;
 
 /**
@@ -29,8 +47,28 @@ typedef struct {
     Table globals;                  // Global variables. String names as keys, values as values.
     Table strings;                  // Hashtable containing strings, for interning.
     ObjString *initString;          // Used to always keep the "init" string alive.
-    ObjUpvalue *openUpvalues;       // List of upvalues. Must be kept sorted by stack slot index.
+    ObjClass *stringClass;          // Native methods of strings, in its vtable. Not visible to programs.
+    ObjClass *listClass;            // Native methods of lists, in its vtable. Not visible to programs.
+    ObjClass *mapClass;             // Native methods of maps, in its vtable. Not visible to programs.
+    ObjClass *fileClass;            // Native methods of files, in its vtable. Not visible to programs.
+    Table constants;                // Constants declared at top level. The compiler inlines them, they outlive a run.
+    Table symbols;                  // Property and method names that have a symbol id, keeps them alive.
+    int symbolCount;                // How many symbols were handed out.
+    Output output;                  // Where `print` writes.
+    RegexCache regexCache;          // Patterns compiled by the string methods that take one.
+    ObjUpvalue *openUpvalues[STACK_MAX];    // Open upvalue of each stack slot, NULL if the slot has none.
+    int openUpvalueCount;                   // How many upvalues are open.
     Obj *objects;                   // As a temporary solution, a linked list of objects.
+    Obj *boundMethodPool;           // Dead bound methods ready for reuse, linked through `next`.
+    int boundMethodPoolCount;       // How many bound methods are in the pool.
+    Obj *instancePool;              // Dead instances ready for reuse, with empty field slots, linked through `next`.
+    int instancePoolCount;          // How many instances are in the pool.
+
+    // Region mode: objects of a run are bumped out of an arena, discarded wholesale when `interpret` returns.
+    bool regionMode;                // Whether new objects go to the arena.
+    bool regionFull;                // The arena hit its limit during this run, garbage collection is back on.
+    Arena arena;                    // Where region objects live.
+    Obj *regionObjects;             // Linked list of the objects living in the arena.
 
     // Temporary solution: unmanaged list of objects for garbage collection.
     size_t bytesAllocated;
@@ -58,6 +96,64 @@ void initVM();
  */
 void freeVM();
 
+/**
+ * Turn region mode on. Objects allocated during a call to `interpret` come from a bump arena and garbage collection
+ * does not run until the arena reaches its limit. When `interpret` returns, the objects that escaped the run (reachable
+ * from globals or from objects that were already alive) are promoted to the heap and the arena is discarded.
+ *
+ * @param arenaLimit How many bytes of objects a single run can put in the arena.
+ */
+void enableRegionMode(size_t arenaLimit);
+
+/**
+ * Turn region mode off. Subsequent runs allocate objects on the heap.
+ */
+void disableRegionMode();
+
+/**
+ * Configure the buffer in front of the program's output. Whatever is buffered is flushed first.
+ *
+ * @param bufferSize Size of the buffer, 0 to write every `print` through.
+ * @param policy When the buffer is flushed besides when it is full.
+ */
+void configureOutput(size_t bufferSize, FlushPolicy policy);
+
+/**
+ * Send the program's output somewhere else than the standard output. Whatever is buffered is flushed first.
+ *
+ * @param sink Receives the output, a chunk at a time. See `memorySink`, `fileDescriptorSink` and `streamSink`.
+ * @param data Passed along to the sink.
+ */
+void redirectOutput(OutputSink sink, void *data);
+
+/**
+ * Send the program's output to a file descriptor.
+ *
+ * @param fd The file descriptor.
+ */
+void redirectOutputToFile(int fd);
+
+/**
+ * Get the symbol id of a property or method name, handing out a new one if the name has none yet. Symbols are dense
+ * indices shared by all classes: a method's closure sits at its symbol in the vtable of each class that has it (its
+ * selector), and a class maps the symbol of each field to the field's slot in the instances. The id is stored in the
+ * string, so finding it takes no hashing.
+ *
+ * @param name The name, an interned string.
+ * @return The symbol id.
+ */
+int symbolFor(ObjString *name);
+
+/**
+ * Find the slot of a field in the instances of a class, laying out a new slot if the class has none for it yet.
+ * Instances made before may have fewer slots, see `reserveFields`.
+ *
+ * @param klass The class.
+ * @param symbol The symbol of the field name.
+ * @return The slot.
+ */
+int layoutField(ObjClass *klass, int symbol);
+
 /**
  * Interpret source code from a character buffer.
  *
@@ -66,6 +162,64 @@ void freeVM();
  */
 InterpretResult interpret(const char *source);
 
+/**
+ * Add a native function to the globals.
+ *
+ * @param name The name of the function in the global namespace.
+ * @param function The C function containing the implementation.
+ */
+void defineNative(const char *name, NativeFn function);
+
+/**
+ * Add a native method to a class, usually one of the classes holding the methods of a built-in type. The method gets
+ * the receiver as its first argument.
+ *
+ * @param klass The class.
+ * @param name The method name.
+ * @param function The C function containing the implementation.
+ */
+void defineNativeMethod(ObjClass *klass, const char *name, NativeFn function);
+
+/**
+ * Report a runtime error from a native function, or from the program embedding the VM. A native must return the
+ * result right away.
+ *
+ * @param format Format string.
+ * @param ... The arguments.
+ * @return The value telling the VM the native failed.
+ */
+Value nativeError(const char *format, ...);
+
+/**
+ * Call a function, or anything else that can be called, from a native or from the program embedding the VM, and run it
+ * to the end. Natives taking a callback use this, the callback may call natives in turn.
+ *
+ * @param callee The value to call.
+ * @param argCount How many arguments.
+ * @param args The arguments. They must be reachable, e.g. the native's own arguments.
+ * @param result Output parameter, what the call returned.
+ * @return Whether the call succeeded. If not, an error was reported and the native must return `EMPTY_VAL` right away.
+ */
+bool callFunction(Value callee, int argCount, Value *args, Value *result);
+
+/**
+ * Check a native got a number of arguments in a range, raising an error if not.
+ *
+ * @param count How many arguments the native got, not counting the receiver of a method.
+ * @param min The fewest arguments it takes.
+ * @param max The most arguments it takes.
+ * @return Whether the count is right. If not, the native must return `EMPTY_VAL` right away.
+ */
+bool checkArgumentCount(int count, int min, int max);
+
+/**
+ * Describe the type of a value, for error messages.
+ *
+ * @param value The value.
+ * @return A description such as "a string" or "nil".
+ */
+const char *typeName(Value value);
+
 /**
  * Push a value at the top of a vm.
  *